@@ -299,6 +299,14 @@ list get_dropped_alerts(alerts_dropped_alert const& alert)
     return ret;
 }
 
+list get_num_dropped(alerts_dropped_alert const& alert)
+{
+    list ret;
+    for (auto const n : alert.num_dropped)
+        ret.append(n);
+    return ret;
+}
+
 void bind_alert()
 {
     using boost::noncopyable;
@@ -1089,6 +1097,7 @@ void bind_alert()
     class_<alerts_dropped_alert, bases<alert>, noncopyable>(
        "alerts_dropped_alert", no_init)
         .add_property("dropped_alerts", &get_dropped_alerts)
+        .add_property("num_dropped", &get_num_dropped)
         ;
 
     class_<socks5_alert, bases<alert>, noncopyable>(
@@ -46,6 +46,11 @@ void bind_session_settings()
         .value("peer_proportional", settings_pack::peer_proportional)
     ;
 
+    enum_<settings_pack::utp_congestion_control_t>("utp_congestion_control_t")
+        .value("utp_ledbat", settings_pack::utp_ledbat)
+        .value("utp_bbr", settings_pack::utp_bbr)
+    ;
+
     enum_<settings_pack::enc_policy>("enc_policy")
         .value("pe_forced", settings_pack::pe_forced)
         .value("pe_enabled", settings_pack::pe_enabled)
@@ -61,6 +66,8 @@ void bind_session_settings()
         .value("pe_rc4", settings_pack::pe_rc4)
         .value("pe_plaintext", settings_pack::pe_plaintext)
         .value("pe_both", settings_pack::pe_both)
+        .value("pe_chacha20", settings_pack::pe_chacha20)
+        .value("pe_all", settings_pack::pe_all)
 #if TORRENT_ABI_VERSION == 1
         .value("rc4", settings_pack::pe_rc4)
         .value("plaintext", settings_pack::pe_plaintext)
@@ -126,6 +126,14 @@ for line in f:
         names.append(args[0].strip() + '.' + args[1].strip())
         types.append(counter_types[args[1]])
 
+    if 'LATENCY_HISTOGRAM(' in line:
+        args = line.split('(')[1].split(')')[0].split(',')
+
+        # a histogram is one counter per bucket, suffixed by the bucket number
+        args[1] = args[1].strip()
+        names.append(args[0].strip() + '.' + args[1] + '_N')
+        types.append(counter_types[args[1]])
+
 if len(names) > 0:
     render_section(names, description, types)
 
@@ -35,6 +35,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/torrent_info.hpp"
 #include "libtorrent/storage.hpp"
 #include "libtorrent/create_torrent.hpp"
+#include "libtorrent/settings_pack.hpp"
+#include "libtorrent/time.hpp"
 
 #include <functional>
 #include <cstdio>
@@ -150,6 +152,9 @@ OPTIONS:
               this means aligning large files and pad them in order
               for piece hashes to uniquely indentify a file without
               overlap
+-T threads    the number of threads to hash pieces with
+-b            benchmark hashing throughput. Hash the files with
+              1, 2, 4 and 8 threads and print the rate for each
 )";
 }
 
@@ -172,6 +177,8 @@ int main(int argc_, char const* argv_[]) try
 	int piece_size = 0;
 	lt::create_flags_t flags = {};
 	std::string root_cert;
+	int hash_threads = 0;
+	bool benchmark = false;
 
 	std::string outfile;
 	std::string merklefile;
@@ -201,6 +208,9 @@ int main(int argc_, char const* argv_[]) try
 			case 'l':
 				flags |= lt::create_torrent::symlinks;
 				continue;
+			case 'b':
+				benchmark = true;
+				continue;
 		}
 
 		if (args.size() < 2) {
@@ -218,6 +228,7 @@ int main(int argc_, char const* argv_[]) try
 			case 'c': comment_str = args[1]; break;
 			case 'r': root_cert = args[1]; break;
 			case 'L': collections.push_back(args[1]); break;
+			case 'T': hash_threads = atoi(args[1]); break;
 			case 'p':
 				pad_file_limit = atoi(args[1]);
 				flags |= lt::create_torrent::optimize_alignment;
@@ -302,8 +313,27 @@ int main(int argc_, char const* argv_[]) try
 	for (lt::sha1_hash const& s : similar)
 		t.add_similar_torrent(s);
 
+	if (benchmark) {
+		for (int const threads : {1, 2, 4, 8}) {
+			lt::settings_pack pack;
+			pack.set_int(lt::settings_pack::aio_threads, threads);
+			lt::time_point const start = lt::clock_type::now();
+			lt::set_piece_hashes(t, branch_path(full_path), pack
+				, [] (lt::piece_index_t) {});
+			std::int64_t const ms = std::max(std::int64_t(1)
+				, lt::total_milliseconds(lt::clock_type::now() - start));
+			std::cerr << threads << " threads: "
+				<< (fs.total_size() * 1000 / ms) / (1024 * 1024) << " MiB/s\n";
+		}
+		return 0;
+	}
+
+	lt::settings_pack pack;
+	if (hash_threads > 0)
+		pack.set_int(lt::settings_pack::aio_threads, hash_threads);
+
 	auto const num = t.num_pieces();
-	lt::set_piece_hashes(t, branch_path(full_path)
+	lt::set_piece_hashes(t, branch_path(full_path), pack
 		, [num] (lt::piece_index_t const p) {
 			std::cerr << "\r" << p << "/" << num;
 		});
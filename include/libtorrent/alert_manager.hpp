@@ -68,29 +68,39 @@ namespace libtorrent {
 		template <class T, typename... Args>
 		void emplace_alert(Args&&... args) try
 		{
+			// when the queue is full, drop the alert without taking the mutex.
+			// Under load (e.g. with peer_log enabled) this is where most alerts
+			// end up, and they would otherwise contend with every other thread
+			// posting alerts. m_num_queued may be slightly stale, the check is
+			// repeated under the lock below
+			if (m_num_queued.load(std::memory_order_relaxed) / (1 + T::priority)
+				>= m_queue_size_limit.load(std::memory_order_relaxed))
+			{
+				record_dropped(T::alert_type);
+				return;
+			}
+
 			std::unique_lock<std::recursive_mutex> lock(m_mutex);
 
 			// don't add more than this number of alerts, unless it's a
 			// high priority alert, in which case we try harder to deliver it
 			// for high priority alerts, double the upper limit
 			if (m_alerts[m_generation].size() / (1 + T::priority)
-				>= m_queue_size_limit)
+				>= m_queue_size_limit.load(std::memory_order_relaxed))
 			{
-				// record that we dropped an alert of this type
-				m_dropped.set(T::alert_type);
+				record_dropped(T::alert_type);
 				return;
 			}
 
 			T& alert = m_alerts[m_generation].emplace_back<T>(
 				m_allocations[m_generation], std::forward<Args>(args)...);
+			m_num_queued.store(m_alerts[m_generation].size(), std::memory_order_relaxed);
 
 			maybe_notify(&alert);
 		}
 		catch (std::bad_alloc const&)
 		{
-			// record that we dropped an alert of this type
-			std::unique_lock<std::recursive_mutex> lock(m_mutex);
-			m_dropped.set(T::alert_type);
+			record_dropped(T::alert_type);
 		}
 
 		bool pending() const;
@@ -117,6 +127,11 @@ namespace libtorrent {
 		int alert_queue_size_limit() const noexcept { return m_queue_size_limit; }
 		int set_alert_queue_size_limit(int queue_size_limit_);
 
+		// the total number of alerts dropped because the queue was full (or
+		// allocating them failed) since the alert_manager was created
+		std::int64_t num_dropped() const noexcept
+		{ return m_total_dropped.load(std::memory_order_relaxed); }
+
 		void set_notify_function(std::function<void()> const& fun);
 
 #ifndef TORRENT_DISABLE_EXTENSIONS
@@ -127,19 +142,32 @@ namespace libtorrent {
 
 		void maybe_notify(alert* a);
 
-		// this mutex protects everything. Since it's held while executing user
+		void record_dropped(int const type) noexcept
+		{
+			m_dropped[type].fetch_add(1, std::memory_order_relaxed);
+			m_total_dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// this mutex protects everything, except the atomics. Since it's held while executing user
 		// callbacks (the notify function and extension on_alert()) it must be
 		// recursive to support recursively post new alerts.
 		mutable std::recursive_mutex m_mutex;
 		std::condition_variable_any m_condition;
 		std::atomic<alert_category_t> m_alert_mask;
-		int m_queue_size_limit;
+		std::atomic<int> m_queue_size_limit;
+
+		// the number of alerts in m_alerts[m_generation]. This is only
+		// written with the mutex held, but it's read without it, to quickly
+		// reject alerts when the queue is full
+		std::atomic<int> m_num_queued{0};
+
+		// the number of dropped alerts of each type, since the last call to
+		// get_all(). Every time we drop an alert (because the queue is full or
+		// of some other error) we increment the corresponding counter, to
+		// communicate to the client that it may have missed an update.
+		aux::array<std::atomic<std::uint32_t>, num_alert_types> m_dropped;
 
-		// a bitfield where each bit represents an alert type. Every time we drop
-		// an alert (because the queue is full or of some other error) we set the
-		// corresponding bit in this mask, to communicate to the client that it
-		// may have missed an update.
-		std::bitset<num_alert_types> m_dropped;
+		std::atomic<std::int64_t> m_total_dropped{0};
 
 		// this function (if set) is called whenever the number of alerts in
 		// the alert queue goes from 0 to 1. The client is expected to wake up
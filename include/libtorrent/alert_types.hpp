@@ -61,6 +61,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
 
 #include <bitset>
+#include <array>
 #include <cstdarg> // for va_list
 
 #if TORRENT_ABI_VERSION == 1
@@ -2939,7 +2940,7 @@ TORRENT_VERSION_NAMESPACE_2
 	{
 		// internal
 		explicit alerts_dropped_alert(aux::stack_allocator& alloc
-			, std::bitset<num_alert_types> const&);
+			, std::array<std::uint32_t, num_alert_types> const&);
 		TORRENT_DEFINE_ALERT_PRIO(alerts_dropped_alert, 95, alert_priority_critical + 1)
 
 		static constexpr alert_category_t static_category = alert_category::error;
@@ -2949,6 +2950,10 @@ TORRENT_VERSION_NAMESPACE_2
 		// alert type ID, where bit 0 represents whether any alert of type 0 has
 		// been dropped, and so on.
 		std::bitset<num_alert_types> dropped_alerts;
+
+		// the number of alerts of each type that were dropped, indexed by
+		// alert type ID.
+		std::array<std::uint32_t, num_alert_types> num_dropped;
 	};
 
 	// this alert is posted with SOCKS5 related errors, when a SOCKS5 proxy is
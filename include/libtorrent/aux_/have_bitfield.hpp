@@ -0,0 +1,148 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_HAVE_BITFIELD_HPP_INCLUDED
+#define TORRENT_HAVE_BITFIELD_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/bitfield.hpp"
+#include "libtorrent/units.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <vector>
+#include <cstdint>
+
+namespace libtorrent { namespace aux {
+
+	// the set of pieces a peer has. In large swarms most peers are either
+	// seeds or have only a few pieces, and a full bitfield per peer wastes
+	// memory for both. This keeps one of three representations, and moves
+	// between them as pieces are added and removed:
+	//
+	// all     every piece is set. Nothing is stored.
+	// sparse  a sorted list of the pieces that are set. Used as long as it's
+	//         no larger than the corresponding bitfield.
+	// dense   a plain bitfield.
+	//
+	// The number of set pieces is tracked in all forms, which makes count(),
+	// all_set() and none_set() constant time.
+	struct TORRENT_EXTRA_EXPORT have_bitfield
+	{
+		enum class form_t : std::uint8_t { all, sparse, dense };
+
+		have_bitfield() = default;
+		have_bitfield(int bits, bool val) { resize(bits, val); }
+		explicit have_bitfield(typed_bitfield<piece_index_t> const& bits) { assign(bits); }
+
+		have_bitfield& operator=(typed_bitfield<piece_index_t> const& bits)
+		{
+			assign(bits);
+			return *this;
+		}
+
+		void assign(typed_bitfield<piece_index_t> const& bits);
+
+		bool get_bit(piece_index_t index) const;
+		bool operator[](piece_index_t const index) const { return get_bit(index); }
+
+		void set_bit(piece_index_t index);
+		void clear_bit(piece_index_t index);
+
+		void set_all();
+		void clear_all();
+
+		// set the number of pieces. New pieces are initialized to ``val``
+		void resize(int bits, bool val = false);
+
+		// make the set empty, of zero size
+		void clear();
+
+		int size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+		piece_index_t end_index() const { return piece_index_t(m_size); }
+
+		int count() const { return m_count; }
+		bool all_set() const { return m_size > 0 && m_count == m_size; }
+		bool none_set() const { return m_count == 0; }
+
+		form_t form() const { return m_form; }
+
+		// the sorted list of pieces in the set. Only valid in the sparse form
+		std::vector<piece_index_t> const& sparse_pieces() const
+		{
+			TORRENT_ASSERT(m_form == form_t::sparse);
+			return m_pieces;
+		}
+
+		// only valid in the dense form
+		typed_bitfield<piece_index_t> const& dense_bits() const
+		{
+			TORRENT_ASSERT(m_form == form_t::dense);
+			return m_bits;
+		}
+
+		// returns the set as a bitfield. In the dense form this is the internal
+		// bitfield, otherwise ``storage`` is filled in and returned. Either way
+		// the reference is only valid as long as ``storage`` and this object
+		// are not modified.
+		typed_bitfield<piece_index_t> const& bitfield(
+			typed_bitfield<piece_index_t>& storage) const;
+
+		// returns a copy of the set as a bitfield
+		typed_bitfield<piece_index_t> to_bitfield() const;
+
+	private:
+
+		// the largest number of pieces the sparse form is allowed to hold
+		// before the bitfield is smaller
+		int sparse_limit() const
+		{ return m_size / int(sizeof(piece_index_t) * 8); }
+
+		void to_dense();
+
+		// the pieces in the set, in the sparse form
+		std::vector<piece_index_t> m_pieces;
+
+		// the pieces in the set, in the dense form
+		typed_bitfield<piece_index_t> m_bits;
+
+		// the number of pieces in the torrent
+		int m_size = 0;
+
+		// the number of pieces in the set
+		int m_count = 0;
+
+		form_t m_form = form_t::sparse;
+	};
+}}
+
+#endif // TORRENT_HAVE_BITFIELD_HPP_INCLUDED
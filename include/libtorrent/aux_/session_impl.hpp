@@ -63,6 +63,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/file_pool.hpp"
 #include "libtorrent/bandwidth_manager.hpp"
 #include "libtorrent/disk_io_thread.hpp"
+#include "libtorrent/pe_crypto.hpp"
 #include "libtorrent/udp_socket.hpp"
 #include "libtorrent/assert.hpp"
 #include "libtorrent/alert_manager.hpp" // for alert_manager
@@ -83,6 +84,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/extensions.hpp"
 #include "libtorrent/aux_/portmap.hpp"
 #include "libtorrent/aux_/lsd.hpp"
+#include "libtorrent/aux_/stats_page.hpp"
 #include "libtorrent/flags.hpp"
 #include "libtorrent/span.hpp"
 
@@ -527,6 +529,7 @@ namespace aux {
 				sha1_hash const& info_hash, sha1_hash const& xor_mask) override;
 
 			void add_obfuscated_hash(sha1_hash const& obfuscated, std::weak_ptr<torrent> const& t) override;
+			dh_thread_pool& dh_threads() override { return m_dh_threads; }
 #endif
 
 			void on_lsd_announce(error_code const& e);
@@ -549,6 +552,8 @@ namespace aux {
 			void set_port_filter(port_filter const& f);
 			port_filter const& get_port_filter() const override;
 			void ban_ip(address addr) override;
+			void on_ip_filter_compiled(std::shared_ptr<ip_filter> const& orig
+				, std::shared_ptr<ip_filter> const& compiled);
 
 			void queue_tracker_request(tracker_request&& req
 				, std::weak_ptr<request_callback> c) override;
@@ -591,6 +596,9 @@ namespace aux {
 			std::pair<std::shared_ptr<torrent>, bool>
 			add_torrent_impl(add_torrent_params& p, error_code& ec);
 			void async_add_torrent(add_torrent_params* params);
+			void async_add_torrents(std::vector<add_torrent_params>* params);
+			void async_load_torrents(std::vector<std::vector<char>>* resume_data
+				, std::string const& save_path);
 
 #if TORRENT_ABI_VERSION == 1
 			void on_async_load_torrent(add_torrent_params* params, error_code ec);
@@ -606,6 +614,7 @@ namespace aux {
 				, status_flags_t flags) const;
 			void post_torrent_updates(status_flags_t flags);
 			void post_session_stats();
+			void update_stats_gauges();
 			void post_dht_stats();
 
 			std::vector<torrent_handle> get_torrents() const;
@@ -823,6 +832,7 @@ namespace aux {
 			void update_queued_disk_bytes();
 			void update_alert_queue_size();
 			void update_disk_threads();
+			void update_dh_threads();
 			void update_report_web_seed_downloads();
 			void update_outgoing_interfaces();
 			void update_listen_interfaces();
@@ -847,6 +857,7 @@ namespace aux {
 			void update_connections_limit();
 			void update_alert_mask();
 			void update_validate_https();
+			void update_stats_page();
 
 			void trigger_auto_manage() override;
 
@@ -877,6 +888,10 @@ namespace aux {
 
 			counters m_stats_counters;
 
+			// when enabled (stats_page_path), the counters are exported
+			// through this memory mapped file once per tick
+			aux::stats_page m_stats_page;
+
 			// this is a pool allocator for torrent_peer objects
 			// torrents and the disk cache (implicitly by holding references to the
 			// torrents) depend on this outliving them.
@@ -963,6 +978,9 @@ namespace aux {
 			// this maps obfuscated hashes to torrents. It's only
 			// used when encryption is enabled
 			torrent_map m_obfuscated_torrents;
+
+			// computes the DH keys of encrypted handshakes
+			dh_thread_pool m_dh_threads{m_io_service};
 #endif
 
 #if TORRENT_ABI_VERSION == 1
@@ -1235,7 +1253,6 @@ namespace aux {
 			// this is deducted from the connect speed
 			int m_boost_connections = 0;
 
-#if TORRENT_ABI_VERSION == 1
 			struct work_thread_t
 			{
 				work_thread_t()
@@ -1254,9 +1271,47 @@ namespace aux {
 				std::unique_ptr<boost::asio::io_service::work> work;
 				std::thread thread;
 			};
+#if TORRENT_ABI_VERSION == 1
 			std::unique_ptr<work_thread_t> m_torrent_load_thread;
 #endif
 
+			// torrents added by async_add_torrents() and async_load_torrents()
+			// are split up into batches. Each batch is prepared on one of the
+			// torrent load threads and then added to the session on the network
+			// thread, in the order they were passed in.
+			struct torrent_load_batch
+			{
+				std::vector<std::vector<char>> resume_data;
+				std::vector<add_torrent_params> params;
+				std::vector<error_code> errors;
+
+				// set on the network thread once the batch has been prepared
+				bool ready = false;
+			};
+			struct torrent_load_job
+			{
+				std::vector<torrent_load_batch> batches;
+				std::string save_path;
+
+				// the first batch that has not been added to the session yet
+				std::size_t next = 0;
+			};
+
+			void start_torrent_load_job(std::shared_ptr<torrent_load_job> job);
+			void on_torrent_load_batch(std::shared_ptr<torrent_load_job> job
+				, std::size_t batch);
+
+			std::vector<std::unique_ptr<work_thread_t>> m_torrent_load_threads;
+			std::size_t m_next_torrent_load_thread = 0;
+
+			// as peers are banned, the compiled form of m_ip_filter goes stale.
+			// A copy of it is compiled on this thread and then replaces it.
+			// The addresses banned in the meantime are recorded, to be added to
+			// the new filter too
+			std::unique_ptr<work_thread_t> m_ip_filter_thread;
+			std::vector<address> m_bans_while_compiling;
+			bool m_compiling_ip_filter = false;
+
 			// mask is a bitmask of which protocols to remap on:
 			enum remap_port_mask_t
 			{
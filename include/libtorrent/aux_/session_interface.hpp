@@ -81,6 +81,7 @@ namespace libtorrent {
 	struct torrent_peer_allocator_interface;
 	struct counters;
 	struct resolver_interface;
+	struct dh_thread_pool;
 
 	// hidden
 	using queue_position_t = aux::strong_typedef<int, struct queue_position_tag>;
@@ -302,6 +303,7 @@ namespace aux {
 			sha1_hash const& info_hash, sha1_hash const& xor_mask) = 0;
 		virtual void add_obfuscated_hash(sha1_hash const& obfuscated
 			, std::weak_ptr<torrent> const& t) = 0;
+		virtual dh_thread_pool& dh_threads() = 0;
 #endif
 
 #ifndef TORRENT_DISABLE_DHT
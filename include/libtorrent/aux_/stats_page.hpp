@@ -0,0 +1,110 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_STATS_PAGE_HPP_INCLUDED
+#define TORRENT_STATS_PAGE_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/error_code.hpp"
+#include "libtorrent/span.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace libtorrent {
+
+	struct counters;
+
+namespace aux {
+
+	// a stats_page exports the session's performance counters through a
+	// memory mapped file, which other processes on the same machine can map
+	// and read at any time, without going through the alert queue. The
+	// layout of the file is (all fields in host byte order):
+	//
+	// ====== ==== ==================================================
+	// offset size field
+	// ====== ==== ==================================================
+	// 0      4    magic, stats_page::magic
+	// 4      4    layout version, stats_page::version
+	// 8      8    sequence number
+	// 16     4    number of counters (N)
+	// 20     4    counter layout, stats_page::layout()
+	// 24     8*N  counter values, indexed by the counters enum
+	// ====== ==== ==================================================
+	//
+	// The counter layout is a CRC-32 of the counter names, in index order. It
+	// changes whenever counters are added, removed or reordered, which lets a
+	// reader detect that it was built against a different set of counters.
+	//
+	// The sequence number is a seqlock. It's odd while the page is being
+	// updated, and incremented twice for every update. A reader reads it,
+	// copies the counters and reads it again. If the two differ, or are odd,
+	// the copy may be torn and has to be retried. The names of the counters
+	// can be looked up with session_stats_metrics().
+	struct TORRENT_EXTRA_EXPORT stats_page
+	{
+		static constexpr std::uint32_t magic = 0x5053544c; // "LTSP"
+		static constexpr std::uint32_t version = 2;
+		static constexpr int header_size = 24;
+
+		stats_page() = default;
+		~stats_page();
+		stats_page(stats_page const&) = delete;
+		stats_page& operator=(stats_page const&) = delete;
+
+		// creates (or truncates) the file at ``path`` and maps it. Any
+		// previously opened page is closed first
+		void open(std::string const& path, error_code& ec);
+		void close();
+		bool is_open() const { return m_page != nullptr; }
+
+		// publish the current values of ``c``
+		void update(counters const& c);
+
+		// reads a consistent snapshot of the counters from a stats page mapped
+		// (or copied) into memory. Returns false if the page is not valid, was
+		// written with a different counter layout, or if a consistent copy
+		// couldn't be made
+		static bool read(span<char const> page, std::vector<std::int64_t>& out);
+
+		// the counter layout of this build of libtorrent
+		static std::uint32_t layout();
+
+	private:
+		void* m_page = nullptr;
+		std::size_t m_size = 0;
+	};
+}}
+
+#endif
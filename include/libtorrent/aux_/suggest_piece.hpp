@@ -37,6 +37,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <algorithm>
 
 #include "libtorrent/bitfield.hpp"
+#include "libtorrent/aux_/have_bitfield.hpp"
 #include "libtorrent/sliding_average.hpp"
 #include "libtorrent/aux_/vector.hpp"
 
@@ -48,7 +49,7 @@ struct suggest_piece
 	// pieces the peer has already sent a suggest for) nor in bits (which are
 	// pieces the peer already has, and should not be suggested)
 	int get_pieces(std::vector<piece_index_t>& p
-		, typed_bitfield<piece_index_t> const& bits
+		, have_bitfield const& bits
 		, int n)
 	{
 		if (m_priority_pieces.empty()) return 0;
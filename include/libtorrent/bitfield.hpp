@@ -166,9 +166,23 @@ namespace libtorrent {
 		// returns the index of the first set bit in the bitfield, i.e. 1 bit.
 		int find_first_set() const noexcept;
 
+		// returns the index of the first cleared bit in the bitfield, i.e. 0
+		// bit, or -1 if all bits are set.
+		int find_first_clear() const noexcept;
+
 		// returns the index to the last cleared bit in the bitfield, i.e. 0 bit.
 		int find_last_clear() const noexcept;
 
+		// returns the number of bits that are set in both this bitfield and
+		// ``rhs``. Bits past the end of the shorter bitfield are considered 0.
+		int count_and(bitfield const& rhs) const noexcept;
+
+		// returns the index of the first bit that is set in this bitfield but
+		// not in ``rhs``, i.e. the first set bit of ``*this & ~rhs``. Bits past
+		// the end of ``rhs`` are considered 0. Returns -1 if there is no such
+		// bit.
+		int find_first_set_and_not(bitfield const& rhs) const noexcept;
+
 		// internal
 		struct const_iterator
 		{
@@ -310,6 +310,15 @@ namespace libtorrent {
 		// 5. a -> b payload
 
 		void write_pe1_2_dhkey();
+
+		// called once the DH shared secret is known, moves on to the sync
+		// step of the handshake
+		void on_pe_secret();
+
+		// called when the DH threads have computed the shared secret. Feeds
+		// the data received in the meantime back to on_receive()
+		void on_dh_secret_computed();
+
 		void write_pe3_sync();
 		void write_pe4_sync(int crypto_select);
 
@@ -318,6 +327,14 @@ namespace libtorrent {
 
 		// helper to cut down on boilerplate
 		void rc4_decrypt(span<char> buf);
+
+		// the crypto used for the payload, once an encrypted payload stream
+		// has been negotiated
+		std::shared_ptr<crypto_plugin> payload_crypto() const
+		{
+			if (m_chacha20_encrypted) return m_chacha20;
+			return m_rc4;
+		}
 #endif
 
 	public:
@@ -349,6 +366,8 @@ namespace libtorrent {
 		{
 #if !defined TORRENT_DISABLE_ENCRYPTION
 			read_pe_dhkey,
+			// the DH secret is being computed on another thread
+			wait_pe_secret,
 			read_pe_syncvc,
 			read_pe_synchash,
 			read_pe_skey_vc,
@@ -396,9 +415,13 @@ namespace libtorrent {
 		// automatic encryption/decryption.
 		bool m_encrypted:1;
 
-		// true if rc4, false if plaintext
+		// true if rc4 or chacha20, false if plaintext
 		bool m_rc4_encrypted:1;
 
+		// true if chacha20 was negotiated for the payload. Implies
+		// m_rc4_encrypted
+		bool m_chacha20_encrypted:1;
+
 // this is a legitimate use of a shadow field
 #ifdef __clang__
 #pragma clang diagnostic push
@@ -443,14 +466,20 @@ namespace libtorrent {
 #if !defined TORRENT_DISABLE_ENCRYPTION
 		// initialized during write_pe1_2_dhkey, and destroyed on
 		// creation of m_enc_handler. Cannot reinitialize once
-		// initialized.
-		std::unique_ptr<dh_key_exchange> m_dh_key_exchange;
+		// initialized. While in wait_pe_secret state, it's shared
+		// with a DH thread.
+		std::shared_ptr<dh_key_exchange> m_dh_key_exchange;
 
 		// used during an encrypted handshake then moved
 		// into m_enc_handler if rc4 encryption is negotiated
 		// otherwise it is destroyed when the handshake completes
 		std::shared_ptr<rc4_handler> m_rc4;
 
+		// the payload crypto if chacha20 is offered, set up along with m_rc4.
+		// Moved into m_enc_handler if chacha20 is negotiated, otherwise
+		// destroyed when the handshake completes
+		std::shared_ptr<chacha20_handler> m_chacha20;
+
 		// if encryption is negotiated, this is used for
 		// encryption/decryption during the entire session.
 		encryption_handler m_enc_handler;
@@ -37,6 +37,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/file_storage.hpp"
 #include "libtorrent/config.hpp"
 #include "libtorrent/storage.hpp"
+#include "libtorrent/settings_pack.hpp"
 #include "libtorrent/hasher.hpp"
 #include "libtorrent/string_view.hpp"
 #include "libtorrent/aux_/vector.hpp"
@@ -402,7 +403,15 @@ namespace detail {
 	//
 	// The overloads that don't take an ``error_code&`` may throw an exception in case of a
 	// file error, the other overloads sets the error code to reflect the error, if any.
+	//
+	// The files are read sequentially, in large chunks, by the calling thread
+	// while a pool of threads hash the pieces. ``f`` is always called from the
+	// calling thread, in piece order. The overload taking a settings_pack uses
+	// ``settings_pack::aio_threads`` as the number of hashing threads.
+	TORRENT_EXPORT void set_piece_hashes(create_torrent& t, std::string const& p
+		, std::function<void(piece_index_t)> const& f, error_code& ec);
 	TORRENT_EXPORT void set_piece_hashes(create_torrent& t, std::string const& p
+		, settings_pack const& settings
 		, std::function<void(piece_index_t)> const& f, error_code& ec);
 	inline void set_piece_hashes(create_torrent& t, std::string const& p, error_code& ec)
 	{
@@ -422,6 +431,14 @@ namespace detail {
 		set_piece_hashes(t, p, f, ec);
 		if (ec) throw system_error(ec);
 	}
+	inline void set_piece_hashes(create_torrent& t, std::string const& p
+		, settings_pack const& settings
+		, std::function<void(piece_index_t)> const& f)
+	{
+		error_code ec;
+		set_piece_hashes(t, p, settings, f, ec);
+		if (ec) throw system_error(ec);
+	}
 #endif
 
 #if TORRENT_ABI_VERSION == 1
@@ -56,6 +56,9 @@ namespace libtorrent {
 	// this buffer has been released, ``data()`` will return nullptr.
 	struct TORRENT_EXTRA_EXPORT disk_buffer_holder
 	{
+		// default construct an empty holder, not holding any buffer
+		disk_buffer_holder() noexcept = default;
+
 		// internal
 		disk_buffer_holder(buffer_allocator_interface& alloc
 			, char* buf, std::size_t sz) noexcept;
@@ -95,7 +98,7 @@ namespace libtorrent {
 		// swap pointers of two disk buffer holders.
 		void swap(disk_buffer_holder& h) noexcept
 		{
-			TORRENT_ASSERT(h.m_allocator == m_allocator);
+			std::swap(h.m_allocator, m_allocator);
 			std::swap(h.m_buf, m_buf);
 			std::swap(h.m_size, m_size);
 			std::swap(h.m_ref, m_ref);
@@ -112,9 +115,9 @@ namespace libtorrent {
 
 	private:
 
-		buffer_allocator_interface* m_allocator;
-		char* m_buf;
-		std::size_t m_size;
+		buffer_allocator_interface* m_allocator = nullptr;
+		char* m_buf = nullptr;
+		std::size_t m_size = 0;
 		aux::block_cache_reference m_ref;
 	};
 
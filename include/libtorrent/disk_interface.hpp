@@ -152,6 +152,14 @@ namespace libtorrent {
 			, char const* buf, std::shared_ptr<disk_observer> o
 			, std::function<void(storage_error const&)> handler
 			, disk_job_flags_t flags = {}) = 0;
+
+		// like async_write() above, but ``buf`` is a disk buffer allocated by
+		// allocate_disk_buffer() and already holds the data to write. Ownership
+		// of the buffer is passed on to the disk thread, sparing a copy.
+		virtual void async_write(storage_index_t storage, peer_request const& r
+			, disk_buffer_holder buf
+			, std::function<void(storage_error const&)> handler
+			, disk_job_flags_t flags = {}) = 0;
 		virtual void async_hash(storage_index_t storage, piece_index_t piece, disk_job_flags_t flags
 			, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler) = 0;
 		virtual void async_move_storage(storage_index_t storage, std::string p, move_flags_t flags
@@ -179,6 +187,14 @@ namespace libtorrent {
 			, std::function<void(piece_index_t)> handler) = 0;
 		virtual void clear_piece(storage_index_t storage, piece_index_t index) = 0;
 
+		// allocate a block sized buffer from the disk cache, for receiving
+		// data into that is later passed to async_write(). If the cache is at
+		// or above its limit, ``exceeded`` is set to true and ``o`` will be
+		// notified once it drops below the low watermark again. Returns an
+		// empty holder if the allocation failed.
+		virtual disk_buffer_holder allocate_disk_buffer(bool& exceeded
+			, std::shared_ptr<disk_observer> o, char const* category) = 0;
+
 		virtual void update_stats_counters(counters& c) const = 0;
 		virtual void get_cache_info(cache_status* ret, storage_index_t storage
 			, bool no_pieces = true, bool session = true) const = 0;
@@ -42,6 +42,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/units.hpp"
 #include "libtorrent/session_types.hpp"
 #include "libtorrent/flags.hpp"
+#include "libtorrent/time.hpp"
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/variant/variant.hpp>
@@ -129,6 +130,10 @@ namespace libtorrent {
 		// the disk storage this job applies to (if applicable)
 		std::shared_ptr<storage_interface> storage;
 
+		// the time this job was allocated. Used to measure how long it was
+		// queued before being executed
+		time_point issue_time;
+
 		// this is called when operation completes
 
 		using read_handler = std::function<void(disk_buffer_holder block, disk_job_flags_t flags, storage_error const& se)>;
@@ -305,6 +305,10 @@ namespace aux { struct block_cache_reference; }
 			, char const* buf, std::shared_ptr<disk_observer> o
 			, std::function<void(storage_error const&)> handler
 			, disk_job_flags_t flags = {}) override;
+		void async_write(storage_index_t storage, peer_request const& r
+			, disk_buffer_holder buf
+			, std::function<void(storage_error const&)> handler
+			, disk_job_flags_t flags = {}) override;
 		void async_hash(storage_index_t storage, piece_index_t piece, disk_job_flags_t flags
 			, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler) override;
 		void async_move_storage(storage_index_t storage, std::string p, move_flags_t flags
@@ -339,6 +343,8 @@ namespace aux { struct block_cache_reference; }
 		// implements buffer_allocator_interface
 		void reclaim_blocks(span<aux::block_cache_reference> ref) override;
 		void free_disk_buffer(char* buf) override { m_disk_cache.free_buffer(buf); }
+		disk_buffer_holder allocate_disk_buffer(bool& exceeded
+			, std::shared_ptr<disk_observer> o, char const* category) override;
 		void trigger_cache_trim();
 		void update_stats_counters(counters& c) const override;
 		void get_cache_info(cache_status* ret, storage_index_t storage
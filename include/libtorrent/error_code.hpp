@@ -428,6 +428,8 @@ namespace libtorrent {
 			invalid_tracker_transaction_id,
 			// invalid action field in UDP tracker response
 			invalid_tracker_action,
+			// a record in binary resume data is truncated or malformed
+			invalid_resume_data,
 
 #if TORRENT_ABI_VERSION == 1
 			// expected string in bencoded string
@@ -571,6 +571,11 @@ namespace libtorrent {
 
 		int get_or_add_path(string_view path);
 
+		// frees m_path_index. torrent_info calls this once all files of a
+		// torrent have been added. If more paths are added later,
+		// get_or_add_path() rebuilds it
+		void clear_path_index();
+
 		void add_pad_file(int size
 			, std::vector<internal_file_entry>::iterator& i
 			, std::int64_t& offset
@@ -619,6 +624,12 @@ namespace libtorrent {
 		// entry appended, to form full file paths
 		aux::vector<std::string> m_paths;
 
+		// maps the CRC32 of every entry in m_paths to its index. This is used
+		// by get_or_add_path() to find existing paths without scanning all of
+		// them, which is quadratic for torrents with many directories. It's
+		// only needed while adding files, and is empty in loaded torrents
+		std::unordered_multimap<std::uint32_t, int> m_path_index;
+
 		// name of torrent. For multi-file torrents
 		// this is always the root directory
 		std::string m_name;
@@ -37,6 +37,8 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <set>
 #include <vector>
+#include <array>
+#include <utility>
 #include <cstdint>
 #include <tuple>
 #include <iterator> // for next
@@ -132,6 +134,29 @@ namespace detail {
 	inline std::uint16_t max_addr<std::uint16_t>()
 	{ return (std::numeric_limits<std::uint16_t>::max)(); }
 
+	// the compiled form of a filter compares addresses as integers rather
+	// than as arrays of bytes
+	inline std::uint32_t filter_key(std::array<unsigned char, 4> const& a)
+	{
+		return (std::uint32_t(a[0]) << 24) | (std::uint32_t(a[1]) << 16)
+			| (std::uint32_t(a[2]) << 8) | std::uint32_t(a[3]);
+	}
+
+	inline std::pair<std::uint64_t, std::uint64_t> filter_key(
+		std::array<unsigned char, 16> const& a)
+	{
+		std::uint64_t hi = 0;
+		std::uint64_t lo = 0;
+		for (std::size_t i = 0; i < 8; ++i)
+		{
+			hi = (hi << 8) | a[i];
+			lo = (lo << 8) | a[i + 8];
+		}
+		return {hi, lo};
+	}
+
+	inline std::uint16_t filter_key(std::uint16_t const a) { return a; }
+
 	// this is the generic implementation of
 	// a filter for a specific address type.
 	// it works with IPv4 and IPv6
@@ -201,17 +226,75 @@ namespace detail {
 
 			if (j != m_access_list.end() && j->access == flags) m_access_list.erase(j);
 			TORRENT_ASSERT(!m_access_list.empty());
+
+			if (m_tree.empty()) return;
+
+			// the compiled form no longer reflects the rules. Rather than
+			// recompiling it, which is expensive for large filters, keep the
+			// few rules added since (typically banned peers) on the side. If
+			// there are too many of them, fall back to m_access_list until the
+			// next compile()
+			if (m_added.size() < max_added_rules)
+			{
+				m_added.push_back(added_rule{first, last, flags});
+			}
+			else
+			{
+				m_tree.clear();
+				m_added.clear();
+			}
 		}
 
-		std::uint32_t access(Addr const& addr) const
+		// builds the compiled form of the rules, used by access() from then
+		// on. The start of every range is stored in a flat array in Eytzinger
+		// (breadth-first) order, which makes a lookup a branch-free walk down
+		// an implicit binary tree, touching one cache line per level near the
+		// root
+		void compile()
 		{
+			m_added.clear();
 			TORRENT_ASSERT(!m_access_list.empty());
-			auto i = m_access_list.upper_bound(addr);
-			if (i != m_access_list.begin()) --i;
-			TORRENT_ASSERT(i != m_access_list.end());
-			TORRENT_ASSERT(i->start <= addr && (std::next(i) == m_access_list.end()
-				|| addr < std::next(i)->start));
-			return i->access;
+			std::vector<node> sorted;
+			sorted.reserve(m_access_list.size());
+			std::uint32_t prev_access = 0;
+			for (auto const& r : m_access_list)
+			{
+				sorted.push_back(node{filter_key(r.start), prev_access});
+				prev_access = r.access;
+			}
+			m_last_access = prev_access;
+
+			// index 0 is not used, the root of the tree is at 1
+			m_tree.clear();
+			m_tree.resize(sorted.size() + 1);
+			std::size_t const used = build_tree(sorted, 0, 1);
+			TORRENT_ASSERT(used == sorted.size());
+			TORRENT_UNUSED(used);
+		}
+
+		// true if the filter is compiled, but half of the room for rules on
+		// the side has been used up
+		bool should_compile() const
+		{
+			return !m_tree.empty() && m_added.size() >= max_added_rules / 2;
+		}
+
+		std::uint32_t access(Addr const& addr) const
+		{
+			if (m_tree.empty()) return list_access(addr);
+
+			// the rules added after compile() take precedence, the last one
+			// first
+			for (auto i = m_added.rbegin(); i != m_added.rend(); ++i)
+			{
+				if (addr < i->first || i->last < addr) continue;
+				TORRENT_ASSERT(i->flags == list_access(addr));
+				return i->flags;
+			}
+
+			std::uint32_t const ret = compiled_access(addr);
+			TORRENT_ASSERT(ret == list_access(addr));
+			return ret;
 		}
 
 		template <class ExternalAddressType>
@@ -240,6 +323,55 @@ namespace detail {
 
 	private:
 
+		using key_type = decltype(filter_key(std::declval<Addr>()));
+
+		struct node
+		{
+			// the first address of a range
+			key_type start;
+			// the access flags of the range preceding this one
+			std::uint32_t prev_access;
+		};
+
+		// fills in the subtree rooted at ``k`` from ``sorted``, starting at
+		// index ``i``. Returns the index of the first node not used
+		std::size_t build_tree(std::vector<node> const& sorted, std::size_t i
+			, std::size_t const k)
+		{
+			if (k >= m_tree.size()) return i;
+			i = build_tree(sorted, i, 2 * k);
+			m_tree[k] = sorted[i++];
+			return build_tree(sorted, i, 2 * k + 1);
+		}
+
+		std::uint32_t compiled_access(Addr const& addr) const
+		{
+			// find the first range starting after addr. addr belongs to the
+			// range before it
+			key_type const key = filter_key(addr);
+			std::size_t const n = m_tree.size();
+			std::size_t k = 1;
+			std::size_t found = 0;
+			while (k < n)
+			{
+				bool const after = key < m_tree[k].start;
+				found = after ? k : found;
+				k = 2 * k + (after ? 0 : 1);
+			}
+			return found == 0 ? m_last_access : m_tree[found].prev_access;
+		}
+
+		std::uint32_t list_access(Addr const& addr) const
+		{
+			TORRENT_ASSERT(!m_access_list.empty());
+			auto i = m_access_list.upper_bound(addr);
+			if (i != m_access_list.begin()) --i;
+			TORRENT_ASSERT(i != m_access_list.end());
+			TORRENT_ASSERT(i->start <= addr && (std::next(i) == m_access_list.end()
+				|| addr < std::next(i)->start));
+			return i->access;
+		}
+
 		struct range
 		{
 			range(Addr addr, std::uint32_t a = 0) : start(addr), access(a) {} // NOLINT
@@ -252,6 +384,25 @@ namespace detail {
 		};
 
 		std::set<range> m_access_list;
+
+		// the compiled form of m_access_list, or empty if it hasn't been
+		// compiled since the last change. See compile()
+		std::vector<node> m_tree;
+
+		// the access flags of the last range
+		std::uint32_t m_last_access = 0;
+
+		struct added_rule
+		{
+			Addr first;
+			Addr last;
+			std::uint32_t flags;
+		};
+
+		// the rules added since the last compile(), while m_tree is in use.
+		// These are checked linearly before m_tree, so keep them few
+		static constexpr std::size_t max_added_rules = 64;
+		std::vector<added_rule> m_added;
 	};
 
 }
@@ -286,8 +437,27 @@ struct TORRENT_EXPORT ip_filter
 	//
 	// This means that in a case of overlapping ranges, the last one applied takes
 	// precedence.
+	//
+	// Rules added to a compiled filter (see compile()) are checked on the side
+	// of the compiled form. Once more than a few have been added, the compiled
+	// form is discarded. should_compile() tells when it's time to compile()
+	// again, to avoid that.
 	void add_rule(address const& first, address const& last, std::uint32_t flags);
 
+	// Builds a compact, read-only lookup structure from the current rules.
+	// access() uses it instead of walking the tree of ranges, which is
+	// considerably faster for large filters. The filter passed to
+	// session_handle::set_ip_filter() is compiled automatically, on the
+	// calling thread.
+	void compile();
+
+	// Returns true if the filter is compiled, but a number of rules have been
+	// added to it since. Those are not part of the compiled form and slow
+	// down access(). Once there are too many of them, the compiled form is
+	// discarded. The session uses this to compile a copy of its filter in
+	// the background, as peers are banned.
+	bool should_compile() const;
+
 	// Returns the access permissions for the given address (``addr``). The permission
 	// can currently be 0 or ``ip_filter::blocked``. The complexity of this operation
 	// is O(``log`` n), where n is the minimum number of non-overlapping ranges to describe
@@ -46,7 +46,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <libtorrent/kademlia/observer.hpp>
 #include <libtorrent/aux_/listen_socket_handle.hpp>
 
-namespace libtorrent { class entry; }
+namespace libtorrent {
+	class entry;
+	struct counters;
+}
 
 namespace libtorrent {
 namespace dht {
@@ -74,7 +77,8 @@ public:
 		, routing_table& table
 		, aux::listen_socket_handle const& sock
 		, socket_manager* sock_man
-		, dht_logger* log);
+		, dht_logger* log
+		, counters& cnt);
 	~rpc_manager();
 
 	void unreachable(udp::endpoint const& ep);
@@ -131,6 +135,7 @@ private:
 #endif
 	dht_settings const& m_settings;
 	routing_table& m_table;
+	counters& m_counters;
 	node_id m_our_id;
 	std::uint32_t m_allocated_observers:31;
 	std::uint32_t m_destructing:1;
@@ -39,6 +39,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/multiprecision/cpp_int.hpp>
+#include <boost/asio/io_service.hpp>
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
 
 #include "libtorrent/receive_buffer.hpp"
@@ -48,10 +49,16 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/span.hpp"
 #include "libtorrent/buffer.hpp"
 #include "libtorrent/aux_/array.hpp"
+#include "libtorrent/io_service.hpp"
 
 #include <list>
 #include <array>
 #include <cstdint>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <functional>
 
 namespace libtorrent {
 
@@ -68,6 +75,14 @@ namespace libtorrent {
 		aux::array<std::uint8_t, 256> buf;
 	};
 
+	// ChaCha20 state. The keystream is generated several blocks at a time,
+	// ``used`` is the number of bytes of ``keystream`` already consumed
+	struct chacha20 {
+		aux::array<std::uint32_t, 16> state;
+		aux::array<std::uint8_t, 256> keystream;
+		int used;
+	};
+
 	// TODO: 3 dh_key_exchange should probably move into its own file
 	class TORRENT_EXTRA_EXPORT dh_key_exchange
 	{
@@ -95,6 +110,70 @@ namespace libtorrent {
 		sha1_hash m_xor_mask;
 	};
 
+	// computes Diffie-Hellman keys for encrypted handshakes on a pool of
+	// threads, to keep the network thread responsive when many peers connect
+	// at once. It also keeps a number of local key pairs precomputed, ready to
+	// be handed out when a handshake starts. The member functions must be
+	// called from the thread running the io_service passed to the
+	// constructor, which is also where completion handlers are posted.
+	struct TORRENT_EXTRA_EXPORT dh_thread_pool
+	{
+		explicit dh_thread_pool(io_service& ios);
+		~dh_thread_pool();
+		dh_thread_pool(dh_thread_pool const&) = delete;
+		dh_thread_pool& operator=(dh_thread_pool const&) = delete;
+
+		// with no threads, key pairs and secrets are computed on the calling
+		// thread and no key pairs are precomputed. Changing the number of
+		// threads waits for all outstanding jobs to complete.
+		void set_num_threads(int num_threads);
+		int num_threads() const { return int(m_threads.size()); }
+
+		// the number of key pairs to keep precomputed
+		void set_pool_size(int pool_size);
+		int num_keypairs() const { return int(m_pool->keys.size()); }
+
+		// returns a new local key pair, taken from the precomputed ones if
+		// there are any left. Otherwise it's generated on the calling thread
+		std::shared_ptr<dh_key_exchange> get_keypair();
+
+		// computes the shared secret of ``kx`` given the remote public key on
+		// one of the threads and posts ``handler`` once done. ``kx`` must not be
+		// used in the meantime. This requires num_threads() > 0
+		void async_compute_secret(std::shared_ptr<dh_key_exchange> kx
+			, std::array<char, 96> const& remote_key, std::function<void()> handler);
+
+		// stops the threads. Outstanding jobs are dropped without posting their
+		// handlers
+		void abort();
+
+	private:
+
+		void fill_pool();
+		void stop_threads();
+
+		io_service& m_ios;
+
+		// the worker threads run this io_service
+		std::unique_ptr<boost::asio::io_service> m_job_ios;
+		std::unique_ptr<boost::asio::io_service::work> m_work;
+		std::vector<std::thread> m_threads;
+
+		// the precomputed key pairs. Completion handlers hold a weak reference
+		// to it, since they may run after this object is gone
+		struct keypair_pool
+		{
+			std::vector<std::shared_ptr<dh_key_exchange>> keys;
+
+			// the number of key pairs currently being generated
+			int outstanding = 0;
+		};
+		std::shared_ptr<keypair_pool> m_pool;
+		int m_pool_size = 0;
+
+		std::atomic<bool> m_abort{false};
+	};
+
 	struct TORRENT_EXTRA_EXPORT encryption_handler
 	{
 		std::tuple<int, span<span<char const>>>
@@ -155,6 +234,34 @@ namespace libtorrent {
 		bool m_decrypt;
 	};
 
+	// a stream cipher for the payload of encrypted connections, as an
+	// alternative to RC4. It is only used when both peers offer
+	// settings_pack::pe_chacha20. Each direction has its own key and an all
+	// zero nonce, which is safe since the keys are derived from the DH secret
+	// of the connection
+	struct TORRENT_EXTRA_EXPORT chacha20_handler : crypto_plugin
+	{
+	public:
+		chacha20_handler();
+
+		// Input keys must be 32 bytes
+		void set_incoming_key(span<char const> key) override;
+		void set_outgoing_key(span<char const> key) override;
+
+		std::tuple<int, span<span<char const>>>
+		encrypt(span<span<char>> buf) override;
+
+		std::tuple<int, int, int> decrypt(span<span<char>> buf) override;
+
+	private:
+		chacha20 m_incoming;
+		chacha20 m_outgoing;
+
+		// determines whether or not encryption and decryption is enabled
+		bool m_encrypt;
+		bool m_decrypt;
+	};
+
 } // namespace libtorrent
 
 #endif // TORRENT_DISABLE_ENCRYPTION
@@ -45,6 +45,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/chained_buffer.hpp"
 #include "libtorrent/disk_buffer_holder.hpp"
 #include "libtorrent/bitfield.hpp"
+#include "libtorrent/aux_/have_bitfield.hpp"
 #include "libtorrent/bandwidth_socket.hpp"
 #include "libtorrent/error_code.hpp"
 #include "libtorrent/sliding_average.hpp"
@@ -57,6 +58,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/io_service_fwd.hpp"
 #include "libtorrent/receive_buffer.hpp"
 #include "libtorrent/aux_/allocating_handler.hpp"
+#include "libtorrent/aux_/deferred_handler.hpp"
 #include "libtorrent/aux_/time.hpp"
 #include "libtorrent/debug.hpp"
 #include "libtorrent/span.hpp"
@@ -175,7 +177,7 @@ namespace aux {
 	protected:
 
 		// the pieces the other end have
-		typed_bitfield<piece_index_t> m_have_piece;
+		aux::have_bitfield m_have_piece;
 
 		// this is the torrent this connection is
 		// associated with. If the connection is an
@@ -354,7 +356,16 @@ namespace aux {
 		bool ignore_stats() const { return m_ignore_stats; }
 		void ignore_stats(bool b) { m_ignore_stats = b; }
 
+		// true while this peer is queued in its torrent's list of peers to
+		// request more blocks from (torrent::defer_request_blocks())
+		bool request_blocks_queued() const { return m_request_blocks_queued; }
+		void request_blocks_queued(bool b) { m_request_blocks_queued = b; }
+
+		// the BEP 40 priority of this peer. It's computed on first use and
+		// cached until clear_peer_rank() is called, when our external IP
+		// changes
 		std::uint32_t peer_rank() const;
+		void clear_peer_rank() { m_peer_rank = 0; }
 
 		void fast_reconnect(bool r);
 		bool fast_reconnect() const override { return m_fast_reconnect; }
@@ -451,7 +462,7 @@ namespace aux {
 		tcp::endpoint const& remote() const override { return m_remote; }
 		tcp::endpoint local_endpoint() const override { return m_local; }
 
-		typed_bitfield<piece_index_t> const& get_bitfield() const;
+		aux::have_bitfield const& get_bitfield() const;
 		std::vector<piece_index_t> const& allowed_fast();
 		std::vector<piece_index_t> const& suggested_pieces() const { return m_suggested_pieces; }
 
@@ -626,6 +637,11 @@ namespace aux {
 		void send_buffer(span<char const> buf);
 		void setup_send();
 
+		// hold back issuing a write to the socket until the current batch of
+		// handlers has run. Anything appended to the send buffer in the
+		// meantime is sent with a single vectored write
+		void defer_send();
+
 		template <typename Holder>
 		void append_send_buffer(Holder buffer, int size)
 		{
@@ -714,6 +730,29 @@ namespace aux {
 		virtual void on_sent(error_code const& error
 			, std::size_t bytes_transferred) = 0;
 
+		// while receiving is suspended, no more data is read from the socket.
+		// Bytes that have already been read stay in the receive buffer. This
+		// lets the protocol layer wait for an asynchronous operation before
+		// it parses any more input. resume_receive() must not be called while
+		// on_receive() is running
+		void suspend_receive();
+		void resume_receive();
+
+		// once the header of a PIECE message has been parsed, the rest of its
+		// payload may be read from the socket straight into a disk buffer,
+		// instead of through the receive buffer. ``received`` is the part of
+		// the payload already in the receive buffer. If this returns true, the
+		// protocol layer must consider the message consumed, incoming_piece()
+		// is called once the payload is complete. If it returns false, the
+		// payload keeps arriving through the receive buffer.
+		bool receive_piece_into_disk_buffer(peer_request const& r
+			, span<char const> received);
+
+		// returns true while the payload of a PIECE message is being read
+		// into a disk buffer, see receive_piece_into_disk_buffer()
+		bool receiving_into_disk_buffer() const { return bool(m_recv_piece_buffer); }
+		piece_block_progress disk_buffer_piece_progress() const;
+
 		void send_piece_suggestions(int num);
 
 		virtual
@@ -752,10 +791,16 @@ namespace aux {
 
 		void account_received_bytes(int bytes_transferred);
 
+		void incoming_piece_impl(peer_request const& p, char const* data
+			, disk_buffer_holder buffer, bool exceeded);
+		void incoming_piece_payload(int bytes);
+
 		// explicitly disallow assignment, to silence msvc warning
 		peer_connection& operator=(peer_connection const&);
 
 		void do_update_interest();
+		void do_deferred_send();
+		void coalesce_send(int bytes);
 		void fill_send_buffer();
 		void on_disk_read_complete(disk_buffer_holder disk_block, disk_job_flags_t flags
 			, storage_error const& error, peer_request const& r, time_point issue_time);
@@ -771,6 +816,22 @@ namespace aux {
 
 		std::shared_ptr<aux::socket_type> m_socket;
 
+		// while the payload of a PIECE message is read straight into a disk
+		// buffer, this holds the buffer. m_recv_piece is the block it belongs
+		// to and m_recv_piece_pos the number of payload bytes received so far
+		disk_buffer_holder m_recv_piece_buffer;
+		peer_request m_recv_piece{};
+		int m_recv_piece_pos = 0;
+
+		// set if allocating m_recv_piece_buffer took the disk cache above its
+		// limit
+		bool m_recv_piece_exceeded = false;
+
+		// the number of bytes of messages appended to the send buffer since
+		// the last write was issued. Once this reaches send_coalesce_bytes,
+		// a deferred send is flushed right away
+		int m_coalesced_bytes = 0;
+
 		// the queue of blocks we have requested
 		// from this peer
 		aux::vector<pending_block> m_download_queue;
@@ -931,6 +992,10 @@ namespace aux {
 		aux::handler_storage<TORRENT_READ_HANDLER_MAX_SIZE> m_read_handler_storage;
 		aux::handler_storage<TORRENT_WRITE_HANDLER_MAX_SIZE> m_write_handler_storage;
 
+		// posts do_deferred_send(), at most one at a time
+		aux::deferred_handler m_deferred_send_handler;
+		aux::handler_storage<96> m_deferred_send_storage;
+
 		// these are pieces we have recently sent suggests for to this peer.
 		// it just serves as a queue to remember what we've sent, to avoid
 		// re-sending suggests for the same piece
@@ -1061,6 +1126,12 @@ namespace aux {
 		// are preferred.
 		int m_prefer_contiguous_blocks = 0;
 
+		// cached value of peer_rank(). torrent_peer doesn't store the rank,
+		// to keep peer list entries small, but it's needed for every
+		// connection each time an incoming peer arrives at a full torrent.
+		// 0 means it has not been computed yet
+		mutable std::uint32_t m_peer_rank = 0;
+
 		// this is the number of times this peer has had
 		// a request rejected because of a disk I/O failure.
 		// once this reaches a certain threshold, the
@@ -1148,6 +1219,18 @@ namespace aux {
 		// the actual computation is done in do_update_interest().
 		bool m_need_interest_update:1;
 
+		// set to true while the socket is corked, waiting for the posted
+		// do_deferred_send(). While this is set, the upload channel is marked
+		// as bw_network, the same way an outstanding write does
+		bool m_deferred_send:1;
+
+		// set while this peer is in torrent::m_peers_to_request, to only queue
+		// it once no matter how many blocks it receives in one round
+		bool m_request_blocks_queued:1;
+
+		// set by suspend_receive(). While this is set, can_read() returns false
+		bool m_receive_suspended:1;
+
 		// set to true if this peer has metadata, and false
 		// otherwise.
 		bool m_has_metadata:1;
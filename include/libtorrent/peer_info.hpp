@@ -202,6 +202,10 @@ TORRENT_VERSION_NAMESPACE_2
 		// with a Diffie-Hellman exchange
 		static constexpr peer_flags_t plaintext_encrypted = 20_bit;
 
+		// this connection's payload is encrypted with ChaCha20. See
+		// settings_pack::pe_chacha20
+		static constexpr peer_flags_t chacha20_encrypted = 21_bit;
+
 		// tells you in which state the peer is in. It is set to
 		// any combination of the peer_flags_t flags above.
 		peer_flags_t flags;
@@ -144,8 +144,8 @@ namespace libtorrent {
 
 		void set_seed(torrent_peer* p, bool s);
 
-		// this clears all cached peer priorities. It's called when
-		// our external IP changes
+		// this clears all cached connect candidates, since they're ordered by
+		// peer priority. It's called when our external IP changes
 		void clear_peer_prio();
 
 #if TORRENT_USE_ASSERTS
@@ -204,8 +204,24 @@ namespace libtorrent {
 		bool insert_peer(torrent_peer* p, iterator iter
 			, pex_flags_t flags, torrent_state* state);
 
+		// the properties connect candidates are ordered by. They are computed
+		// once for every peer visited by find_connect_candidates(), rather than
+		// on every comparison. The rank is only needed to break ties, and is
+		// computed lazily. 0 means it hasn't been computed yet.
+		struct candidate_key
+		{
+			torrent_peer* peer;
+			mutable std::uint32_t rank;
+			std::uint16_t last_connected;
+			std::uint8_t failcount;
+			std::uint8_t source_rank;
+			bool local;
+		};
+
+		candidate_key make_candidate_key(torrent_peer* p) const;
+
 		bool compare_peer_erase(torrent_peer const& lhs, torrent_peer const& rhs) const;
-		bool compare_peer(torrent_peer const* lhs, torrent_peer const* rhs
+		bool compare_peer(candidate_key const& lhs, candidate_key const& rhs
 			, external_ip const& external, int source_port) const;
 
 		void find_connect_candidates(std::vector<torrent_peer*>& peers
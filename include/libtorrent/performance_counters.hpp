@@ -44,6 +44,10 @@ namespace libtorrent {
 
 	struct TORRENT_EXTRA_EXPORT counters
 	{
+		// the number of buckets in each latency histogram. See
+		// latency_bucket()
+		static constexpr int num_latency_buckets = 28;
+
 		// TODO: move this out of counters
 		enum stats_counter_t
 		{
@@ -143,6 +147,9 @@ namespace libtorrent {
 			on_disk_queue_counter,
 			on_disk_counter,
 
+			// alerts dropped because the alert queue was full
+			alerts_dropped,
+
 #if TORRENT_ABI_VERSION == 1
 			torrent_evicted_counter,
 #endif
@@ -190,6 +197,9 @@ namespace libtorrent {
 			num_outgoing_metadata,
 			num_outgoing_extended,
 
+			// HAVE messages not sent because the peer had no use for them
+			num_suppressed_have,
+
 			num_piece_passed,
 			num_piece_failed,
 
@@ -270,6 +280,7 @@ namespace libtorrent {
 			utp_payload_pkts_out,
 			utp_invalid_pkts_in,
 			utp_redundant_pkts_in,
+			utp_demux_probes,
 
 			// the buffer sizes accepted by
 			// socket send calls. The larger
@@ -325,6 +336,33 @@ namespace libtorrent {
 			socket_recv_size19,
 			socket_recv_size20,
 
+			// log-linear latency histograms. Each histogram is a run of
+			// num_latency_buckets counters, the first of which is the one
+			// named here. Samples are added with add_latency_sample()
+
+			// the time disk jobs spend queued, from being issued until a disk
+			// thread starts executing them
+			disk_queue_latency,
+			disk_queue_latency_last = disk_queue_latency + num_latency_buckets - 1,
+
+			// the time it takes disk threads to execute jobs, by job type
+			disk_read_latency,
+			disk_read_latency_last = disk_read_latency + num_latency_buckets - 1,
+			disk_write_latency,
+			disk_write_latency_last = disk_write_latency + num_latency_buckets - 1,
+			disk_hash_latency,
+			disk_hash_latency_last = disk_hash_latency + num_latency_buckets - 1,
+			disk_other_latency,
+			disk_other_latency_last = disk_other_latency + num_latency_buckets - 1,
+
+			// the round-trip time of DHT requests that received a reply
+			dht_rpc_latency,
+			dht_rpc_latency_last = dht_rpc_latency + num_latency_buckets - 1,
+
+			// the time spent in the session's tick function
+			on_tick_latency,
+			on_tick_latency_last = on_tick_latency + num_latency_buckets - 1,
+
 			num_stats_counters
 		};
 
@@ -483,21 +521,52 @@ namespace libtorrent {
 		counters(counters const&) TORRENT_COUNTER_NOEXCEPT;
 		counters& operator=(counters const&) TORRENT_COUNTER_NOEXCEPT;
 
-		// returns the new value
-		std::int64_t inc_stats_counter(int c, std::int64_t value = 1) TORRENT_COUNTER_NOEXCEPT;
+		void inc_stats_counter(int c, std::int64_t value = 1) TORRENT_COUNTER_NOEXCEPT;
+
+		// reading a counter sums it across all shards, i.e. it loads
+		// ``num_shards`` atomics from different cache lines. Incrementing is
+		// cheap, but avoid reading counters on hot paths
 		std::int64_t operator[](int i) const TORRENT_COUNTER_NOEXCEPT;
 
 		void set_value(int c, std::int64_t value) TORRENT_COUNTER_NOEXCEPT;
 		void blend_stats_counter(int c, std::int64_t value, int ratio) TORRENT_COUNTER_NOEXCEPT;
 
+		// adds a sample of ``microseconds`` to the latency histogram starting
+		// at counter ``histogram``, e.g. disk_queue_latency
+		void add_latency_sample(int histogram, std::int64_t microseconds) TORRENT_COUNTER_NOEXCEPT;
+
+		// returns the histogram bucket ``microseconds`` falls in. Bucket 0 is
+		// everything below 128 us and the last bucket everything from 2^20 us
+		// (about 1 s) and up. In between, every power of two is split in two
+		// equally wide buckets, i.e. [128, 192), [192, 256), [256, 384) etc.
+		static int latency_bucket(std::int64_t microseconds);
+
 	private:
 
 		// TODO: some space could be saved here by making gauges 32 bits
-		// TODO: restore these to regular integers. Instead have one copy
-		// of the counters per thread and collect them at convenient
-		// synchronization points
 #ifdef ATOMIC_LLONG_LOCK_FREE
-		aux::array<std::atomic<std::int64_t>, num_counters> m_stats_counter;
+		// the network thread, the disk threads and the hasher threads all
+		// update counters. To not have them fight over the same cache lines,
+		// every thread increments its own shard and reading a counter sums it
+		// across all shards. Threads are assigned to shards round-robin, so
+		// with more threads than shards some will share one.
+		// Every shard holds all counters, which makes a counters object
+		// num_shards * (num_counters * 8 + 64) bytes, about 64 kiB. Normally
+		// there's only one, owned by the session. tools/benchmark.cpp
+		// compares this to a single shared array
+		static constexpr int num_shards = 16;
+
+		struct shard
+		{
+			aux::array<std::atomic<std::int64_t>, num_counters> values;
+			// keeps the last counter of one shard and the first counter of
+			// the next one from sharing a cache line
+			char padding[64];
+		};
+
+		static int thread_shard();
+
+		aux::array<shard, num_shards> m_shards;
 #else
 		// if the atomic type is't lock-free, use a single lock instead, for
 		// the whole array
@@ -65,6 +65,7 @@ namespace libtorrent {
 	struct typed_bitfield;
 	struct counters;
 	struct torrent_peer;
+	namespace aux { struct have_bitfield; }
 
 	using prio_index_t = aux::strong_typedef<int, struct prio_index_tag_t>;
 	using picker_options_t = flags::bitfield_flag<std::uint16_t, struct picker_options_tag>;
@@ -222,6 +223,11 @@ namespace libtorrent {
 		void dec_refcount(typed_bitfield<piece_index_t> const& bitmask
 			, const torrent_peer* peer);
 
+		// the same as the bitfield overloads, for a peer's set of pieces
+		// in whatever form it's stored
+		void inc_refcount(aux::have_bitfield const& pieces, const torrent_peer* peer);
+		void dec_refcount(aux::have_bitfield const& pieces, const torrent_peer* peer);
+
 		// these will increase and decrease the peer count
 		// of all pieces. They are used when seeds join
 		// or leave the swarm.
@@ -296,6 +302,18 @@ namespace libtorrent {
 			, counters& pc
 			) const;
 
+		// the same as above, for the pieces of a peer in whatever form they're
+		// stored. The pieces of a seed (the all form) are matched against
+		// m_all_pieces and the dense form is used as it is. Only the sparse
+		// form is expanded into a bitfield
+		picker_flags_t pick_pieces(aux::have_bitfield const& pieces
+			, std::vector<piece_block>& interesting_blocks, int num_blocks
+			, int prefer_contiguous_blocks, torrent_peer* peer
+			, picker_options_t options, std::vector<piece_index_t> const& suggested_pieces
+			, int num_peers
+			, counters& pc
+			) const;
+
 		// picks blocks from each of the pieces in the piece_list
 		// vector that is also in the piece bitmask. The blocks
 		// are added to interesting_blocks, and busy blocks are
@@ -390,6 +408,15 @@ namespace libtorrent {
 		// has passed the hash check
 		bool has_piece_passed(piece_index_t index) const;
 
+		// returns the first piece set in ``bits`` that we still want, i.e. a
+		// piece that has neither passed the hash check nor has priority
+		// dont_download. Returns -1 if there is no such piece. This is used to
+		// determine whether a peer is interesting, and is linear in the number
+		// of words rather than the number of pieces
+		piece_index_t first_wanted_piece(typed_bitfield<piece_index_t> const& bits) const
+		{ return piece_index_t(bits.find_first_set_and_not(m_passed_or_filtered)); }
+		piece_index_t first_wanted_piece(aux::have_bitfield const& pieces) const;
+
 		// returns the number of blocks there is in the given piece
 		int blocks_in_piece(piece_index_t index) const;
 
@@ -473,7 +500,7 @@ namespace libtorrent {
 		void verify_pick(std::vector<piece_block> const& picked
 			, typed_bitfield<piece_index_t> const& bits) const;
 
-		void check_peer_invariant(typed_bitfield<piece_index_t> const& have
+		void check_peer_invariant(aux::have_bitfield const& have
 			, torrent_peer const* p) const;
 		void check_invariant(const torrent* t = nullptr) const;
 #endif
@@ -803,6 +830,17 @@ namespace libtorrent {
 		// the number of pieces that have passed the hash check
 		int m_num_passed = 0;
 
+		// one bit per piece, set for pieces that have passed the hash check or
+		// are filtered (have priority dont_download). This mirrors the state in
+		// m_piece_map and m_downloads, in a form that lets whole bitfields be
+		// matched against it a word at a time
+		typed_bitfield<piece_index_t> m_passed_or_filtered;
+
+		// one bit per piece, all set. This is what the pieces of a seed look
+		// like as a bitfield. Keeping it here saves pick_pieces() from
+		// building one for every request to a seed
+		typed_bitfield<piece_index_t> m_all_pieces;
+
 		// this vector contains all piece indices that are pickable
 		// sorted by priority. Pieces are in random random order
 		// among pieces with the same priority
@@ -54,6 +54,19 @@ namespace libtorrent {
 		, error_code& ec);
 	TORRENT_EXPORT add_torrent_params read_resume_data(bdecode_node const& rd);
 	TORRENT_EXPORT add_torrent_params read_resume_data(span<char const> buffer);
+
+	// parses resume data in the binary format written by
+	// write_resume_data_binary(). The binary format is recognized by
+	// read_resume_data() as well, so this is only needed to reject resume data
+	// in the bencoded format.
+	TORRENT_EXPORT add_torrent_params read_resume_data_binary(span<char const> buffer
+		, error_code& ec);
+	TORRENT_EXPORT add_torrent_params read_resume_data_binary(span<char const> buffer);
+
+namespace aux {
+	// returns true if ``buffer`` starts with the binary resume data header
+	TORRENT_EXTRA_EXPORT bool is_binary_resume_data(span<char const> buffer);
+}
 }
 
 #endif
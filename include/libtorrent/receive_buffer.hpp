@@ -77,9 +77,17 @@ struct TORRENT_EXTRA_EXPORT receive_buffer
 	// cursor
 	int advance_pos(int bytes);
 
+	// move the read cursor back by ``bytes``. Those bytes stay in the buffer
+	// and are handed out again by subsequent calls to advance_pos()
+	void rewind(int bytes);
+
 	// has the read cursor reached the end cursor?
 	bool pos_at_end() { return m_recv_pos == m_recv_end; }
 
+	// the number of bytes received past the read cursor, that have not been
+	// handed to the upper layer yet
+	int bytes_pending() const { return m_recv_end - m_recv_start - m_recv_pos; }
+
 	// size = the packet size to remove from the receive buffer
 	// packet_size = the next packet size to receive in the buffer
 	// offset = the offset into the receive buffer where to remove `size` bytes
@@ -250,6 +250,26 @@ namespace libtorrent {
 		void async_add_torrent(add_torrent_params&& params);
 		void async_add_torrent(add_torrent_params const& params);
 
+		// ``async_add_torrents()`` adds many torrents at once, for instance
+		// when restoring a session at startup. The add_torrent_params are
+		// validated on a pool of worker threads (see
+		// settings_pack::torrent_load_threads) and handed to the network
+		// thread in batches, so the session keeps servicing peers while a large
+		// number of torrents are being added. Torrents are added in the order
+		// they appear in ``params``.
+		//
+		// ``async_load_torrents()`` takes resume data buffers instead, as
+		// produced by write_resume_data_buf() or write_resume_data_binary(), and
+		// also runs read_resume_data() on them on the worker threads. This
+		// includes parsing the torrent's info-dictionary. ``save_path`` is used
+		// for resume data that does not specify one.
+		//
+		// Just like async_add_torrent(), an add_torrent_alert is posted for
+		// every torrent, whether it was added successfully or not.
+		void async_add_torrents(std::vector<add_torrent_params> params);
+		void async_load_torrents(std::vector<std::vector<char>> resume_data
+			, std::string const& save_path);
+
 #ifndef BOOST_NO_EXCEPTIONS
 #if TORRENT_ABI_VERSION == 1
 		// deprecated in 0.14
@@ -621,6 +641,9 @@ namespace libtorrent {
 		// Each time a peer is blocked because of the IP filter, a
 		// peer_blocked_alert is generated. ``get_ip_filter()`` Returns the
 		// ip_filter currently in the session. See ip_filter.
+		//
+		// The filter is compiled (see ip_filter::compile()) on the calling
+		// thread before it is handed to the session.
 		void set_ip_filter(ip_filter const& f);
 		ip_filter get_ip_filter() const;
 
@@ -321,6 +321,14 @@ namespace aux {
 			// effect until the DHT is restarted.
 			dht_bootstrap_nodes,
 
+			// if set to a file path, the session exports its performance
+			// counters through a memory mapped file at that path. The file is
+			// refreshed once per second and can be read by other processes
+			// without any alerts being posted. See stats_page for the layout.
+			// Set to an empty string to stop exporting. This is only supported
+			// on systems with mmap().
+			stats_page_path,
+
 			max_string_setting_internal
 		};
 
@@ -785,7 +793,8 @@ namespace aux {
 			enable_dht,
 
 			// if the allowed encryption level is both, setting this to true will
-			// prefer RC4 if both methods are offered, plain text otherwise
+			// prefer RC4 if both methods are offered, plain text otherwise. If
+			// pe_chacha20 is allowed and offered, it is preferred over RC4
 			prefer_rc4,
 
 			// if true, hostname lookups are done via the configured proxy (if
@@ -835,6 +844,22 @@ namespace aux {
 			// HTTPS trackers to fail.
 			validate_https_trackers,
 
+			// when true, uTP sockets spread the packets of each congestion
+			// window over the round-trip time instead of sending them in a
+			// burst as soon as the window opens. This avoids building a queue
+			// at the bottleneck, which the delay based congestion controller
+			// would otherwise react to. It is recommended when using the
+			// ``utp_bbr`` congestion controller.
+			utp_pacing,
+
+			// when true (the default), every hole in a uTP selective ACK that
+			// is followed by enough ACKed packets is considered lost, and all
+			// of them are resent as the congestion window allows. When false,
+			// at most the first 5 holes of each selective ACK are resent,
+			// immediately and regardless of the congestion window. Any holes
+			// past those are left to later ACKs or the retransmission timeout.
+			utp_sack_scoreboard,
+
 			max_bool_setting_internal
 		};
 
@@ -1769,6 +1794,52 @@ namespace aux {
 			// outstanding announce completes.
 			max_concurrent_http_announces,
 
+			// the congestion controller used by uTP sockets. See
+			// utp_congestion_control_t for options. The controller is chosen
+			// when a socket is created, changing this setting only affects new
+			// sockets.
+			utp_congestion_control,
+
+			// the number of threads used to parse and validate torrents added
+			// through session_handle::async_add_torrents() and
+			// session_handle::async_load_torrents(). The threads are started the
+			// first time one of those functions is called. Changes to this
+			// setting apply to subsequent calls. Lowering it leaves the extra
+			// threads idle until the session is destructed.
+			torrent_load_threads,
+
+			// the number of threads computing the Diffie-Hellman keys of
+			// encrypted handshakes. While the shared secret of a connection is
+			// computed, the handshake is suspended and the network thread serves
+			// other peers. When set to 0, keys are computed on the network
+			// thread.
+			dh_threads,
+
+			// the number of local Diffie-Hellman key pairs the DH threads keep
+			// precomputed, ready for new encrypted handshakes. Once they run
+			// out, key pairs are generated on the network thread until the pool
+			// has been refilled. This has no effect if dh_threads is 0.
+			dh_keypair_pool_size,
+
+			// when set, small messages, such as HAVE, REQUEST, CANCEL and
+			// extension messages, are not written to a peer's socket one at a
+			// time. They are held back until the current batch of network
+			// events has been handled, and then sent in a single write. Once
+			// ``send_coalesce_bytes`` bytes have accumulated, they are sent
+			// right away. This delays the handshake and requests as well, which
+			// costs latency on connections that aren't sending many messages.
+			// The default, 0, sends every message as soon as possible.
+			send_coalesce_bytes,
+
+			// when set to a value greater than 0, HAVE messages are sent in
+			// batches, every ``have_batch_interval`` seconds, rather than as
+			// soon as a piece passes the hash check. In this mode, peers that
+			// already have the piece, and peers that are upload-only, are not
+			// sent HAVE messages at all. If such a peer later loses a piece we
+			// have, it is sent a HAVE message for it.
+			// The ``ses.num_suppressed_have`` counter tracks the messages saved.
+			have_batch_interval,
+
 			max_int_setting_internal
 		};
 
@@ -1844,6 +1915,22 @@ namespace aux {
 			peer_proportional = 1
 		};
 
+		enum utp_congestion_control_t : std::uint8_t
+		{
+			// the delay based LEDBAT controller. It yields to other traffic by
+			// keeping the queuing delay it causes below utp_target_delay.
+			utp_ledbat = 0,
+
+			// a model based controller, in the spirit of BBR. It estimates the
+			// bottleneck bandwidth and the round-trip propagation delay from
+			// ACKs and sizes the congestion window to twice their product. It
+			// does not back off in response to delay or isolated packet loss,
+			// which makes it suitable for long, fast links, but it does not
+			// yield to competing traffic the way LEDBAT does. Rounds with loss
+			// limit the window to one bandwidth-delay product.
+			utp_bbr = 1
+		};
+
 		// the encoding policy options for use with
 		// settings_pack::out_enc_policy and settings_pack::in_enc_policy.
 		enum enc_policy : std::uint8_t
@@ -1872,7 +1959,15 @@ namespace aux {
 			// use only RC4 encryption
 			pe_rc4 = 2,
 			// allow both
-			pe_both = 3
+			pe_both = 3,
+			// use ChaCha20 to encrypt the payload stream. This is not part of
+			// the standard protocol encryption, only peers that also support
+			// it will select it. It's meant for swarms where both ends are
+			// known to run this library, and is much cheaper than RC4 on large
+			// transfers. The handshake itself is still obfuscated with RC4
+			pe_chacha20 = 4,
+			// allow all of the above
+			pe_all = 7
 		};
 
 		enum proxy_type_t : std::uint8_t
@@ -793,7 +793,7 @@ namespace libtorrent {
 		}
 
 		void set_super_seeding(bool on);
-		piece_index_t get_piece_to_super_seed(typed_bitfield<piece_index_t> const&);
+		piece_index_t get_piece_to_super_seed(aux::have_bitfield const&);
 #endif
 
 		// returns true if we have downloaded the given piece
@@ -863,12 +863,12 @@ namespace libtorrent {
 		void peer_has(piece_index_t index, peer_connection const* peer);
 
 		// when we get a bitfield message, this is called for that piece
-		void peer_has(typed_bitfield<piece_index_t> const& bits, peer_connection const* peer);
+		void peer_has(aux::have_bitfield const& bits, peer_connection const* peer);
 
 		void peer_has_all(peer_connection const* peer);
 
 		void peer_lost(piece_index_t index, peer_connection const* peer);
-		void peer_lost(typed_bitfield<piece_index_t> const& bits
+		void peer_lost(aux::have_bitfield const& bits
 			, peer_connection const* peer);
 
 		int block_size() const
@@ -1182,13 +1182,18 @@ namespace libtorrent {
 		}
 
 		int get_suggest_pieces(std::vector<piece_index_t>& p
-			, typed_bitfield<piece_index_t> const& bits
+			, aux::have_bitfield const& bits
 			, int const n)
 		{
 			return m_suggest_pieces.get_pieces(p, bits, n);
 		}
 		void add_suggest_piece(piece_index_t index);
 
+		// queue the peer to have more blocks requested from it. The picking is
+		// deferred to the end of the current message queue, so that all peers
+		// that had blocks arrive in the same round share a single pass
+		void defer_request_blocks(peer_connection* p);
+
 		static constexpr int no_gauge_state = 0xf;
 
 	private:
@@ -1199,6 +1204,12 @@ namespace libtorrent {
 		// trigger deferred disconnection of peers
 		void on_remove_peers() noexcept;
 
+		// run the piece picker for all peers queued by defer_request_blocks()
+		void request_deferred_blocks();
+
+		// send HAVE messages to all peers, for the pieces queued by we_have()
+		void broadcast_haves();
+
 		void ip_filter_updated();
 
 		void inc_stats_counter(int c, int value = 1);
@@ -1478,6 +1489,25 @@ namespace libtorrent {
 		aux::deferred_handler m_deferred_disconnect;
 		aux::handler_storage<96> m_deferred_handler_storage;
 
+		// peers whose request queue should be refilled. These are all served
+		// in one pass once the message queue has been drained, rather than
+		// invoking the piece picker once per incoming block. Each peer is in
+		// here at most once (peer_connection::request_blocks_queued())
+		std::vector<std::weak_ptr<peer_connection>> m_peers_to_request;
+		aux::deferred_handler m_deferred_request;
+		aux::handler_storage<96> m_deferred_request_handler_storage;
+
+		// pieces that passed the hash check and have yet to be announced to
+		// our peers. All pieces passing in the same round are announced in
+		// one pass over the peers, once the message queue has been drained
+		std::vector<piece_index_t> m_pending_haves;
+		aux::deferred_handler m_deferred_have;
+		aux::handler_storage<96> m_deferred_have_handler_storage;
+
+		// when HAVE messages are batched (have_batch_interval), the last time
+		// m_pending_haves was announced
+		time_point32 m_last_have_batch = aux::time_now32();
+
 		// these are the peer IDs we've used for our outgoing peer connections for
 		// this torrent. If we get an incoming peer claiming to have one of these,
 		// it's a connection to ourself, and we should reject it.
@@ -128,6 +128,14 @@ namespace libtorrent {
 
 		// the max number of bdecode tokens
 		int max_decode_tokens = 3000000;
+
+		// when loading a .torrent file from disk, map it into memory instead
+		// of reading it into a buffer. The info-dictionary is then referenced
+		// in place rather than copied, which saves memory and load time for
+		// very large torrents. The file must not be modified or truncated for
+		// as long as the torrent_info object exists. This is only supported on
+		// systems with mmap(), elsewhere the file is read as usual.
+		bool map_file = false;
 	};
 
 	// the torrent_info class holds the information found in a .torrent file.
@@ -609,6 +617,13 @@ namespace libtorrent {
 		bool parse_torrent_file(bdecode_node const& libtorrent, error_code& ec);
 		bool parse_torrent_file(bdecode_node const& libtorrent, error_code& ec, int piece_limit);
 
+		// if ``backing`` is set, it holds the buffer the bdecode_node refers
+		// to. The info section is then referenced in place instead of copied
+		bool parse_torrent_file(bdecode_node const& libtorrent, error_code& ec
+			, int piece_limit, boost::shared_array<char> const& backing);
+		bool parse_info_section(bdecode_node const& e, error_code& ec
+			, int piece_limit, boost::shared_array<char> const& backing);
+
 		void resolve_duplicate_filenames();
 
 		// the slow path, in case we detect/suspect a name collision
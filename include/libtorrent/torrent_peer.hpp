@@ -94,11 +94,6 @@ namespace libtorrent {
 		// will refer to a valid peer_connection
 		peer_connection_interface* connection;
 
-		// as computed by hashing our IP with the remote
-		// IP of this peer
-		// calculated lazily
-		mutable std::uint32_t peer_rank;
-
 		// the time when this torrent_peer was optimistically unchoked
 		// the last time. in seconds since session was created
 		// 16 bits is enough to last for 18.2 hours
@@ -206,6 +201,9 @@ namespace libtorrent {
 #endif
 	};
 
+	// there may be hundreds of thousands of these, keep them small. The fields
+	// of torrent_peer leave room for the IPv4 address in its tail padding,
+	// making ipv4_peer 32 bytes on 64 bit systems.
 	struct TORRENT_EXTRA_EXPORT ipv4_peer : torrent_peer
 	{
 		ipv4_peer(tcp::endpoint const& ip, bool connectable, peer_source_flags_t src);
@@ -215,6 +213,13 @@ namespace libtorrent {
 		address_v4 addr;
 	};
 
+#ifndef _MSC_VER
+	// MSVC doesn't place derived class members in the base class' tail
+	// padding
+	static_assert(sizeof(void*) != 8 || sizeof(ipv4_peer) <= 32
+		, "ipv4_peer is expected to fit in 32 bytes");
+#endif
+
 #if TORRENT_USE_I2P
 	struct TORRENT_EXTRA_EXPORT i2p_peer : torrent_peer
 	{
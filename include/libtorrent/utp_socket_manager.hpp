@@ -33,7 +33,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef TORRENT_UTP_SOCKET_MANAGER_HPP_INCLUDED
 #define TORRENT_UTP_SOCKET_MANAGER_HPP_INCLUDED
 
-#include <map>
+#include <unordered_map>
 #include <functional>
 
 #include "libtorrent/aux_/socket_type.hpp"
@@ -42,6 +42,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/session_settings.hpp"
 #include "libtorrent/span.hpp"
 #include "libtorrent/packet_pool.hpp"
+#include "libtorrent/deadline_timer.hpp"
 
 namespace libtorrent {
 
@@ -93,6 +94,11 @@ namespace libtorrent {
 			, error_code& ec, udp_send_flags_t flags = {});
 		void subscribe_writable(utp_socket_impl* s);
 
+		// sockets that are ahead of their pacing schedule subscribe to be
+		// notified at (or shortly after) the time they may send again. All
+		// sockets share one timer
+		void subscribe_paced(utp_socket_impl* s, time_point when);
+
 		void remove_udp_socket(std::weak_ptr<utp_socket_interface> sock);
 
 		// internal, used by utp_stream
@@ -108,6 +114,9 @@ namespace libtorrent {
 		int min_timeout() const { return m_sett.get_int(settings_pack::utp_min_timeout); }
 		int loss_multiplier() const { return m_sett.get_int(settings_pack::utp_loss_multiplier); }
 		int cwnd_reduce_timer() const { return m_sett.get_int(settings_pack::utp_cwnd_reduce_timer); }
+		int congestion_control() const { return m_sett.get_int(settings_pack::utp_congestion_control); }
+		bool pacing() const { return m_sett.get_bool(settings_pack::utp_pacing); }
+		bool sack_scoreboard() const { return m_sett.get_bool(settings_pack::utp_sack_scoreboard); }
 
 		std::pair<int, int> mtu_for_dest(address const& addr);
 		int num_sockets() const { return int(m_utp_sockets.size()); }
@@ -142,8 +151,11 @@ namespace libtorrent {
 		send_fun_t m_send_fun;
 		incoming_utp_callback_t m_cb;
 
-		// replace with a hash-map
-		using socket_map_t = std::multimap<std::uint16_t, utp_socket_impl*>;
+		// sockets are keyed by their receive connection ID. Several sockets
+		// (to different endpoints) may share an ID, and a socket is added
+		// before its remote endpoint is known, so the endpoint can't be part
+		// of the key
+		using socket_map_t = std::unordered_multimap<std::uint16_t, utp_socket_impl*>;
 		socket_map_t m_utp_sockets;
 
 		using socket_vector_t = std::vector<utp_socket_impl*>;
@@ -181,6 +193,18 @@ namespace libtorrent {
 
 		io_service& m_ios;
 
+		// sockets waiting for m_pacing_timer to be allowed to send more
+		// payload
+		socket_vector_t m_paced_sockets;
+
+		void on_pacing_timer(error_code const& ec);
+
+		deadline_timer m_pacing_timer;
+
+		// the time m_pacing_timer is set to expire, or time_point::max() if
+		// it's not armed
+		time_point m_pacing_deadline = time_point::max();
+
 		std::array<int, 3> m_restrict_mtu;
 		int m_mtu_idx = 0;
 
@@ -170,6 +170,7 @@ int utp_socket_state(utp_socket_impl const* s);
 void utp_send_ack(utp_socket_impl* s);
 void utp_socket_drained(utp_socket_impl* s);
 void utp_writable(utp_socket_impl* s);
+void utp_paced(utp_socket_impl* s);
 
 // this is the user-level stream interface to utp sockets.
 // the reason why it's split up in a utp_stream class and
@@ -38,6 +38,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/fwd.hpp"
 #include "libtorrent/aux_/export.hpp"
 #include "libtorrent/bencode.hpp"
+#include "libtorrent/span.hpp"
+#include "libtorrent/error_code.hpp"
 
 namespace libtorrent {
 
@@ -45,6 +47,19 @@ namespace libtorrent {
 	// into a bencoded structure
 	TORRENT_EXPORT entry write_resume_data(add_torrent_params const& atp);
 	TORRENT_EXPORT std::vector<char> write_resume_data_buf(add_torrent_params const& atp);
+
+	// writes the resume data in ``atp`` in a compact, versioned binary format.
+	// It's several times faster to load than the bencoded format, since it
+	// can be parsed in a single pass without building a bdecode tree. It's
+	// loaded by read_resume_data() and read_resume_data_binary().
+	TORRENT_EXPORT std::vector<char> write_resume_data_binary(add_torrent_params const& atp);
+
+	// convert resume data between the bencoded and the binary format. On
+	// error, ``ec`` is set and an empty buffer is returned.
+	TORRENT_EXPORT std::vector<char> resume_data_to_binary(span<char const> buffer
+		, error_code& ec);
+	TORRENT_EXPORT std::vector<char> resume_data_to_bencoded(span<char const> buffer
+		, error_code& ec);
 }
 
 #endif
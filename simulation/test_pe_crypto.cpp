@@ -62,11 +62,14 @@ void display_pe_settings(lt::settings_pack const& s)
 	std::printf("enc_level - %s\t\tprefer_rc4 - %s\n"
 		, s.get_int(settings_pack::allowed_enc_level) == settings_pack::pe_plaintext ? "plaintext"
 		: s.get_int(settings_pack::allowed_enc_level) == settings_pack::pe_rc4 ? "rc4"
-		: s.get_int(settings_pack::allowed_enc_level) == settings_pack::pe_both ? "both" : "unknown"
+		: s.get_int(settings_pack::allowed_enc_level) == settings_pack::pe_both ? "both"
+		: s.get_int(settings_pack::allowed_enc_level) == settings_pack::pe_chacha20 ? "chacha20"
+		: s.get_int(settings_pack::allowed_enc_level) == settings_pack::pe_all ? "all" : "unknown"
 		, s.get_bool(settings_pack::prefer_rc4) ? "true": "false");
 }
 
-void test_transfer(int enc_policy, int level, bool prefer_rc4)
+void test_transfer(int enc_policy, int level, bool prefer_rc4
+	, int const other_level = settings_pack::pe_both)
 {
 	lt::settings_pack default_settings = settings();
 	default_settings.set_bool(settings_pack::prefer_rc4, prefer_rc4);
@@ -83,10 +86,10 @@ void test_transfer(int enc_policy, int level, bool prefer_rc4)
 	default_add_torrent.flags &= ~lt::torrent_flags::auto_managed;
 	setup_swarm(2, swarm_test::download, sim, default_settings, default_add_torrent
 		// add session
-		, [](lt::settings_pack& pack) {
+		, [other_level](lt::settings_pack& pack) {
 			pack.set_int(settings_pack::out_enc_policy, settings_pack::pe_enabled);
 			pack.set_int(settings_pack::in_enc_policy, settings_pack::pe_enabled);
-			pack.set_int(settings_pack::allowed_enc_level, settings_pack::pe_both);
+			pack.set_int(settings_pack::allowed_enc_level, other_level);
 			pack.set_bool(settings_pack::prefer_rc4, false);
 		}
 		// add torrent
@@ -150,6 +153,25 @@ TORRENT_TEST(enabled_both_prefer_rc4)
 	test_transfer(settings_pack::pe_enabled, settings_pack::pe_both, true);
 }
 
+TORRENT_TEST(forced_chacha20)
+{
+	test_transfer(settings_pack::pe_forced, settings_pack::pe_chacha20, false
+		, settings_pack::pe_all);
+}
+
+TORRENT_TEST(forced_all_prefer_rc4)
+{
+	test_transfer(settings_pack::pe_forced, settings_pack::pe_all, true
+		, settings_pack::pe_all);
+}
+
+// a peer that also offers chacha20 can still talk to peers that don't
+// support it
+TORRENT_TEST(enabled_all)
+{
+	test_transfer(settings_pack::pe_enabled, settings_pack::pe_all, true);
+}
+
 // make sure that a peer with encryption disabled cannot talk to a peer with
 // encryption forced
 TORRENT_TEST(disabled_failing)
@@ -33,16 +33,268 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/session.hpp"
 #include "libtorrent/settings_pack.hpp"
 #include "libtorrent/alert_types.hpp"
+#include "libtorrent/session_stats.hpp"
 #include "libtorrent/time.hpp" // for clock_type
 
+#include "simulator/queue.hpp"
 #include "test.hpp"
 #include "setup_swarm.hpp"
 #include "settings.hpp"
+#include <array>
+#include <deque>
 #include <fstream>
 #include <iostream>
+#include <map>
 
 using namespace lt;
 
+namespace {
+
+// a network hop that drops every n:th packet passing through it. The tests
+// using it only have uTP traffic, so the packets are all UDP and there's no
+// need to notify the sender
+struct packet_loss : sim::sink
+{
+	explicit packet_loss(int const interval) : m_interval(interval) {}
+
+	void incoming_packet(sim::aux::packet p) override
+	{
+		if (++m_counter % m_interval == 0) return;
+		sim::forward_packet(std::move(p));
+	}
+
+	std::string label() const override { return "packet-loss"; }
+
+private:
+	int const m_interval;
+	int m_counter = 0;
+};
+
+// the time packets spend in the queues of a link, and the number of packets
+// waiting in them. The samples are split into two windows: one before the
+// first uTP min-RTT estimate expires (10 seconds in) and one after it
+struct queue_stats
+{
+	void sample(lt::time_duration const delay, int const queued)
+	{
+		lt::time_duration const t = lt::clock_type::now() - start;
+		int const w = (t >= lt::seconds(5) && t < lt::seconds(10)) ? 0
+			: t >= lt::seconds(13) ? 1 : -1;
+		if (w < 0) return;
+		max_delay[w] = std::max(max_delay[w], delay);
+		max_queued[w] = std::max(max_queued[w], queued);
+	}
+
+	lt::time_point const start = lt::clock_type::now();
+	std::array<lt::time_duration, 2> max_delay{{lt::time_duration(0), lt::time_duration(0)}};
+	std::array<int, 2> max_queued{{0, 0}};
+};
+
+// a pair of network hops placed on either side of a queue, to measure the
+// time each packet spends in it. The queue forwards packets in order, so as
+// long as it doesn't drop any, the n:th packet leaving it is the n:th packet
+// that entered it
+struct queue_enter : sim::sink
+{
+	explicit queue_enter(std::shared_ptr<std::deque<lt::time_point>> q)
+		: m_queue(std::move(q)) {}
+
+	void incoming_packet(sim::aux::packet p) override
+	{
+		m_queue->push_back(lt::clock_type::now());
+		sim::forward_packet(std::move(p));
+	}
+
+	std::string label() const override { return "queue-enter"; }
+
+private:
+	std::shared_ptr<std::deque<lt::time_point>> m_queue;
+};
+
+struct queue_leave : sim::sink
+{
+	queue_leave(std::shared_ptr<std::deque<lt::time_point>> q, queue_stats& s)
+		: m_queue(std::move(q)), m_stats(s) {}
+
+	void incoming_packet(sim::aux::packet p) override
+	{
+		TEST_CHECK(!m_queue->empty());
+		if (!m_queue->empty())
+		{
+			m_stats.sample(lt::clock_type::now() - m_queue->front()
+				, int(m_queue->size()));
+			m_queue->pop_front();
+		}
+		sim::forward_packet(std::move(p));
+	}
+
+	std::string label() const override { return "queue-leave"; }
+
+private:
+	std::shared_ptr<std::deque<lt::time_point>> m_queue;
+	queue_stats& m_stats;
+};
+
+// a fast link with a long round-trip time (2 * 2 * 40 ms) and, optionally,
+// deterministic loss of every n:th packet on the way into each node. When
+// ``stats`` is set, the sending side queues are monitored
+struct long_fat_link : sim::default_config
+{
+	explicit long_fat_link(int const loss_interval
+		, int const bandwidth = 10 * 1000 * 1000
+		, lt::time_duration const delay = lt::milliseconds(40)
+		, queue_stats* stats = nullptr)
+		: m_loss_interval(loss_interval)
+		, m_bandwidth(bandwidth)
+		, m_delay(delay)
+		, m_stats(stats)
+	{}
+
+	int loss_interval() const { return m_loss_interval; }
+
+	sim::route incoming_route(lt::address ip) override
+	{
+		auto it = m_incoming.find(ip);
+		if (it == m_incoming.end())
+		{
+			it = m_incoming.insert(it, std::make_pair(ip, std::make_shared<sim::queue>(
+				std::ref(m_sim->get_io_service()), m_bandwidth, m_delay
+				, 1000 * 1000, "long fat link in")));
+		}
+		sim::route r;
+		if (m_loss_interval > 0)
+			r.append(std::make_shared<packet_loss>(m_loss_interval));
+		return r.append(it->second);
+	}
+
+	sim::route outgoing_route(lt::address ip) override
+	{
+		auto it = m_outgoing.find(ip);
+		if (it == m_outgoing.end())
+		{
+			it = m_outgoing.insert(it, std::make_pair(ip, std::make_shared<sim::queue>(
+				std::ref(m_sim->get_io_service()), m_bandwidth, m_delay
+				, 1000 * 1000, "long fat link out")));
+		}
+		if (m_stats == nullptr) return sim::route().append(it->second);
+
+		// this is where the sender's queue builds up. Each queue has its own
+		// list of packets in it
+		auto& q = m_monitors[ip];
+		if (!q.first)
+		{
+			auto const pkts = std::make_shared<std::deque<lt::time_point>>();
+			q.first = std::make_shared<queue_enter>(pkts);
+			q.second = std::make_shared<queue_leave>(pkts, *m_stats);
+		}
+		return sim::route().append(q.first).append(it->second).append(q.second);
+	}
+
+private:
+	int const m_loss_interval;
+	int const m_bandwidth;
+	lt::time_duration const m_delay;
+	queue_stats* m_stats;
+	std::map<lt::address, std::pair<std::shared_ptr<queue_enter>
+		, std::shared_ptr<queue_leave>>> m_monitors;
+};
+
+struct transfer_result
+{
+	// the number of milliseconds it took for the downloader to complete
+	std::int64_t time;
+
+	// the number of delay samples above the uTP target delay the seed saw
+	std::int64_t samples_above_target;
+
+	// the size of the torrent that was transferred, in bytes
+	std::int64_t size;
+
+	// the number of uTP timeouts the seed had
+	std::int64_t timeouts;
+
+	// the download rate, in bytes per second
+	std::int64_t rate() const { return time > 0 ? size * 1000 / time : 0; }
+};
+
+// seed a torrent over uTP, across ``cfg``. ``configure`` is applied to the
+// settings of the seed
+transfer_result utp_transfer(std::function<void(lt::settings_pack&)> configure
+	, long_fat_link& cfg)
+{
+	lt::time_point const start_time = lt::clock_type::now();
+	lt::time_point end_time = start_time;
+	std::int64_t samples_above_target = 0;
+	std::int64_t size = 0;
+	std::int64_t timeouts = 0;
+	int const above_target_idx = lt::find_metric_idx("utp.utp_samples_above_target");
+	int const timeout_idx = lt::find_metric_idx("utp.utp_timeout");
+
+	sim::simulation sim{cfg};
+
+	setup_swarm(2, swarm_test::upload | swarm_test::large_torrent, sim
+		// add session
+		, [&](lt::settings_pack& pack) {
+			utp_only(pack);
+			configure(pack);
+		}
+		// add torrent
+		, [&](lt::add_torrent_params& params) {
+			params.flags |= torrent_flags::seed_mode;
+			size = params.ti->total_size();
+		}
+		// on alert
+		, [&](lt::alert const* a, lt::session&) {
+			// the downloader disconnects once it has all pieces
+			if (alert_cast<peer_disconnected_alert>(a) && end_time == start_time)
+				end_time = a->timestamp();
+			if (auto const* ss = alert_cast<session_stats_alert>(a))
+			{
+				samples_above_target = ss->counters()[above_target_idx];
+				timeouts = ss->counters()[timeout_idx];
+			}
+		}
+		// terminate
+		, [](int const ticks, lt::session& ses) -> bool
+		{
+			ses.post_session_stats();
+			if (ticks > 100)
+			{
+				TEST_ERROR("timeout");
+				return true;
+			}
+			return false;
+		});
+
+	TEST_CHECK(end_time != start_time);
+	transfer_result const ret{total_milliseconds(end_time - start_time)
+		, samples_above_target, size, timeouts};
+	std::printf("loss: 1/%d transfer time: %d ms (%d kB/s) samples above target: %d "
+		"timeouts: %d\n"
+		, cfg.loss_interval(), int(ret.time), int(ret.rate() / 1000)
+		, int(ret.samples_above_target), int(ret.timeouts));
+	return ret;
+}
+
+transfer_result utp_transfer(std::function<void(lt::settings_pack&)> configure
+	, int const loss_interval)
+{
+	long_fat_link cfg(loss_interval);
+	return utp_transfer(std::move(configure), cfg);
+}
+
+void use_bbr(lt::settings_pack& pack)
+{
+	pack.set_int(settings_pack::utp_congestion_control, settings_pack::utp_bbr);
+}
+
+void use_ledbat(lt::settings_pack& pack)
+{
+	pack.set_int(settings_pack::utp_congestion_control, settings_pack::utp_ledbat);
+}
+
+} // anonymous namespace
+
 TORRENT_TEST(utp)
 {
 	// TODO: 3 simulate packet loss
@@ -85,3 +337,76 @@ TORRENT_TEST(utp)
 		});
 }
 
+
+// the transfer is short compared to the round-trip time, so most of it is
+// spent in startup. This is a floor to catch the controller failing to grow
+// its window, not a measure of line rate
+TORRENT_TEST(utp_bbr)
+{
+	transfer_result const bbr = utp_transfer(&use_bbr, 0);
+	TEST_CHECK(bbr.rate() >= 100000);
+}
+
+// with 1% packet loss on a high latency link, LEDBAT keeps halving its
+// window. The BBR-style controller doesn't treat isolated losses as
+// congestion, and should finish first
+TORRENT_TEST(utp_loss)
+{
+	transfer_result const ledbat = utp_transfer(&use_ledbat, 100);
+	transfer_result const bbr = utp_transfer(&use_bbr, 100);
+	TEST_CHECK(bbr.time < ledbat.time);
+}
+
+// pacing spreads the packets of a window over the RTT instead of sending them
+// back-to-back. That should cause less queuing delay at the bottleneck
+TORRENT_TEST(utp_pacing)
+{
+	transfer_result const bursty = utp_transfer(&use_ledbat, 0);
+	transfer_result const paced = utp_transfer([](lt::settings_pack& pack) {
+		use_ledbat(pack);
+		pack.set_bool(settings_pack::utp_pacing, true);
+	}, 0);
+	TEST_CHECK(paced.samples_above_target <= bursty.samples_above_target);
+}
+
+// with 2% loss, several packets are typically lost per round-trip. The SACK
+// scoreboard should recover from them without timing out. Without it, only
+// the first few holes of each SACK are resent, and the transfer takes longer
+TORRENT_TEST(utp_heavy_loss)
+{
+	transfer_result const plain = utp_transfer([](lt::settings_pack& pack) {
+		use_ledbat(pack);
+		pack.set_bool(settings_pack::utp_sack_scoreboard, false);
+	}, 50);
+	transfer_result const scoreboard = utp_transfer(&use_ledbat, 50);
+
+	// allow for a loss at the very end of the transfer, which no later
+	// packet can reveal
+	TEST_CHECK(scoreboard.timeouts <= 1);
+	TEST_CHECK(scoreboard.timeouts <= plain.timeouts);
+	TEST_CHECK(scoreboard.time < plain.time);
+}
+
+// the BBR min-RTT estimate expires after 10 seconds. By then, the RTT samples
+// include the queue the seed built at the bottleneck itself. Taking one of
+// those as the new estimate would grow the window, and with it the queue and
+// the RTT, every time the estimate expires. The queue has to be drained first
+TORRENT_TEST(utp_bbr_min_rtt_expiry)
+{
+	// 40 kB/s with a 400 ms round-trip time. The bandwidth-delay product is
+	// about 11 packets, and the transfer takes about 20 seconds
+	queue_stats stats;
+	long_fat_link cfg(0, 40 * 1000, lt::milliseconds(100), &stats);
+	transfer_result const bbr = utp_transfer(&use_bbr, cfg);
+
+	std::printf("max queue delay: %d ms -> %d ms, max packets queued: %d -> %d\n"
+		, int(total_milliseconds(stats.max_delay[0]))
+		, int(total_milliseconds(stats.max_delay[1]))
+		, stats.max_queued[0], stats.max_queued[1]);
+
+	TEST_CHECK(bbr.time > 13000);
+	TEST_CHECK(stats.max_delay[1] > lt::time_duration(0));
+	TEST_CHECK(stats.max_delay[1] <= stats.max_delay[0] * 3 / 2);
+	TEST_CHECK(stats.max_queued[1] <= stats.max_queued[0] * 3 / 2 + 1);
+	TEST_CHECK(bbr.timeouts == 0);
+}
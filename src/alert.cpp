@@ -2542,9 +2542,12 @@ namespace {
 	}
 
 	alerts_dropped_alert::alerts_dropped_alert(aux::stack_allocator&
-		, std::bitset<num_alert_types> const& dropped)
-		: dropped_alerts(dropped)
-	{}
+		, std::array<std::uint32_t, num_alert_types> const& dropped)
+		: num_dropped(dropped)
+	{
+		for (int i = 0; i < num_alert_types; ++i)
+			dropped_alerts.set(std::size_t(i), dropped[std::size_t(i)] > 0);
+	}
 
 	char const* alert_name(int const alert_type)
 	{
@@ -43,7 +43,9 @@ namespace libtorrent {
 	alert_manager::alert_manager(int const queue_limit, alert_category_t const alert_mask)
 		: m_alert_mask(alert_mask)
 		, m_queue_size_limit(queue_limit)
-	{}
+	{
+		for (auto& d : m_dropped) d.store(0, std::memory_order_relaxed);
+	}
 
 	alert_manager::~alert_manager() = default;
 
@@ -112,10 +114,15 @@ namespace libtorrent {
 			return;
 		}
 
-		if (m_dropped.any()) {
-			emplace_alert<alerts_dropped_alert>(m_dropped);
-			m_dropped.reset();
+		aux::array<std::uint32_t, num_alert_types> dropped;
+		bool any_dropped = false;
+		for (int i = 0; i < num_alert_types; ++i)
+		{
+			dropped[i] = m_dropped[i].exchange(0, std::memory_order_relaxed);
+			if (dropped[i] > 0) any_dropped = true;
 		}
+		if (any_dropped)
+			emplace_alert<alerts_dropped_alert>(dropped);
 
 		m_alerts[m_generation].get_pointers(alerts);
 
@@ -124,6 +131,7 @@ namespace libtorrent {
 		// clear the one we will start writing to now
 		m_alerts[m_generation].clear();
 		m_allocations[m_generation].reset();
+		m_num_queued.store(0, std::memory_order_relaxed);
 	}
 
 	bool alert_manager::pending() const
@@ -136,7 +144,6 @@ namespace libtorrent {
 	{
 		std::lock_guard<std::recursive_mutex> lock(m_mutex);
 
-		std::swap(m_queue_size_limit, queue_size_limit_);
-		return queue_size_limit_;
+		return m_queue_size_limit.exchange(queue_size_limit_);
 	}
 }
@@ -148,9 +148,15 @@ namespace libtorrent {
 
 		std::vector<bandwidth_channel*> channels;
 
+		// requests that are done (or whose peer is disconnecting) are moved
+		// here. Their peers are notified once we're done with m_queue
 		std::vector<bw_request> queue;
 
-		for (auto i = m_queue.begin(); i != m_queue.end();)
+		// m_queue is compacted in place as requests are removed, preserving
+		// the order of the remaining ones. Erasing them one at a time would
+		// make this quadratic in the number of peers waiting for quota
+		auto out = m_queue.begin();
+		for (auto i = m_queue.begin(); i != m_queue.end(); ++i)
 		{
 			if (i->peer->is_disconnecting())
 			{
@@ -166,7 +172,6 @@ namespace libtorrent {
 
 				i->assigned = 0;
 				queue.push_back(std::move(*i));
-				i = m_queue.erase(i);
 				continue;
 			}
 			for (int j = 0; j < bw_request::max_bandwidth_channels && i->channel[j]; ++j)
@@ -174,8 +179,10 @@ namespace libtorrent {
 				bandwidth_channel* bwc = i->channel[j];
 				bwc->tmp = 0;
 			}
-			++i;
+			if (out != i) *out = std::move(*i);
+			++out;
 		}
+		m_queue.erase(out, m_queue.end());
 
 		for (auto const& r : m_queue)
 		{
@@ -193,7 +200,8 @@ namespace libtorrent {
 			ch->update_quota(int(dt_milliseconds));
 		}
 
-		for (auto i = m_queue.begin(); i != m_queue.end();)
+		out = m_queue.begin();
+		for (auto i = m_queue.begin(); i != m_queue.end(); ++i)
 		{
 			int a = i->assign_bandwidth();
 			if (i->assigned == i->request_size
@@ -201,15 +209,15 @@ namespace libtorrent {
 			{
 				a += i->request_size - i->assigned;
 				TORRENT_ASSERT(i->assigned <= i->request_size);
+				m_queued_bytes -= a;
 				queue.push_back(std::move(*i));
-				i = m_queue.erase(i);
-			}
-			else
-			{
-				++i;
+				continue;
 			}
 			m_queued_bytes -= a;
+			if (out != i) *out = std::move(*i);
+			++out;
 		}
+		m_queue.erase(out, m_queue.end());
 
 		while (!queue.empty())
 		{
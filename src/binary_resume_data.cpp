@@ -0,0 +1,706 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/read_resume_data.hpp"
+#include "libtorrent/write_resume_data.hpp"
+#include "libtorrent/add_torrent_params.hpp"
+#include "libtorrent/bdecode.hpp"
+#include "libtorrent/hasher.hpp"
+#include "libtorrent/io.hpp"
+#include "libtorrent/socket_io.hpp" // for write_endpoint()
+#include "libtorrent/broadcast_socket.hpp" // for is_v6
+#include "libtorrent/torrent_info.hpp"
+#include "libtorrent/aux_/numeric_cast.hpp"
+#include "libtorrent/download_priority.hpp"
+
+#include <algorithm>
+#include <cstring> // for memcmp
+#include <limits>
+
+// The binary resume format is a header followed by a sequence of records.
+// All integers are big-endian.
+//
+// header:
+//   4 bytes "LTRB"
+//   4 bytes format version (binary_resume_version)
+// record:
+//   1 byte  record type (record_t)
+//   4 bytes payload length
+//   payload
+//
+// Readers skip records of types they don't know, so new record types can be
+// added without bumping the version. The version only needs to change if the
+// layout of an existing record changes in an incompatible way. Variable
+// length fields within a record (strings, bitfields) are themselves prefixed
+// by their 4 byte length.
+
+namespace libtorrent {
+
+namespace {
+
+	char const binary_resume_magic[4] = {'L', 'T', 'R', 'B'};
+	std::uint32_t const binary_resume_version = 1;
+	int const header_size = 8;
+
+	enum record_t : std::uint8_t
+	{
+		rec_info_hash = 1,
+		rec_name,
+		rec_save_path,
+		rec_storage_mode,
+		// the flags that are saved in resume data, see persistent_flags
+		rec_flags,
+		// a sequence of 64 bit integers, see write_resume_data_binary() for the
+		// order. Readers accept shorter and longer sequences
+		rec_stats,
+		// the bencoded info dictionary
+		rec_info,
+		rec_comment,
+		rec_created_by,
+		rec_creation_date,
+		rec_merkle_tree,
+		// number of have bits, have bits, number of verified bits, verified
+		// bits
+		rec_pieces,
+		rec_piece_priorities,
+		rec_file_priorities,
+		rec_renamed_files,
+		rec_trackers,
+		rec_url_seeds,
+		rec_http_seeds,
+		rec_peers,
+		rec_peers6,
+		rec_banned_peers,
+		rec_banned_peers6,
+		rec_unfinished,
+		rec_url,
+		rec_uuid,
+	};
+
+	// these are the flags that are stored in resume data. The others only
+	// control how the torrent is added
+	torrent_flags_t const persistent_flags = torrent_flags::seed_mode
+		| torrent_flags::upload_mode
+#ifndef TORRENT_DISABLE_SHARE_MODE
+		| torrent_flags::share_mode
+#endif
+		| torrent_flags::apply_ip_filter
+		| torrent_flags::paused
+		| torrent_flags::auto_managed
+#ifndef TORRENT_DISABLE_SUPERSEEDING
+		| torrent_flags::super_seeding
+#endif
+		| torrent_flags::sequential_download
+		| torrent_flags::stop_when_ready
+		| torrent_flags::disable_dht
+		| torrent_flags::disable_lsd
+		| torrent_flags::disable_pex;
+
+	struct record_writer
+	{
+		record_writer(std::vector<char>& buf, record_t const type)
+			: m_buf(buf)
+		{
+			m_buf.push_back(char(type));
+			m_size_pos = m_buf.size();
+			m_buf.resize(m_size_pos + 4);
+		}
+
+		~record_writer()
+		{
+			char* ptr = &m_buf[m_size_pos];
+			detail::write_uint32(m_buf.size() - m_size_pos - 4, ptr);
+		}
+
+		record_writer(record_writer const&) = delete;
+		record_writer& operator=(record_writer const&) = delete;
+
+		void u8(std::uint8_t const v) { m_buf.push_back(char(v)); }
+		void u32(std::uint32_t const v) { auto out = std::back_inserter(m_buf); detail::write_uint32(v, out); }
+		void i64(std::int64_t const v) { auto out = std::back_inserter(m_buf); detail::write_int64(v, out); }
+		void bytes(char const* b, std::size_t const len) { m_buf.insert(m_buf.end(), b, b + len); }
+		void str(string_view s) { u32(std::uint32_t(s.size())); bytes(s.data(), s.size()); }
+		void bits(bitfield const& b)
+		{
+			u32(std::uint32_t(b.size()));
+			bytes(b.data(), std::size_t(b.num_words()) * 4);
+		}
+
+	private:
+		std::vector<char>& m_buf;
+		std::size_t m_size_pos;
+	};
+
+	void write_string_record(std::vector<char>& buf, record_t const type, string_view s)
+	{
+		record_writer r(buf, type);
+		r.bytes(s.data(), s.size());
+	}
+
+	void write_string_list(std::vector<char>& buf, record_t const type
+		, std::vector<std::string> const& list)
+	{
+		record_writer r(buf, type);
+		r.u32(std::uint32_t(list.size()));
+		for (auto const& s : list) r.str(s);
+	}
+
+	void write_endpoints(std::vector<char>& buf, record_t const type
+		, std::vector<tcp::endpoint> const& eps, bool const v6)
+	{
+		if (std::none_of(eps.begin(), eps.end()
+			, [v6](tcp::endpoint const& ep) { return is_v6(ep) == v6; }))
+			return;
+
+		record_writer r(buf, type);
+		auto out = std::back_inserter(buf);
+		for (auto const& ep : eps)
+			if (is_v6(ep) == v6) detail::write_endpoint(ep, out);
+	}
+
+	// reads the payload of one record. Any read past the end sets the error
+	// flag and returns zeros
+	struct record_reader
+	{
+		explicit record_reader(span<char const> b) : m_buf(b) {}
+
+		bool failed() const { return m_failed; }
+		bool empty() const { return m_buf.empty(); }
+		std::size_t left() const { return std::size_t(m_buf.size()); }
+
+		// the remainder of the record
+		string_view rest()
+		{
+			auto const b = bytes(left());
+			return {b.data(), std::size_t(b.size())};
+		}
+
+		bool need(std::size_t const n)
+		{
+			if (!m_failed && std::size_t(m_buf.size()) >= n) return true;
+			m_failed = true;
+			return false;
+		}
+
+		std::uint8_t u8()
+		{
+			if (!need(1)) return 0;
+			char const* ptr = m_buf.data();
+			m_buf = m_buf.subspan(1);
+			return detail::read_uint8(ptr);
+		}
+
+		std::uint32_t u32()
+		{
+			if (!need(4)) return 0;
+			char const* ptr = m_buf.data();
+			m_buf = m_buf.subspan(4);
+			return detail::read_uint32(ptr);
+		}
+
+		std::int64_t i64()
+		{
+			if (!need(8)) return 0;
+			char const* ptr = m_buf.data();
+			m_buf = m_buf.subspan(8);
+			return detail::read_int64(ptr);
+		}
+
+		span<char const> bytes(std::size_t const n)
+		{
+			if (!need(n)) return {};
+			auto const ret = m_buf.first(std::ptrdiff_t(n));
+			m_buf = m_buf.subspan(std::ptrdiff_t(n));
+			return ret;
+		}
+
+		string_view str()
+		{
+			auto const b = bytes(u32());
+			return {b.data(), std::size_t(b.size())};
+		}
+
+		template <typename Bitfield>
+		void bits(Bitfield& out)
+		{
+			std::uint32_t const num_bits = u32();
+			if (num_bits > std::uint32_t(std::numeric_limits<int>::max() - 31))
+			{
+				m_failed = true;
+				return;
+			}
+			auto const b = bytes((std::size_t(num_bits) + 31) / 32 * 4);
+			if (m_failed) return;
+			out.assign(b.data(), int(num_bits));
+		}
+
+	private:
+		span<char const> m_buf;
+		bool m_failed = false;
+	};
+
+	std::vector<std::string> read_string_list(record_reader& r)
+	{
+		std::vector<std::string> ret;
+		std::uint32_t const num = r.u32();
+		// every string takes at least 4 bytes
+		if (num > r.left() / 4) { r.need(r.left() + 1); return ret; }
+		ret.reserve(num);
+		for (std::uint32_t i = 0; i < num && !r.failed(); ++i)
+			ret.push_back(r.str().to_string());
+		return ret;
+	}
+
+	void read_endpoints(span<char const> payload, std::vector<tcp::endpoint>& out, bool const v6)
+	{
+		int const size = v6 ? 18 : 6;
+		char const* ptr = payload.data();
+		for (auto n = payload.size(); n >= size; n -= size)
+		{
+			out.push_back(v6 ? detail::read_v6_endpoint<tcp::endpoint>(ptr)
+				: detail::read_v4_endpoint<tcp::endpoint>(ptr));
+		}
+	}
+}
+
+namespace aux {
+
+	bool is_binary_resume_data(span<char const> buffer)
+	{
+		return buffer.size() >= header_size
+			&& std::memcmp(buffer.data(), binary_resume_magic, sizeof(binary_resume_magic)) == 0;
+	}
+}
+
+	std::vector<char> write_resume_data_binary(add_torrent_params const& atp)
+	{
+		std::vector<char> ret;
+		ret.insert(ret.end(), std::begin(binary_resume_magic), std::end(binary_resume_magic));
+		{
+			auto out = std::back_inserter(ret);
+			detail::write_uint32(binary_resume_version, out);
+		}
+
+		write_string_record(ret, rec_info_hash, {atp.info_hash.data(), std::size_t(atp.info_hash.size())});
+		if (!atp.name.empty()) write_string_record(ret, rec_name, atp.name);
+		write_string_record(ret, rec_save_path, atp.save_path);
+
+		{
+			record_writer r(ret, rec_storage_mode);
+			r.u8(std::uint8_t(atp.storage_mode));
+		}
+		{
+			record_writer r(ret, rec_flags);
+			auto const flags = static_cast<std::uint64_t>(atp.flags & persistent_flags);
+			r.u32(std::uint32_t(flags >> 32));
+			r.u32(std::uint32_t(flags));
+		}
+		{
+			// new fields may only be appended to the end of this record
+			record_writer r(ret, rec_stats);
+			r.i64(atp.total_uploaded);
+			r.i64(atp.total_downloaded);
+			r.i64(atp.active_time);
+			r.i64(atp.finished_time);
+			r.i64(atp.seeding_time);
+			r.i64(atp.last_seen_complete);
+			r.i64(atp.last_download);
+			r.i64(atp.last_upload);
+			r.i64(atp.added_time);
+			r.i64(atp.completed_time);
+			r.i64(atp.num_complete);
+			r.i64(atp.num_incomplete);
+			r.i64(atp.num_downloaded);
+			r.i64(atp.max_uploads);
+			r.i64(atp.max_connections);
+			r.i64(atp.upload_limit);
+			r.i64(atp.download_limit);
+		}
+
+		if (atp.ti)
+		{
+			write_string_record(ret, rec_info
+				, {atp.ti->metadata().get(), std::size_t(atp.ti->metadata_size())});
+			if (!atp.ti->comment().empty())
+				write_string_record(ret, rec_comment, atp.ti->comment());
+			if (!atp.ti->creator().empty())
+				write_string_record(ret, rec_created_by, atp.ti->creator());
+			if (atp.ti->creation_date() != 0)
+			{
+				record_writer r(ret, rec_creation_date);
+				r.i64(atp.ti->creation_date());
+			}
+		}
+
+		if (!atp.merkle_tree.empty())
+		{
+			record_writer r(ret, rec_merkle_tree);
+			for (auto const& h : atp.merkle_tree)
+				r.bytes(h.data(), std::size_t(h.size()));
+		}
+
+		{
+			record_writer r(ret, rec_pieces);
+			r.bits(atp.have_pieces);
+			r.bits(atp.verified_pieces);
+		}
+
+		if (!atp.piece_priorities.empty())
+		{
+			record_writer r(ret, rec_piece_priorities);
+			for (auto const p : atp.piece_priorities)
+				r.u8(static_cast<std::uint8_t>(p));
+		}
+
+		if (!atp.file_priorities.empty())
+		{
+			record_writer r(ret, rec_file_priorities);
+			for (auto const p : atp.file_priorities)
+				r.u8(static_cast<std::uint8_t>(p));
+		}
+
+		if (!atp.renamed_files.empty())
+		{
+			record_writer r(ret, rec_renamed_files);
+			r.u32(std::uint32_t(atp.renamed_files.size()));
+			for (auto const& f : atp.renamed_files)
+			{
+				r.u32(std::uint32_t(static_cast<int>(f.first)));
+				r.str(f.second);
+			}
+		}
+
+		// like in the bencoded format, the trackers and web seeds are always
+		// saved, to have them override the ones in the .torrent file
+		{
+			record_writer r(ret, rec_trackers);
+			r.u32(std::uint32_t(atp.trackers.size()));
+			for (std::size_t i = 0; i < atp.trackers.size(); ++i)
+			{
+				int const tier = i < atp.tracker_tiers.size() ? atp.tracker_tiers[i] : 0;
+				r.u32(std::uint32_t(aux::clamp(tier, 0, 1024)));
+				r.str(atp.trackers[i]);
+			}
+		}
+		write_string_list(ret, rec_url_seeds, atp.url_seeds);
+		write_string_list(ret, rec_http_seeds, atp.http_seeds);
+
+		write_endpoints(ret, rec_peers, atp.peers, false);
+		write_endpoints(ret, rec_peers6, atp.peers, true);
+		write_endpoints(ret, rec_banned_peers, atp.banned_peers, false);
+		write_endpoints(ret, rec_banned_peers6, atp.banned_peers, true);
+
+		if (!atp.unfinished_pieces.empty())
+		{
+			record_writer r(ret, rec_unfinished);
+			r.u32(std::uint32_t(atp.unfinished_pieces.size()));
+			for (auto const& p : atp.unfinished_pieces)
+			{
+				r.u32(std::uint32_t(static_cast<int>(p.first)));
+				r.bits(p.second);
+			}
+		}
+
+#if TORRENT_ABI_VERSION == 1
+		// deprecated in 1.2
+		if (!atp.url.empty()) write_string_record(ret, rec_url, atp.url);
+		if (!atp.uuid.empty()) write_string_record(ret, rec_uuid, atp.uuid);
+#endif
+
+		return ret;
+	}
+
+	add_torrent_params read_resume_data_binary(span<char const> buffer, error_code& ec)
+	{
+		add_torrent_params ret;
+
+		if (!aux::is_binary_resume_data(buffer))
+		{
+			ec = errors::invalid_file_tag;
+			return ret;
+		}
+
+		{
+			char const* ptr = buffer.data() + sizeof(binary_resume_magic);
+			if (detail::read_uint32(ptr) > binary_resume_version)
+			{
+				ec = errors::invalid_file_tag;
+				return ret;
+			}
+		}
+
+		bool have_info_hash = false;
+		span<char const> info;
+		std::int64_t creation_date = 0;
+		string_view comment;
+		string_view created_by;
+
+		record_reader file(buffer.subspan(header_size));
+		while (!file.empty())
+		{
+			auto const type = file.u8();
+			std::uint32_t const size = file.u32();
+			record_reader r(file.bytes(size));
+			if (file.failed())
+			{
+				ec = errors::invalid_resume_data;
+				return ret;
+			}
+
+			switch (type)
+			{
+				case rec_info_hash:
+				{
+					auto const ih = r.bytes(std::size_t(sha1_hash::size()));
+					if (r.failed()) break;
+					ret.info_hash.assign(ih.data());
+					have_info_hash = true;
+					break;
+				}
+				case rec_name: ret.name = r.rest().to_string(); break;
+				case rec_save_path: ret.save_path = r.rest().to_string(); break;
+				case rec_storage_mode:
+					ret.storage_mode = r.u8() == storage_mode_allocate
+						? storage_mode_allocate : storage_mode_sparse;
+					break;
+				case rec_flags:
+				{
+					std::uint64_t flags = r.u32();
+					flags <<= 32;
+					flags |= r.u32();
+					ret.flags = (ret.flags & ~persistent_flags)
+						| (torrent_flags_t(flags) & persistent_flags);
+					break;
+				}
+				case rec_stats:
+				{
+					// older writers may have written fewer fields, newer ones
+					// more. Whatever is missing keeps its default value
+					std::int64_t* const fields[] = {
+						&ret.total_uploaded, &ret.total_downloaded };
+					for (auto* f : fields)
+						if (r.left() >= 8) *f = r.i64();
+
+					int* const int_fields[] = {
+						&ret.active_time, &ret.finished_time, &ret.seeding_time };
+					for (auto* f : int_fields)
+						if (r.left() >= 8) *f = int(r.i64());
+
+					std::time_t* const time_fields[] = {
+						&ret.last_seen_complete, &ret.last_download, &ret.last_upload
+						, &ret.added_time, &ret.completed_time };
+					for (auto* f : time_fields)
+						if (r.left() >= 8) *f = std::time_t(r.i64());
+
+					int* const int_fields2[] = {
+						&ret.num_complete, &ret.num_incomplete, &ret.num_downloaded
+						, &ret.max_uploads, &ret.max_connections
+						, &ret.upload_limit, &ret.download_limit };
+					for (auto* f : int_fields2)
+						if (r.left() >= 8) *f = int(r.i64());
+					break;
+				}
+				case rec_info: info = r.bytes(r.left()); break;
+				case rec_comment: comment = r.rest(); break;
+				case rec_created_by: created_by = r.rest(); break;
+				case rec_creation_date: creation_date = r.i64(); break;
+				case rec_merkle_tree:
+				{
+					auto const n = r.left() / std::size_t(sha1_hash::size());
+					ret.merkle_tree.resize(n);
+					for (auto& h : ret.merkle_tree)
+						h.assign(r.bytes(std::size_t(sha1_hash::size())).data());
+					break;
+				}
+				case rec_pieces:
+					r.bits(ret.have_pieces);
+					r.bits(ret.verified_pieces);
+					break;
+				case rec_piece_priorities:
+				{
+					auto const prio = r.bytes(r.left());
+					ret.piece_priorities.resize(std::size_t(prio.size()));
+					for (std::size_t i = 0; i < ret.piece_priorities.size(); ++i)
+					{
+						ret.piece_priorities[i] = download_priority_t(aux::clamp(
+							static_cast<std::uint8_t>(prio[std::ptrdiff_t(i)])
+							, static_cast<std::uint8_t>(dont_download)
+							, static_cast<std::uint8_t>(top_priority)));
+					}
+					break;
+				}
+				case rec_file_priorities:
+				{
+					auto const prio = r.bytes(r.left());
+					ret.file_priorities.resize(std::size_t(prio.size()));
+					for (std::size_t i = 0; i < ret.file_priorities.size(); ++i)
+					{
+						ret.file_priorities[i] = download_priority_t(aux::clamp(
+							static_cast<std::uint8_t>(prio[std::ptrdiff_t(i)])
+							, static_cast<std::uint8_t>(dont_download)
+							, static_cast<std::uint8_t>(top_priority)));
+					}
+					break;
+				}
+				case rec_renamed_files:
+				{
+					std::uint32_t const num = r.u32();
+					for (std::uint32_t i = 0; i < num && !r.failed(); ++i)
+					{
+						auto const idx = file_index_t(int(r.u32()));
+						auto const name = r.str();
+						if (r.failed()) break;
+						if (name.empty()) continue;
+						ret.renamed_files[idx] = name.to_string();
+					}
+					break;
+				}
+				case rec_trackers:
+				{
+					ret.flags |= torrent_flags::override_trackers;
+					std::uint32_t const num = r.u32();
+					for (std::uint32_t i = 0; i < num && !r.failed(); ++i)
+					{
+						int const tier = int(r.u32());
+						auto const url = r.str();
+						if (r.failed()) break;
+						ret.trackers.push_back(url.to_string());
+						ret.tracker_tiers.push_back(tier);
+					}
+					break;
+				}
+				case rec_url_seeds:
+					ret.flags |= torrent_flags::override_web_seeds;
+					ret.url_seeds = read_string_list(r);
+					break;
+				case rec_http_seeds:
+					ret.flags |= torrent_flags::override_web_seeds;
+					ret.http_seeds = read_string_list(r);
+					break;
+				case rec_peers: read_endpoints(r.bytes(r.left()), ret.peers, false); break;
+				case rec_peers6: read_endpoints(r.bytes(r.left()), ret.peers, true); break;
+				case rec_banned_peers: read_endpoints(r.bytes(r.left()), ret.banned_peers, false); break;
+				case rec_banned_peers6: read_endpoints(r.bytes(r.left()), ret.banned_peers, true); break;
+				case rec_unfinished:
+				{
+					std::uint32_t const num = r.u32();
+					for (std::uint32_t i = 0; i < num && !r.failed(); ++i)
+					{
+						auto const piece = piece_index_t(int(r.u32()));
+						bitfield bits;
+						r.bits(bits);
+						if (r.failed()) break;
+						if (piece < piece_index_t(0)) continue;
+						ret.unfinished_pieces[piece] = std::move(bits);
+					}
+					break;
+				}
+#if TORRENT_ABI_VERSION == 1
+				case rec_url: ret.url = r.rest().to_string(); break;
+				case rec_uuid: ret.uuid = r.rest().to_string(); break;
+#endif
+				default:
+					// unknown record, from a newer version
+					break;
+			}
+
+			if (r.failed())
+			{
+				ec = errors::invalid_resume_data;
+				return ret;
+			}
+		}
+
+		if (!have_info_hash)
+		{
+			ec = errors::missing_info_hash;
+			return ret;
+		}
+
+		if (!info.empty())
+		{
+			// like the bencoded format, only use the metadata if it matches
+			// the info-hash
+			sha1_hash const resume_ih = hasher(info).final();
+			if (resume_ih == ret.info_hash)
+			{
+				ret.ti = std::make_shared<torrent_info>(resume_ih);
+
+				error_code err;
+				bdecode_node const info_dict = bdecode(info, err);
+				if (err || !ret.ti->parse_info_section(info_dict, err))
+				{
+					ec = err;
+				}
+				else
+				{
+					ret.ti->internal_set_creation_date(static_cast<std::time_t>(creation_date));
+					ret.ti->internal_set_creator(created_by);
+					ret.ti->internal_set_comment(comment);
+				}
+			}
+		}
+
+		// being in seed mode with files we don't want is suspicious
+		if (std::any_of(ret.file_priorities.begin(), ret.file_priorities.end()
+			, [](download_priority_t const p) { return p == dont_download; }))
+			ret.flags &= ~torrent_flags::seed_mode;
+
+		// we're loading this torrent from resume data. There's no need to
+		// re-save the resume data immediately.
+		ret.flags &= ~torrent_flags::need_save_resume;
+
+		return ret;
+	}
+
+	add_torrent_params read_resume_data_binary(span<char const> buffer)
+	{
+		error_code ec;
+		auto ret = read_resume_data_binary(buffer, ec);
+		if (ec) throw system_error(ec);
+		return ret;
+	}
+
+	std::vector<char> resume_data_to_binary(span<char const> buffer, error_code& ec)
+	{
+		add_torrent_params const atp = read_resume_data(buffer, ec);
+		if (ec) return {};
+		return write_resume_data_binary(atp);
+	}
+
+	std::vector<char> resume_data_to_bencoded(span<char const> buffer, error_code& ec)
+	{
+		add_torrent_params const atp = read_resume_data_binary(buffer, ec);
+		if (ec) return {};
+		return write_resume_data_buf(atp);
+	}
+}
@@ -34,6 +34,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/numeric_cast.hpp"
 #include "libtorrent/aux_/cpuid.hpp"
 
+#include <algorithm> // for min
+
 #ifdef _MSC_VER
 #include <intrin.h>
 #endif
@@ -58,77 +60,165 @@ namespace libtorrent {
 		return true;
 	}
 
-	int bitfield::count() const noexcept
+namespace {
+
+	// the buffer is only guaranteed to be 4 byte aligned (the first word is
+	// the size), so 64 bit loads go through memcpy
+	std::uint64_t load64(std::uint32_t const* p) noexcept
 	{
-		int ret = 0;
-		int const words = num_words();
-#if TORRENT_HAS_SSE
-		if (aux::mmx_support)
+		std::uint64_t ret;
+		std::memcpy(&ret, p, sizeof(ret));
+		return ret;
+	}
+
+	struct popcount_sw
+	{
+		int operator()(std::uint64_t v) const noexcept
 		{
-			for (int i = 1; i < words + 1; ++i)
-			{
-#ifdef __GNUC__
-				std::uint32_t cnt = 0;
-				__asm__("popcnt %1, %0"
-					: "=r"(cnt)
-					: "r"(m_buf[i]));
-				ret += cnt;
+#if TORRENT_HAS_ARM && defined __GNUC__
+			// this turns into the vcnt/cnt NEON instructions
+			return __builtin_popcountll(v);
 #else
-				ret += _mm_popcnt_u32(m_buf[i]);
+			// from:
+			// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
+			v = v - ((v >> 1) & 0x5555555555555555ULL);
+			v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+			v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+			return int((v * 0x0101010101010101ULL) >> 56);
 #endif
-			}
-
-			TORRENT_ASSERT(ret <= size());
-			TORRENT_ASSERT(ret >= 0);
-			return ret;
 		}
-#endif // TORRENT_HAS_SSE
+	};
 
-#if TORRENT_HAS_ARM_NEON && defined __arm__
-		if (aux::arm_neon_support)
+#if TORRENT_HAS_SSE
+	struct popcount_hw
+	{
+		int operator()(std::uint64_t const v) const noexcept
 		{
-			for (int i = 1; i < words + 1; ++i)
-			{
-				std::uint32_t cnt;
-				__asm__(
-					"vld1.u32 d0[0], [%1] \n"
-					"vcnt.u8 d0, d0 \n"
-					"vpaddl.u8 d0, d0 \n"
-					"vpaddl.u16 d0, d0 \n"
-					"vst1.u32 d0[0], [%0]"
-					:: "r"(&cnt), "r"(&m_buf[i])
-					: "d0", "memory");
-				ret += cnt;
-			}
-
-			TORRENT_ASSERT(ret <= size());
-			TORRENT_ASSERT(ret >= 0);
-			return ret;
+#if defined __GNUC__ && (defined __x86_64__ || defined __amd64__)
+			std::uint64_t cnt = 0;
+			__asm__("popcnt %1, %0"
+				: "=r"(cnt)
+				: "r"(v));
+			return int(cnt);
+#elif defined __GNUC__
+			std::uint32_t lo = 0;
+			std::uint32_t hi = 0;
+			__asm__("popcnt %1, %0"
+				: "=r"(lo)
+				: "r"(std::uint32_t(v)));
+			__asm__("popcnt %1, %0"
+				: "=r"(hi)
+				: "r"(std::uint32_t(v >> 32)));
+			return int(lo + hi);
+#elif defined _M_X64
+			return int(_mm_popcnt_u64(v));
+#else
+			return int(_mm_popcnt_u32(std::uint32_t(v))
+				+ _mm_popcnt_u32(std::uint32_t(v >> 32)));
+#endif
 		}
-#endif // TORRENT_HAS_ARM_NEON
+	};
+#endif // TORRENT_HAS_SSE
 
-		for (int i = 1; i < words + 1; ++i)
+	// combines ``words`` 32 bit words of ``a`` and ``b`` with ``op`` and
+	// returns the population count of the result. The main loop handles 256
+	// bits per iteration into independent accumulators, to not serialize on
+	// the latency of the popcount instruction
+	template <typename Op, typename PopCount>
+	int count_words(std::uint32_t const* a, std::uint32_t const* b
+		, int const words, Op op, PopCount pop) noexcept
+	{
+		int c0 = 0;
+		int c1 = 0;
+		int c2 = 0;
+		int c3 = 0;
+		int i = 0;
+		for (; i + 8 <= words; i += 8)
 		{
-			std::uint32_t const v = m_buf[i];
-			// from:
-			// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
-			static const int S[] = {1, 2, 4, 8, 16}; // Magic Binary Numbers
-			static const std::uint32_t B[] = {0x55555555, 0x33333333, 0x0F0F0F0F, 0x00FF00FF, 0x0000FFFF};
-
-			std::uint32_t c = v - ((v >> 1) & B[0]);
-			c = ((c >> S[1]) & B[1]) + (c & B[1]);
-			c = ((c >> S[2]) + c) & B[2];
-			c = ((c >> S[3]) + c) & B[3];
-			c = ((c >> S[4]) + c) & B[4];
-			ret += c;
-			TORRENT_ASSERT(ret <= size());
+			c0 += pop(op(load64(a + i), load64(b + i)));
+			c1 += pop(op(load64(a + i + 2), load64(b + i + 2)));
+			c2 += pop(op(load64(a + i + 4), load64(b + i + 4)));
+			c3 += pop(op(load64(a + i + 6), load64(b + i + 6)));
 		}
+		for (; i + 2 <= words; i += 2)
+			c0 += pop(op(load64(a + i), load64(b + i)));
+		if (i < words)
+			c0 += pop(op(std::uint64_t(a[i]), std::uint64_t(b[i])));
+		return c0 + c1 + c2 + c3;
+	}
 
+	template <typename Op>
+	int count_words(std::uint32_t const* a, std::uint32_t const* b
+		, int const words, Op op) noexcept
+	{
+#if TORRENT_HAS_SSE
+		if (aux::mmx_support)
+			return count_words(a, b, words, op, popcount_hw());
+#endif
+		return count_words(a, b, words, op, popcount_sw());
+	}
+
+	struct op_first
+	{
+		std::uint64_t operator()(std::uint64_t const a, std::uint64_t) const noexcept
+		{ return a; }
+	};
+
+	struct op_and
+	{
+		std::uint64_t operator()(std::uint64_t const a, std::uint64_t const b) const noexcept
+		{ return a & b; }
+	};
+}
+
+	int bitfield::count() const noexcept
+	{
+		if (size() == 0) return 0;
+		int const ret = count_words(buf(), buf(), num_words(), op_first());
 		TORRENT_ASSERT(ret <= size());
 		TORRENT_ASSERT(ret >= 0);
 		return ret;
 	}
 
+	int bitfield::count_and(bitfield const& rhs) const noexcept
+	{
+		int const words = std::min(num_words(), rhs.num_words());
+		if (words == 0) return 0;
+		int const ret = count_words(buf(), rhs.buf(), words, op_and());
+		TORRENT_ASSERT(ret <= std::min(size(), rhs.size()));
+		TORRENT_ASSERT(ret >= 0);
+		return ret;
+	}
+
+	int bitfield::find_first_set_and_not(bitfield const& rhs) const noexcept
+	{
+		int const words = num_words();
+		if (words == 0) return -1;
+		int const common = std::min(words, rhs.num_words());
+		std::uint32_t const* a = buf();
+		std::uint32_t const* b = common > 0 ? rhs.buf() : nullptr;
+
+		// skip 128 bits at a time. Only the block with the first set bit is
+		// inspected word by word
+		int i = 0;
+		for (; i + 4 <= common; i += 4)
+		{
+			std::uint64_t const v0 = load64(a + i) & ~load64(b + i);
+			std::uint64_t const v1 = load64(a + i + 2) & ~load64(b + i + 2);
+			if ((v0 | v1) != 0) break;
+		}
+		for (; i < common; ++i)
+		{
+			std::uint32_t const v = a[i] & ~b[i];
+			if (v != 0) return i * 32 + aux::count_leading_zeros({&v, 1});
+		}
+
+		// past the end of rhs, every bit set in this bitfield is a match
+		if (i == words) return -1;
+		int const count = aux::count_leading_zeros({a + i, words - i});
+		return count != (words - i) * 32 ? i * 32 + count : -1;
+	}
+
 	void bitfield::resize(int const bits, bool const val)
 	{
 		if (bits == size()) return;
@@ -201,6 +291,21 @@ namespace libtorrent {
 		return count != num * 32 ? count : -1;
 	}
 
+	int bitfield::find_first_clear() const noexcept
+	{
+		int const num = num_words();
+		for (int i = 0; i < num; ++i)
+		{
+			if (m_buf[i + 1] == 0xffffffff) continue;
+			std::uint32_t const v = ~m_buf[i + 1];
+			// the trailing bits are always clear, make sure we don't report
+			// one of them
+			int const ret = i * 32 + aux::count_leading_zeros({&v, 1});
+			return ret < size() ? ret : -1;
+		}
+		return -1;
+	}
+
 	int bitfield::find_last_clear() const noexcept
 	{
 		int const num = num_words();
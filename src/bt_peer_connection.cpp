@@ -117,6 +117,38 @@ namespace {
 		return ret;
 	}
 
+	// derives a 32 byte ChaCha20 key from the DH secret and the stream key
+	std::array<char, 32> chacha20_key(std::array<char, dh_key_len> const& secret
+		, sha1_hash const& stream_key, char const (&label)[3])
+	{
+		std::array<char, 32> ret;
+		char const tag1[4] = {label[0], label[1], label[2], '1'};
+		char const tag2[4] = {label[0], label[1], label[2], '2'};
+		sha1_hash const h1 = hasher(tag1).update(secret).update(stream_key).final();
+		sha1_hash const h2 = hasher(tag2).update(secret).update(stream_key).final();
+		std::memcpy(ret.data(), h1.data(), 20);
+		std::memcpy(ret.data() + 20, h2.data(), 12);
+		return ret;
+	}
+
+	// the payload keys when chacha20 is negotiated. They are derived like the
+	// RC4 keys, but with different labels, since the RC4 keys are also used
+	// for the handshake
+	// outgoing connection : hash('chA1',S,SKEY) + hash('chA2',S,SKEY)
+	// incoming connection : hash('chB1',S,SKEY) + hash('chB2',S,SKEY)
+	std::shared_ptr<chacha20_handler> init_pe_chacha20_handler(key_t const& secret
+		, sha1_hash const& stream_key, bool const outgoing)
+	{
+		static char const chA[3] = {'c', 'h', 'A'};
+		static char const chB[3] = {'c', 'h', 'B'};
+		std::array<char, dh_key_len> const secret_buf = export_key(secret);
+
+		auto ret = std::make_shared<chacha20_handler>();
+		ret->set_outgoing_key(chacha20_key(secret_buf, stream_key, outgoing ? chA : chB));
+		ret->set_incoming_key(chacha20_key(secret_buf, stream_key, outgoing ? chB : chA));
+		return ret;
+	}
+
 } // anonymous namespace
 #endif
 
@@ -149,6 +181,7 @@ namespace {
 #if !defined TORRENT_DISABLE_ENCRYPTION
 		, m_encrypted(false)
 		, m_rc4_encrypted(false)
+		, m_chacha20_encrypted(false)
 		, m_recv_buffer(peer_connection::m_recv_buffer)
 #endif
 		, m_our_peer_id(pack.our_peer_id)
@@ -450,7 +483,9 @@ namespace {
 #if !defined TORRENT_DISABLE_ENCRYPTION
 		if (m_encrypted)
 		{
-			p.flags |= m_rc4_encrypted
+			p.flags |= m_chacha20_encrypted
+				? peer_info::chacha20_encrypted
+				: m_rc4_encrypted
 				? peer_info::rc4_encrypted
 				: peer_info::plaintext_encrypted;
 		}
@@ -487,7 +522,7 @@ namespace {
 			peer_log(peer_log_alert::info, "ENCRYPTION", "initiating encrypted handshake");
 #endif
 
-		m_dh_key_exchange.reset(new (std::nothrow) dh_key_exchange);
+		m_dh_key_exchange = m_ses.dh_threads().get_keypair();
 		if (!m_dh_key_exchange || !m_dh_key_exchange->good())
 		{
 			disconnect(errors::no_memory, operation_t::encryption);
@@ -516,6 +551,77 @@ namespace {
 #endif
 	}
 
+	void bt_peer_connection::on_pe_secret()
+	{
+		TORRENT_ASSERT(m_dh_key_exchange);
+		TORRENT_ASSERT(m_recv_buffer.packet_finished());
+
+#ifndef TORRENT_DISABLE_LOGGING
+		peer_log(peer_log_alert::info, "ENCRYPTION", "received DH key");
+#endif
+
+		// PadA/B can be a max of 512 bytes, and 20 bytes more for
+		// the sync hash (if incoming), or 8 bytes more for the
+		// encrypted verification constant (if outgoing). Instead
+		// of requesting the maximum possible, request the maximum
+		// possible to ensure we do not overshoot the standard
+		// handshake.
+
+		if (is_outgoing())
+		{
+			m_state = state_t::read_pe_syncvc;
+			write_pe3_sync();
+
+			// initial payload is the standard handshake, this is
+			// always rc4 if sent here. m_rc4_encrypted is flagged
+			// again according to peer selection.
+			switch_send_crypto(m_rc4);
+			write_handshake();
+			switch_send_crypto(std::shared_ptr<crypto_plugin>());
+
+			// vc,crypto_select,len(pad),pad, encrypt(handshake)
+			// 8+4+2+0+handshake_len
+			m_recv_buffer.reset(8+4+2+0+handshake_len);
+		}
+		else
+		{
+			// already written dh key
+			m_state = state_t::read_pe_synchash;
+			// synchash,skeyhash,vc,crypto_provide,len(pad),pad,encrypt(handshake)
+			m_recv_buffer.reset(20+20+8+4+2+0+handshake_len);
+		}
+		TORRENT_ASSERT(!m_recv_buffer.packet_finished());
+	}
+
+	void bt_peer_connection::on_dh_secret_computed()
+	{
+		TORRENT_ASSERT(is_single_thread());
+		if (is_disconnecting()) return;
+		TORRENT_ASSERT(m_state == state_t::wait_pe_secret);
+
+		std::shared_ptr<peer_connection> me(self());
+		cork c_(*this);
+
+		// any bytes the peer sent after its DH key are still in the receive
+		// buffer, past the key. Rewind to the end of the key and hand them to
+		// on_receive() again, the same way on_receive_data() would have
+		receive_buffer& buffer = peer_connection::m_recv_buffer;
+		int pending = buffer.pos() - int(dh_key_len);
+		TORRENT_ASSERT(pending >= 0);
+		buffer.rewind(pending);
+
+		on_pe_secret();
+
+		while (pending > 0 && !is_disconnecting())
+		{
+			int const sub_transferred = buffer.advance_pos(pending);
+			TORRENT_ASSERT(sub_transferred > 0);
+			on_receive(error_code(), std::size_t(sub_transferred));
+			pending -= sub_transferred;
+		}
+		resume_receive();
+	}
+
 	void bt_peer_connection::write_pe3_sync()
 	{
 		INVARIANT_CHECK;
@@ -574,8 +680,16 @@ namespace {
 		std::memcpy(ptr, obfsc_hash.data(), 20);
 		ptr += 20;
 
+		// this is an invalid setting, but let's just make the best of the situation
+		int const enc_level = m_settings.get_int(settings_pack::allowed_enc_level);
+		std::uint8_t const crypto_provide = ((enc_level & settings_pack::pe_all) == 0)
+			? std::uint8_t(settings_pack::pe_both)
+			: std::uint8_t(enc_level & settings_pack::pe_all);
+
 		// Discard DH key exchange data, setup RC4 keys
 		m_rc4 = init_pe_rc4_handler(secret_key, info_hash, is_outgoing());
+		if (crypto_provide & settings_pack::pe_chacha20)
+			m_chacha20 = init_pe_chacha20_handler(secret_key, info_hash, is_outgoing());
 #ifndef TORRENT_DISABLE_LOGGING
 		peer_log(peer_log_alert::info, "ENCRYPTION", "computed RC4 keys");
 #endif
@@ -584,16 +698,11 @@ namespace {
 		// write the verification constant and crypto field
 		int const encrypt_size = int(sizeof(msg)) - 512 + pad_size - 40;
 
-		// this is an invalid setting, but let's just make the best of the situation
-		int const enc_level = m_settings.get_int(settings_pack::allowed_enc_level);
-		std::uint8_t const crypto_provide = ((enc_level & settings_pack::pe_both) == 0)
-			? std::uint8_t(settings_pack::pe_both)
-			: std::uint8_t(enc_level);
-
 #ifndef TORRENT_DISABLE_LOGGING
-		static char const* level[] = {"plaintext", "rc4", "plaintext rc4"};
-		peer_log(peer_log_alert::info, "ENCRYPTION"
-			, "%s", level[crypto_provide - 1]);
+		peer_log(peer_log_alert::info, "ENCRYPTION", "%s%s%s"
+			, (crypto_provide & settings_pack::pe_plaintext) ? " plaintext" : ""
+			, (crypto_provide & settings_pack::pe_rc4) ? " rc4" : ""
+			, (crypto_provide & settings_pack::pe_chacha20) ? " chacha20" : "");
 #endif
 
 		write_pe_vc_cryptofield({ptr, encrypt_size}, crypto_provide, pad_size);
@@ -609,7 +718,9 @@ namespace {
 		TORRENT_ASSERT(!is_outgoing());
 		TORRENT_ASSERT(!m_encrypted);
 		TORRENT_ASSERT(!m_rc4_encrypted);
-		TORRENT_ASSERT(crypto_select == 0x02 || crypto_select == 0x01);
+		TORRENT_ASSERT(crypto_select == settings_pack::pe_chacha20
+			|| crypto_select == settings_pack::pe_rc4
+			|| crypto_select == settings_pack::pe_plaintext);
 		TORRENT_ASSERT(!m_sent_handshake);
 
 		int const pad_size = int(random(512));
@@ -623,14 +734,13 @@ namespace {
 		send_buffer(vec);
 
 		// encryption method has been negotiated
-		if (crypto_select == 0x02)
-			m_rc4_encrypted = true;
-		else // 0x01
-			m_rc4_encrypted = false;
+		m_rc4_encrypted = crypto_select != settings_pack::pe_plaintext;
+		m_chacha20_encrypted = crypto_select == settings_pack::pe_chacha20;
 
 #ifndef TORRENT_DISABLE_LOGGING
 		peer_log(peer_log_alert::info, "ENCRYPTION", " crypto select: %s"
-			, (crypto_select == 0x01) ? "plaintext" : "rc4");
+			, (crypto_select == settings_pack::pe_plaintext) ? "plaintext"
+			: (crypto_select == settings_pack::pe_rc4) ? "rc4" : "chacha20");
 #endif
 	}
 
@@ -641,7 +751,7 @@ namespace {
 	{
 		INVARIANT_CHECK;
 
-		TORRENT_ASSERT(crypto_field <= 0x03 && crypto_field > 0);
+		TORRENT_ASSERT(crypto_field <= settings_pack::pe_all && crypto_field > 0);
 		// vc,crypto_field,len(pad),pad, (len(ia))
 		TORRENT_ASSERT((write_buf.size() >= 8+4+2+pad_size+2
 				&& is_outgoing())
@@ -760,6 +870,8 @@ namespace {
 		std::shared_ptr<torrent> t = associated_torrent().lock();
 		TORRENT_ASSERT(t);
 
+		if (receiving_into_disk_buffer()) return disk_buffer_piece_progress();
+
 		span<char const> recv_buffer = m_recv_buffer.get();
 		// are we currently receiving a 'piece' message?
 		if (m_state != state_t::read_packet
@@ -1131,7 +1243,26 @@ namespace {
 		}
 
 		incoming_piece_fragment(piece_bytes);
-		if (!m_recv_buffer.packet_finished()) return;
+		if (!m_recv_buffer.packet_finished())
+		{
+			// the header has been parsed, receive the rest of the payload
+			// straight into a disk buffer. That requires the bytes on the wire
+			// to be the payload itself, i.e. not encrypted
+			if (!merkle
+#if !defined TORRENT_DISABLE_ENCRYPTION
+				&& m_enc_handler.is_recv_plaintext()
+#endif
+				&& !is_disconnecting()
+				&& receive_piece_into_disk_buffer(p, recv_buffer.subspan(header_size)))
+			{
+				// as far as the receive buffer is concerned, this message is
+				// done. Drop what has been received of it and expect the next
+				// message once the payload is in
+				m_state = state_t::read_packet_size;
+				m_recv_buffer.cut(recv_pos, 5);
+			}
+			return;
+		}
 
 		if (merkle && list_size > 0)
 		{
@@ -2480,45 +2611,39 @@ namespace {
 			if (!is_outgoing()) write_pe1_2_dhkey();
 			if (is_disconnecting()) return;
 
+			dh_thread_pool& dh_threads = m_ses.dh_threads();
+			if (dh_threads.num_threads() > 0)
+			{
+				std::array<char, dh_key_len> remote_key;
+				std::memcpy(remote_key.data(), recv_buffer.data(), dh_key_len);
+
+				// computing the shared secret is expensive, leave it to one of
+				// the DH threads. Until it's done, any more data from the peer
+				// is left in the receive buffer
+				m_state = state_t::wait_pe_secret;
+				suspend_receive();
+				std::weak_ptr<peer_connection> conn = self();
+				dh_threads.async_compute_secret(m_dh_key_exchange, remote_key, [conn]
+				{
+					std::shared_ptr<peer_connection> p = conn.lock();
+					if (!p) return;
+					static_cast<bt_peer_connection*>(p.get())->on_dh_secret_computed();
+				});
+				return;
+			}
+
 			// read dh key, generate shared secret
 			m_dh_key_exchange->compute_secret(
 				reinterpret_cast<std::uint8_t const*>(recv_buffer.data()));
+			on_pe_secret();
+			return;
+		}
 
-#ifndef TORRENT_DISABLE_LOGGING
-			peer_log(peer_log_alert::info, "ENCRYPTION", "received DH key");
-#endif
-
-			// PadA/B can be a max of 512 bytes, and 20 bytes more for
-			// the sync hash (if incoming), or 8 bytes more for the
-			// encrypted verification constant (if outgoing). Instead
-			// of requesting the maximum possible, request the maximum
-			// possible to ensure we do not overshoot the standard
-			// handshake.
-
-			if (is_outgoing())
-			{
-				m_state = state_t::read_pe_syncvc;
-				write_pe3_sync();
-
-				// initial payload is the standard handshake, this is
-				// always rc4 if sent here. m_rc4_encrypted is flagged
-				// again according to peer selection.
-				switch_send_crypto(m_rc4);
-				write_handshake();
-				switch_send_crypto(std::shared_ptr<crypto_plugin>());
-
-				// vc,crypto_select,len(pad),pad, encrypt(handshake)
-				// 8+4+2+0+handshake_len
-				m_recv_buffer.reset(8+4+2+0+handshake_len);
-			}
-			else
-			{
-				// already written dh key
-				m_state = state_t::read_pe_synchash;
-				// synchash,skeyhash,vc,crypto_provide,len(pad),pad,encrypt(handshake)
-				m_recv_buffer.reset(20+20+8+4+2+0+handshake_len);
-			}
-			TORRENT_ASSERT(!m_recv_buffer.packet_finished());
+		if (m_state == state_t::wait_pe_secret)
+		{
+			// these bytes are handed to on_receive() again by
+			// on_dh_secret_computed()
+			TORRENT_ASSERT(m_recv_buffer.packet_size() == dh_key_len);
 			return;
 		}
 
@@ -2641,6 +2766,12 @@ namespace {
 
 				m_rc4 = init_pe_rc4_handler(m_dh_key_exchange->get_secret()
 					, ti->info_hash(), is_outgoing());
+				if (m_settings.get_int(settings_pack::allowed_enc_level)
+					& settings_pack::pe_chacha20)
+				{
+					m_chacha20 = init_pe_chacha20_handler(m_dh_key_exchange->get_secret()
+						, ti->info_hash(), is_outgoing());
+				}
 #ifndef TORRENT_DISABLE_LOGGING
 				peer_log(peer_log_alert::info, "ENCRYPTION", "computed RC4 keys");
 				peer_log(peer_log_alert::info, "ENCRYPTION", "stream key found, torrent located");
@@ -2767,17 +2898,19 @@ namespace {
 			std::uint32_t crypto_field = aux::read_uint32(recv_buffer);
 
 #ifndef TORRENT_DISABLE_LOGGING
-			peer_log(peer_log_alert::info, "ENCRYPTION", "crypto %s : [%s%s ]"
+			peer_log(peer_log_alert::info, "ENCRYPTION", "crypto %s : [%s%s%s ]"
 				, is_outgoing() ? "select" : "provide"
-				, (crypto_field & 1) ? " plaintext" : ""
-				, (crypto_field & 2) ? " rc4" : "");
+				, (crypto_field & settings_pack::pe_plaintext) ? " plaintext" : ""
+				, (crypto_field & settings_pack::pe_rc4) ? " rc4" : ""
+				, (crypto_field & settings_pack::pe_chacha20) ? " chacha20" : "");
 #endif
 
 			if (!is_outgoing())
 			{
 				// select a crypto method
 				int allowed_encryption = m_settings.get_int(settings_pack::allowed_enc_level);
-				std::uint32_t crypto_select = crypto_field & std::uint32_t(allowed_encryption);
+				std::uint32_t crypto_select = crypto_field & std::uint32_t(allowed_encryption)
+					& settings_pack::pe_all;
 
 				// when prefer_rc4 is set, keep the most significant bit
 				// otherwise keep the least significant one
@@ -2826,6 +2959,17 @@ namespace {
 					m_rc4_encrypted = false;
 				else if (crypto_field == settings_pack::pe_rc4)
 					m_rc4_encrypted = true;
+				else if (crypto_field == settings_pack::pe_chacha20 && m_chacha20)
+				{
+					m_rc4_encrypted = true;
+					m_chacha20_encrypted = true;
+				}
+				else
+				{
+					// the peer must select exactly one of the methods we offered
+					disconnect(errors::unsupported_encryption_mode_selected, operation_t::encryption, peer_error);
+					return;
+				}
 			}
 
 			int const len_pad = aux::read_int16(recv_buffer);
@@ -2845,8 +2989,8 @@ namespace {
 					m_encrypted = true;
 					if (m_rc4_encrypted)
 					{
-						switch_send_crypto(m_rc4);
-						switch_recv_crypto(m_rc4);
+						switch_send_crypto(payload_crypto());
+						switch_recv_crypto(payload_crypto());
 					}
 					m_state = state_t::init_bt_handshake;
 				}
@@ -2888,8 +3032,8 @@ namespace {
 					m_encrypted = true;
 					if (m_rc4_encrypted)
 					{
-						switch_send_crypto(m_rc4);
-						switch_recv_crypto(m_rc4);
+						switch_send_crypto(payload_crypto());
+						switch_recv_crypto(payload_crypto());
 					}
 					m_state = state_t::init_bt_handshake;
 				}
@@ -2905,8 +3049,8 @@ namespace {
 				m_encrypted = true;
 				if (m_rc4_encrypted)
 				{
-					switch_send_crypto(m_rc4);
-					switch_recv_crypto(m_rc4);
+					switch_send_crypto(payload_crypto());
+					switch_recv_crypto(payload_crypto());
 				}
 				m_state = state_t::init_bt_handshake;
 			}
@@ -2933,10 +3077,11 @@ namespace {
 			m_encrypted = true;
 			if (m_rc4_encrypted)
 			{
-				switch_send_crypto(m_rc4);
-				switch_recv_crypto(m_rc4);
+				switch_send_crypto(payload_crypto());
+				switch_recv_crypto(payload_crypto());
 			}
 			m_rc4.reset();
+			m_chacha20.reset();
 
 			m_state = state_t::read_protocol_identifier;
 			m_recv_buffer.cut(0, 20);
@@ -2951,9 +3096,9 @@ namespace {
 			// decrypt remaining received bytes
 			if (m_rc4_encrypted)
 			{
-				span<char> const remaining = m_recv_buffer.mutable_buffer()
+				span<char> remaining = m_recv_buffer.mutable_buffer()
 					.subspan(m_recv_buffer.packet_size());
-				rc4_decrypt(remaining);
+				payload_crypto()->decrypt(remaining);
 
 #ifndef TORRENT_DISABLE_LOGGING
 				peer_log(peer_log_alert::info, "ENCRYPTION"
@@ -2961,6 +3106,7 @@ namespace {
 #endif
 			}
 			m_rc4.reset();
+			m_chacha20.reset();
 
 			// payload stream, start with 20 handshake bytes
 			m_state = state_t::read_protocol_identifier;
@@ -32,26 +32,30 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/create_torrent.hpp"
 #include "libtorrent/utf8.hpp"
-#include "libtorrent/disk_io_thread.hpp"
 #include "libtorrent/aux_/merkle.hpp" // for merkle_*()
 #include "libtorrent/torrent_info.hpp"
 #include "libtorrent/announce_entry.hpp"
-#include "libtorrent/performance_counters.hpp" // for counters
-#include "libtorrent/alert_manager.hpp"
 #include "libtorrent/aux_/path.hpp"
+#include "libtorrent/file.hpp"
+#include "libtorrent/hasher.hpp"
+#include "libtorrent/settings_pack.hpp"
 
 #include <sys/types.h>
 #include <sys/stat.h>
 
 #include <functional>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <cstring>
+#include <atomic>
 
 #if TORRENT_ABI_VERSION == 1 && defined TORRENT_WINDOWS
 #include "libtorrent/aux_/escape_string.hpp"
 #endif
 
-using namespace std::placeholders;
-
 namespace libtorrent {
 
 	constexpr create_flags_t create_torrent::optimize_alignment;
@@ -85,91 +89,288 @@ namespace {
 	}
 #endif
 
+	// directories with at least this many entries have them stat()ed on
+	// multiple threads. Below this, starting the threads costs more than it
+	// saves
+	constexpr int parallel_stat_threshold = 256;
+
+	// what add_files_impl() needs to know about a file or directory
+	struct dir_entry
+	{
+		std::string leaf;
+		file_status status;
+		error_code ec;
+		file_flags_t flags;
+		std::string symlink_path;
+	};
+
+	void stat_entry(std::string const& f, dir_entry& e, create_flags_t const flags)
+	{
+		stat_file(f, &e.status, e.ec, (flags & create_torrent::symlinks) ? dont_follow_links : 0);
+		if (e.ec || (e.status.mode & file_status::directory)) return;
+
+		e.flags = aux::get_file_attributes(f);
+		if ((e.flags & file_storage::flag_symlink) && (flags & create_torrent::symlinks))
+			e.symlink_path = aux::get_symlink_path(f);
+	}
+
+	// calls fun(i) for every i in [0, n), spread over up to ``num_threads``
+	// threads
+	template <typename Fun>
+	void parallel_for(int const n, int const num_threads, Fun const& fun)
+	{
+		std::atomic<int> next(0);
+		auto const worker = [&] {
+			for (int i = next++; i < n; i = next++) fun(i);
+		};
+		std::vector<std::thread> threads;
+		for (int i = 1; i < num_threads; ++i) threads.emplace_back(worker);
+		worker();
+		for (auto& t : threads) t.join();
+	}
+
+	void add_entry(file_storage& fs, std::string const& p
+		, std::string const& l, dir_entry const& e
+		, std::function<bool(std::string)> const& pred
+		, create_flags_t const flags);
+
 	void add_files_impl(file_storage& fs, std::string const& p
 		, std::string const& l, std::function<bool(std::string)> const& pred
 		, create_flags_t const flags)
 	{
 		std::string const f = combine_path(p, l);
 		if (!pred(f)) return;
-		error_code ec;
-		file_status s;
-		stat_file(f, &s, ec, (flags & create_torrent::symlinks) ? dont_follow_links : 0);
-		if (ec) return;
+		dir_entry e;
+		stat_entry(f, e, flags);
+		add_entry(fs, p, l, e, pred, flags);
+	}
+
+	void add_entry(file_storage& fs, std::string const& p
+		, std::string const& l, dir_entry const& e
+		, std::function<bool(std::string)> const& pred
+		, create_flags_t const flags)
+	{
+		if (e.ec) return;
 
 		// recurse into directories
-		bool recurse = (s.mode & file_status::directory) != 0;
+		bool recurse = (e.status.mode & file_status::directory) != 0;
 
 		// if the file is not a link or we're following links, and it's a directory
 		// only then should we recurse
 #ifndef TORRENT_WINDOWS
-		if ((s.mode & file_status::link) && (flags & create_torrent::symlinks))
+		if ((e.status.mode & file_status::link) && (flags & create_torrent::symlinks))
 			recurse = false;
 #endif
 
-		if (recurse)
+		if (!recurse)
 		{
-			for (directory i(f, ec); !i.done(); i.next(ec))
-			{
-				std::string const leaf = i.file();
-				if (ignore_subdir(leaf)) continue;
-				add_files_impl(fs, p, combine_path(l, leaf), pred, flags);
-			}
-		}
-		else
-		{
-			// #error use the fields from s
-			file_flags_t const file_flags = aux::get_file_attributes(f);
-
 			// mask all bits to check if the file is a symlink
-			if ((file_flags & file_storage::flag_symlink)
+			if ((e.flags & file_storage::flag_symlink)
 				&& (flags & create_torrent::symlinks))
 			{
-				std::string const sym_path = aux::get_symlink_path(f);
-				fs.add_file(l, 0, file_flags, std::time_t(s.mtime), sym_path);
+				fs.add_file(l, 0, e.flags, std::time_t(e.status.mtime), e.symlink_path);
 			}
 			else
 			{
-				fs.add_file(l, s.file_size, file_flags, std::time_t(s.mtime));
+				fs.add_file(l, e.status.file_size, e.flags, std::time_t(e.status.mtime));
 			}
+			return;
+		}
+
+		std::string const f = combine_path(p, l);
+
+		// the predicate is called in directory order, on this thread. Only the
+		// stat() calls (which may be slow on network file systems) are made in
+		// parallel
+		std::vector<dir_entry> entries;
+		error_code ec;
+		for (directory i(f, ec); !i.done(); i.next(ec))
+		{
+			std::string leaf = i.file();
+			if (ignore_subdir(leaf)) continue;
+			if (!pred(combine_path(f, leaf))) continue;
+			entries.emplace_back();
+			entries.back().leaf = std::move(leaf);
 		}
+
+		int const num_entries = int(entries.size());
+		int const num_threads = num_entries < parallel_stat_threshold ? 1
+			: std::max(1, std::min(8, int(std::thread::hardware_concurrency())));
+		parallel_for(num_entries, num_threads, [&](int const i)
+		{
+			auto& de = entries[std::size_t(i)];
+			stat_entry(combine_path(f, de.leaf), de, flags);
+		});
+
+		for (auto const& de : entries)
+			add_entry(fs, p, combine_path(l, de.leaf), de, pred, flags);
 	}
 
-	struct hash_state
+	// the number of bytes to read from disk at a time when hashing files. Reads
+	// are rounded up to whole pieces
+	constexpr int hash_read_size = 4 * 1024 * 1024;
+
+	// a range of pieces read from disk in one go, and their hashes once the
+	// hashing threads are done with them
+	struct hash_chunk
 	{
-		create_torrent& ct;
-		storage_holder storage;
-		disk_io_thread& iothread;
-		piece_index_t piece_counter;
-		piece_index_t completed_piece;
-		std::function<void(piece_index_t)> const& f;
-		error_code& ec;
+		piece_index_t first;
+		int num_pieces;
+		std::vector<char> buffer;
+		std::vector<sha1_hash> hashes;
+		bool done = false;
 	};
 
-	void on_hash(piece_index_t const piece, sha1_hash const& piece_hash
-		, storage_error const& error, hash_state* st)
+	// hashes chunks on a pool of threads. Chunks are handed back in the order
+	// they were pushed, so piece hashes (and progress) are reported in order
+	class hash_pool
 	{
-		if (error)
+	public:
+		hash_pool(int const num_threads, int const piece_length)
+			: m_piece_length(piece_length)
 		{
-			// on error
-			st->ec = error.ec;
-			st->iothread.abort(true);
-			return;
+			for (int i = 0; i < num_threads; ++i)
+				m_threads.emplace_back([this] { worker(); });
+		}
+
+		~hash_pool()
+		{
+			{
+				std::lock_guard<std::mutex> l(m_mutex);
+				m_abort = true;
+			}
+			m_cond.notify_all();
+			for (auto& t : m_threads) t.join();
 		}
-		st->ct.set_hash(piece, piece_hash);
-		st->f(st->completed_piece);
-		++st->completed_piece;
-		if (st->piece_counter < st->ct.files().end_piece())
+
+		hash_pool(hash_pool const&) = delete;
+		hash_pool& operator=(hash_pool const&) = delete;
+
+		void push(std::shared_ptr<hash_chunk> c)
 		{
-			st->iothread.async_hash(st->storage, st->piece_counter
-				, disk_interface::sequential_access
-				, std::bind(&on_hash, _1, _2, _3, st));
-			++st->piece_counter;
+			{
+				std::lock_guard<std::mutex> l(m_mutex);
+				m_queue.push_back(c);
+				m_outstanding.push_back(std::move(c));
+			}
+			m_cond.notify_all();
 		}
-		else
+
+		// blocks until the oldest outstanding chunk has been hashed
+		std::shared_ptr<hash_chunk> pop()
+		{
+			std::unique_lock<std::mutex> l(m_mutex);
+			TORRENT_ASSERT(!m_outstanding.empty());
+			m_done_cond.wait(l, [this] { return m_outstanding.front()->done; });
+			auto ret = std::move(m_outstanding.front());
+			m_outstanding.pop_front();
+			return ret;
+		}
+
+		int outstanding() const
 		{
-			st->iothread.abort(true);
+			std::lock_guard<std::mutex> l(m_mutex);
+			return int(m_outstanding.size());
 		}
-		st->iothread.submit_jobs();
+
+	private:
+
+		void worker()
+		{
+			std::unique_lock<std::mutex> l(m_mutex);
+			for (;;)
+			{
+				m_cond.wait(l, [this] { return m_abort || !m_queue.empty(); });
+				if (m_abort) return;
+				std::shared_ptr<hash_chunk> c = std::move(m_queue.front());
+				m_queue.pop_front();
+				l.unlock();
+
+				c->hashes.resize(std::size_t(c->num_pieces));
+				std::size_t const size = c->buffer.size();
+				std::size_t const plen = std::size_t(m_piece_length);
+				for (std::size_t i = 0; i < c->hashes.size(); ++i)
+				{
+					std::size_t const offset = i * plen;
+					c->hashes[i] = hasher(c->buffer.data() + offset
+						, int(std::min(plen, size - offset))).final();
+				}
+				// the buffer is not needed anymore. Free it early, to bound the
+				// memory used by chunks waiting to be popped
+				std::vector<char>().swap(c->buffer);
+
+				l.lock();
+				c->done = true;
+				m_done_cond.notify_all();
+			}
+		}
+
+		int const m_piece_length;
+		mutable std::mutex m_mutex;
+
+		// signalled when a chunk is pushed, or the pool is shut down
+		std::condition_variable m_cond;
+
+		// signalled when a chunk has been hashed
+		std::condition_variable m_done_cond;
+
+		// chunks not yet picked up by a hashing thread
+		std::deque<std::shared_ptr<hash_chunk>> m_queue;
+
+		// all chunks that have not been popped yet, in order
+		std::deque<std::shared_ptr<hash_chunk>> m_outstanding;
+
+		bool m_abort = false;
+		std::vector<std::thread> m_threads;
+	};
+
+	// reads the pieces [first, first + num_pieces) into a contiguous buffer.
+	// ``f`` and ``file_index`` cache the most recently opened file, since reads
+	// are sequential
+	std::shared_ptr<hash_chunk> read_chunk(file_storage const& fs
+		, std::string const& path, piece_index_t const first, int const num_pieces
+		, file& f, file_index_t& file_index, error_code& ec)
+	{
+		auto c = std::make_shared<hash_chunk>();
+		c->first = first;
+		c->num_pieces = num_pieces;
+
+		std::int64_t const start = static_cast<int>(first) * std::int64_t(fs.piece_length());
+		std::int64_t const size = std::min(fs.total_size() - start
+			, std::int64_t(num_pieces) * fs.piece_length());
+		c->buffer.resize(std::size_t(size));
+
+		char* ptr = c->buffer.data();
+		for (auto const& s : fs.map_block(first, 0, int(size)))
+		{
+			if (s.size == 0) continue;
+			if (fs.pad_file_at(s.file_index))
+			{
+				std::memset(ptr, 0, std::size_t(s.size));
+				ptr += s.size;
+				continue;
+			}
+
+			if (file_index != s.file_index || !f.is_open())
+			{
+				f.close();
+				if (!f.open(fs.file_path(s.file_index, path), open_mode::read_only, ec))
+					return {};
+				file_index = s.file_index;
+			}
+
+			iovec_t const b = {ptr, std::ptrdiff_t(s.size)};
+			std::int64_t const ret = f.readv(s.offset, b, ec);
+			if (ec) return {};
+			if (ret != s.size)
+			{
+				ec = boost::asio::error::eof;
+				return {};
+			}
+			ptr += s.size;
+		}
+		TORRENT_ASSERT(ptr == c->buffer.data() + c->buffer.size());
+		return c;
 	}
 
 } // anonymous namespace
@@ -257,91 +458,66 @@ namespace aux {
 			, default_pred, flags);
 	}
 
-namespace {
-	struct disk_aborter
+	void set_piece_hashes(create_torrent& t, std::string const& p
+		, std::function<void(piece_index_t)> const& f, error_code& ec)
 	{
-		explicit disk_aborter(disk_io_thread& dio) : m_dio(dio) {}
-		~disk_aborter() { m_dio.abort(true); }
-		disk_aborter(disk_aborter const&) = delete;
-		disk_aborter& operator=(disk_aborter const&) = delete;
-	private:
-		disk_io_thread& m_dio;
-	};
-}
+		set_piece_hashes(t, p, settings_pack(), f, ec);
+	}
 
 	void set_piece_hashes(create_torrent& t, std::string const& p
+		, settings_pack const& settings
 		, std::function<void(piece_index_t)> const& f, error_code& ec)
 	{
-		// optimized path
-#ifdef TORRENT_BUILD_SIMULATOR
-		sim::default_config conf;
-		sim::simulation sim{conf};
-		io_service ios{sim};
-#else
-		io_service ios;
-#endif
-
 #if TORRENT_USE_UNC_PATHS
 		std::string const path = canonicalize_path(p);
 #else
 		std::string const& path = p;
 #endif
 
-		if (t.files().num_files() == 0)
+		file_storage const& fs = t.files();
+		if (fs.num_files() == 0)
 		{
 			ec = errors::no_files_in_torrent;
 			return;
 		}
 
-		if (t.files().total_size() == 0)
+		if (fs.total_size() == 0)
 		{
 			ec = errors::torrent_invalid_length;
 			return;
 		}
 
-		counters cnt;
-		aux::session_settings sett;
-
-		sett.set_int(settings_pack::cache_size, 0);
-		int const num_threads = disk_io_thread::hasher_thread_divisor - 1;
-		int const jobs_per_thread = 4;
-		sett.set_int(settings_pack::aio_threads, num_threads);
-
-		disk_io_thread disk_thread(ios, sett, cnt);
-		disk_aborter da(disk_thread);
-
-		aux::vector<download_priority_t, file_index_t> priorities;
-		sha1_hash info_hash;
-		storage_params params{
-			t.files(),
-			nullptr,
-			path,
-			storage_mode_t::storage_mode_sparse,
-			priorities,
-			info_hash
-		};
-
-		storage_holder storage = disk_thread.new_torrent(default_storage_constructor
-			, params, std::shared_ptr<void>());
+		// the calling thread reads the files, in large sequential chunks, while
+		// the hashing threads hash the chunks read previously
+		int const num_threads = std::max(1, settings.get_int(settings_pack::aio_threads));
+		int const chunk_pieces = std::max(1, hash_read_size / fs.piece_length());
+		int const max_outstanding = 2 * num_threads;
 
-		int const piece_read_ahead = std::max(num_threads * jobs_per_thread
-			, default_block_size / t.piece_length());
+		hash_pool pool(num_threads, fs.piece_length());
+		file current_file;
+		file_index_t current_index{-1};
 
-		hash_state st = { t, std::move(storage), disk_thread, piece_index_t(0), piece_index_t(0), f, ec };
-		for (piece_index_t i(0); i < piece_index_t(piece_read_ahead); ++i)
+		piece_index_t next(0);
+		piece_index_t const end = fs.end_piece();
+		while (next < end || pool.outstanding() > 0)
 		{
-			disk_thread.async_hash(st.storage, i, disk_interface::sequential_access
-				, std::bind(&on_hash, _1, _2, _3, &st));
-			++st.piece_counter;
-			if (st.piece_counter >= t.files().end_piece()) break;
-		}
-		disk_thread.submit_jobs();
+			while (next < end && pool.outstanding() < max_outstanding)
+			{
+				int const n = std::min(chunk_pieces, static_cast<int>(end) - static_cast<int>(next));
+				auto c = read_chunk(fs, path, next, n, current_file, current_index, ec);
+				if (ec) return;
+				pool.push(std::move(c));
+				next += n;
+			}
 
-#ifdef TORRENT_BUILD_SIMULATOR
-		sim.run();
-#else
-		ios.run(ec);
-#endif
+			auto const c = pool.pop();
+			for (int i = 0; i < c->num_pieces; ++i)
+			{
+				piece_index_t const piece(static_cast<int>(c->first) + i);
+				t.set_hash(piece, c->hashes[std::size_t(i)]);
+				f(piece);
+			}
+		}
 	}
 
 	create_torrent::~create_torrent() = default;
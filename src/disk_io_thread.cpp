@@ -131,6 +131,18 @@ namespace libtorrent {
 
 #endif // DEBUG_DISK_THREAD
 
+	// the histogram the execution time of a job is recorded in
+	int latency_histogram(job_action_t const action)
+	{
+		switch (action)
+		{
+			case job_action_t::read: return counters::disk_read_latency;
+			case job_action_t::write: return counters::disk_write_latency;
+			case job_action_t::hash: return counters::disk_hash_latency;
+			default: return counters::disk_other_latency;
+		}
+	}
+
 	open_mode_t file_flags_for_job(disk_io_job* j
 		, bool const coalesce_buffers)
 	{
@@ -1181,6 +1193,10 @@ constexpr disk_job_flags_t disk_interface::cache_hit;
 
 		m_stats_counters.inc_stats_counter(counters::num_running_disk_jobs, 1);
 
+		time_point const start_time = clock_type::now();
+		m_stats_counters.add_latency_sample(counters::disk_queue_latency
+			, total_microseconds(start_time - j->issue_time));
+
 		// call disk function
 		// TODO: in the future, propagate exceptions back to the handlers
 		status_t ret = status_t::no_error;
@@ -1213,6 +1229,8 @@ constexpr disk_job_flags_t disk_interface::cache_hit;
 			|| (j->error.ec && j->error.operation != operation_t::unknown));
 
 		m_stats_counters.inc_stats_counter(counters::num_running_disk_jobs, -1);
+		m_stats_counters.add_latency_sample(latency_histogram(j->action)
+			, total_microseconds(clock_type::now() - start_time));
 
 		std::unique_lock<std::mutex> l(m_cache_mutex);
 		if (m_cache_check_state == cache_check_idle)
@@ -1730,10 +1748,30 @@ constexpr disk_job_flags_t disk_interface::cache_hit;
 		TORRENT_ASSERT(buf != nullptr);
 
 		bool exceeded = false;
-		disk_buffer_holder buffer(*this, m_disk_cache.allocate_buffer(exceeded, o, "receive buffer"), 0x4000);
+		disk_buffer_holder buffer = allocate_disk_buffer(exceeded, o, "receive buffer");
 		if (!buffer) aux::throw_ex<std::bad_alloc>();
 		std::memcpy(buffer.get(), buf, aux::numeric_cast<std::size_t>(r.length));
 
+		async_write(storage, r, std::move(buffer), std::move(handler), flags);
+		return exceeded;
+	}
+
+	disk_buffer_holder disk_io_thread::allocate_disk_buffer(bool& exceeded
+		, std::shared_ptr<disk_observer> o, char const* category)
+	{
+		char* buf = m_disk_cache.allocate_buffer(exceeded, std::move(o), category);
+		return disk_buffer_holder(*this, buf, default_block_size);
+	}
+
+	void disk_io_thread::async_write(storage_index_t const storage, peer_request const& r
+		, disk_buffer_holder buffer
+		, std::function<void(storage_error const&)> handler
+		, disk_job_flags_t const flags)
+	{
+		TORRENT_ASSERT(r.length <= default_block_size);
+		TORRENT_ASSERT(buffer);
+		TORRENT_ASSERT(is_disk_buffer(buffer.get()));
+
 		disk_io_job* j = allocate_job(job_action_t::write);
 		j->storage = m_torrents[storage]->shared_from_this();
 		j->piece = r.piece;
@@ -1781,7 +1819,7 @@ constexpr disk_job_flags_t disk_interface::cache_hit;
 			DLOG("blocked job: %s (torrent: %d total: %d)\n"
 				, job_name(j->action), j->storage ? j->storage->num_blocked() : 0
 				, int(m_stats_counters[counters::blocked_disk_jobs]));
-			return exceeded;
+			return;
 		}
 
 		std::unique_lock<std::mutex> l(m_cache_mutex);
@@ -1808,12 +1846,11 @@ constexpr disk_job_flags_t disk_interface::cache_hit;
 
 			// if we added the block (regardless of whether we also
 			// issued a flush job or not), we're done.
-			return exceeded;
+			return;
 		}
 		l.unlock();
 
 		add_job(j);
-		return exceeded;
 	}
 
 	void disk_io_thread::async_hash(storage_index_t const storage
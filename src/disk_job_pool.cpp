@@ -62,6 +62,7 @@ namespace libtorrent {
 
 		new (ptr) disk_io_job;
 		ptr->action = type;
+		ptr->issue_time = clock_type::now();
 #if TORRENT_USE_ASSERTS
 		ptr->in_use = true;
 #endif
@@ -245,6 +245,7 @@ namespace libtorrent {
 			"udp tracker response packet has invalid size",
 			"invalid transaction id in udp tracker response",
 			"invalid action field in udp tracker response",
+			"invalid or truncated binary resume data",
 #if TORRENT_ABI_VERSION == 1
 			"",
 			"",
@@ -255,7 +256,6 @@ namespace libtorrent {
 			"",
 			"",
 			"",
-			"",
 
 // bdecode errors
 			"expected string in bencoded string",
@@ -269,7 +269,7 @@ namespace libtorrent {
 			"",
 			"",
 #else
-			"", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "",
+			"", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "", "",
 #endif
 			"random number generator failed",
 		};
@@ -173,22 +173,48 @@ namespace {
 
 	int file_storage::get_or_add_path(string_view const path)
 	{
-		// do we already have this path in the path list?
-		auto const p = std::find(m_paths.rbegin(), m_paths.rend(), path);
+		// files are typically ordered by directory, so the most likely match is
+		// the path we added last
+		if (!m_paths.empty() && m_paths.back() == path)
+			return int(m_paths.size()) - 1;
 
-		if (p == m_paths.rend())
+		auto const path_hash = [](string_view const p)
 		{
-			// no, we don't. add it
-			int const ret = int(m_paths.size());
-			TORRENT_ASSERT(path.size() == 0 || path[0] != '/');
-			m_paths.emplace_back(path.data(), path.size());
-			return ret;
+			boost::crc_32_type crc;
+			crc.process_bytes(p.data(), p.size());
+			return std::uint32_t(crc.checksum());
+		};
+
+		// the index may have been freed by clear_path_index()
+		if (m_path_index.size() != m_paths.size())
+		{
+			m_path_index.clear();
+			m_path_index.reserve(m_paths.size());
+			for (int i = 0; i < int(m_paths.size()); ++i)
+				m_path_index.emplace(path_hash(m_paths[i]), i);
 		}
-		else
+
+		// do we already have this path in the path list?
+		std::uint32_t const h = path_hash(path);
+		auto const range = m_path_index.equal_range(h);
+		for (auto i = range.first; i != range.second; ++i)
 		{
 			// yes we do. use it
-			return int(p.base() - m_paths.begin() - 1);
+			if (m_paths[i->second] == path) return i->second;
 		}
+
+		// no, we don't. add it
+		int const ret = int(m_paths.size());
+		TORRENT_ASSERT(path.size() == 0 || path[0] != '/');
+		m_paths.emplace_back(path.data(), path.size());
+		m_path_index.emplace(h, ret);
+		return ret;
+	}
+
+	void file_storage::clear_path_index()
+	{
+		// clear() keeps the bucket array
+		std::unordered_multimap<std::uint32_t, int>().swap(m_path_index);
 	}
 
 #if TORRENT_ABI_VERSION == 1
@@ -987,6 +1013,7 @@ namespace {
 		swap(ti.m_symlinks, m_symlinks);
 		swap(ti.m_mtime, m_mtime);
 		swap(ti.m_paths, m_paths);
+		swap(ti.m_path_index, m_path_index);
 		swap(ti.m_name, m_name);
 		swap(ti.m_total_size, m_total_size);
 		swap(ti.m_num_pieces, m_num_pieces);
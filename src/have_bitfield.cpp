@@ -0,0 +1,250 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/aux_/have_bitfield.hpp"
+
+#include <algorithm>
+
+namespace libtorrent { namespace aux {
+
+namespace {
+
+	template <typename T>
+	void free_memory(std::vector<T>& v)
+	{
+		std::vector<T>().swap(v);
+	}
+}
+
+	void have_bitfield::assign(typed_bitfield<piece_index_t> const& bits)
+	{
+		m_size = bits.size();
+		m_count = bits.count();
+
+		if (m_size > 0 && m_count == m_size)
+		{
+			set_all();
+			return;
+		}
+
+		if (m_count <= sparse_limit())
+		{
+			m_bits.clear();
+			m_pieces.clear();
+			m_pieces.reserve(std::size_t(m_count));
+			piece_index_t index(0);
+			for (auto i = bits.begin(), end(bits.end());
+				int(m_pieces.size()) < m_count && i != end; ++i, ++index)
+			{
+				if (*i) m_pieces.push_back(index);
+			}
+			TORRENT_ASSERT(int(m_pieces.size()) == m_count);
+			m_form = form_t::sparse;
+			return;
+		}
+
+		free_memory(m_pieces);
+		m_bits = bits;
+		m_form = form_t::dense;
+	}
+
+	bool have_bitfield::get_bit(piece_index_t const index) const
+	{
+		TORRENT_ASSERT(index >= piece_index_t(0));
+		TORRENT_ASSERT(index < end_index());
+		switch (m_form)
+		{
+			case form_t::all: return true;
+			case form_t::sparse:
+				return std::binary_search(m_pieces.begin(), m_pieces.end(), index);
+			case form_t::dense: return m_bits.get_bit(index);
+		}
+		return false;
+	}
+
+	void have_bitfield::set_bit(piece_index_t const index)
+	{
+		TORRENT_ASSERT(index >= piece_index_t(0));
+		TORRENT_ASSERT(index < end_index());
+		if (m_form == form_t::all) return;
+
+		if (m_form == form_t::sparse)
+		{
+			auto const i = std::lower_bound(m_pieces.begin(), m_pieces.end(), index);
+			if (i != m_pieces.end() && *i == index) return;
+			++m_count;
+			if (m_count == m_size)
+			{
+				set_all();
+			}
+			else if (m_count > sparse_limit())
+			{
+				to_dense();
+				m_bits.set_bit(index);
+			}
+			else
+			{
+				m_pieces.insert(i, index);
+			}
+			return;
+		}
+
+		if (m_bits.get_bit(index)) return;
+		++m_count;
+		if (m_count == m_size) set_all();
+		else m_bits.set_bit(index);
+	}
+
+	void have_bitfield::clear_bit(piece_index_t const index)
+	{
+		TORRENT_ASSERT(index >= piece_index_t(0));
+		TORRENT_ASSERT(index < end_index());
+
+		if (m_form == form_t::sparse)
+		{
+			auto const i = std::lower_bound(m_pieces.begin(), m_pieces.end(), index);
+			if (i == m_pieces.end() || *i != index) return;
+			m_pieces.erase(i);
+			--m_count;
+			return;
+		}
+
+		if (m_form == form_t::all)
+		{
+			// we don't move back to the sparse form here. A peer that has all
+			// but one piece won't have few enough for that to pay off
+			m_bits.clear();
+			m_bits.resize(m_size, true);
+			m_form = form_t::dense;
+		}
+
+		if (!m_bits.get_bit(index)) return;
+		m_bits.clear_bit(index);
+		--m_count;
+	}
+
+	void have_bitfield::set_all()
+	{
+		free_memory(m_pieces);
+		m_bits.clear();
+		m_count = m_size;
+		m_form = m_size > 0 ? form_t::all : form_t::sparse;
+	}
+
+	void have_bitfield::clear_all()
+	{
+		free_memory(m_pieces);
+		m_bits.clear();
+		m_count = 0;
+		m_form = form_t::sparse;
+	}
+
+	void have_bitfield::resize(int const bits, bool const val)
+	{
+		TORRENT_ASSERT(bits >= 0);
+		if (bits == m_size) return;
+
+		if (bits == 0)
+		{
+			clear();
+			return;
+		}
+
+		if (bits > m_size)
+		{
+			// the common cases are initializing the set, and growing it while
+			// we don't know the number of pieces yet. Neither requires
+			// changing the form
+			if (!val && m_form == form_t::sparse)
+			{
+				m_size = bits;
+				return;
+			}
+			if (val && m_count == m_size)
+			{
+				m_size = bits;
+				set_all();
+				return;
+			}
+		}
+
+		// everything else is rare enough to go via a plain bitfield
+		typed_bitfield<piece_index_t> b = to_bitfield();
+		b.resize(bits, val);
+		assign(b);
+	}
+
+	void have_bitfield::clear()
+	{
+		free_memory(m_pieces);
+		m_bits.clear();
+		m_size = 0;
+		m_count = 0;
+		m_form = form_t::sparse;
+	}
+
+	typed_bitfield<piece_index_t> const& have_bitfield::bitfield(
+		typed_bitfield<piece_index_t>& storage) const
+	{
+		if (m_form == form_t::dense) return m_bits;
+
+		storage.resize(m_size);
+		if (m_form == form_t::all)
+		{
+			storage.set_all();
+		}
+		else
+		{
+			storage.clear_all();
+			for (auto const p : m_pieces) storage.set_bit(p);
+		}
+		return storage;
+	}
+
+	typed_bitfield<piece_index_t> have_bitfield::to_bitfield() const
+	{
+		if (m_form == form_t::dense) return m_bits;
+		typed_bitfield<piece_index_t> ret;
+		bitfield(ret);
+		return ret;
+	}
+
+	void have_bitfield::to_dense()
+	{
+		TORRENT_ASSERT(m_form == form_t::sparse);
+		m_bits.clear();
+		m_bits.resize(m_size, false);
+		for (auto const p : m_pieces) m_bits.set_bit(p);
+		free_memory(m_pieces);
+		m_form = form_t::dense;
+	}
+}}
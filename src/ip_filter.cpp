@@ -50,6 +50,17 @@ namespace libtorrent {
 			TORRENT_ASSERT_FAIL();
 	}
 
+	void ip_filter::compile()
+	{
+		m_filter4.compile();
+		m_filter6.compile();
+	}
+
+	bool ip_filter::should_compile() const
+	{
+		return m_filter4.should_compile() || m_filter6.should_compile();
+	}
+
 	std::uint32_t ip_filter::access(address const& addr) const
 	{
 		if (addr.is_v4())
@@ -116,7 +116,7 @@ node::node(aux::listen_socket_handle const& sock, socket_manager* sock_man
 	: m_settings(settings)
 	, m_id(calculate_node_id(nid, sock))
 	, m_table(m_id, is_v4(sock.get_local_endpoint()) ? udp::v4() : udp::v6(), 8, settings, observer)
-	, m_rpc(m_id, m_settings, m_table, sock, sock_man, observer)
+	, m_rpc(m_id, m_settings, m_table, sock, sock_man, observer, cnt)
 	, m_sock(sock)
 	, m_sock_man(sock_man)
 	, m_get_foreign_node(std::move(get_foreign_node))
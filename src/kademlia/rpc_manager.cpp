@@ -52,6 +52,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <libtorrent/aux_/time.hpp> // for aux::time_now
 #include <libtorrent/aux_/aligned_union.hpp>
 #include <libtorrent/broadcast_socket.hpp> // for is_v6
+#include <libtorrent/performance_counters.hpp>
 
 #include <type_traits>
 #include <functional>
@@ -163,7 +164,8 @@ rpc_manager::rpc_manager(node_id const& our_id
 	, routing_table& table
 	, aux::listen_socket_handle const& sock
 	, socket_manager* sock_man
-	, dht_logger* log)
+	, dht_logger* log
+	, counters& cnt)
 	: m_pool_allocator(sizeof(observer_storage), 10)
 	, m_sock(sock)
 	, m_sock_man(sock_man)
@@ -172,6 +174,7 @@ rpc_manager::rpc_manager(node_id const& our_id
 #endif
 	, m_settings(settings)
 	, m_table(table)
+	, m_counters(cnt)
 	, m_our_id(our_id)
 	, m_allocated_observers(0)
 	, m_destructing(false)
@@ -298,6 +301,8 @@ bool rpc_manager::incoming(msg const& m, node_id* id)
 	}
 
 	time_point const now = clock_type::now();
+	m_counters.add_latency_sample(counters::dht_rpc_latency
+		, total_microseconds(now - o->sent()));
 
 #ifndef TORRENT_DISABLE_LOGGING
 	if (m_log->should_log(dht_logger::rpc_manager))
@@ -120,6 +120,113 @@ namespace libtorrent {
 		m_xor_mask = hasher(req3).update(buffer).final();
 	}
 
+	dh_thread_pool::dh_thread_pool(io_service& ios)
+		: m_ios(ios)
+		, m_pool(std::make_shared<keypair_pool>())
+	{}
+
+	dh_thread_pool::~dh_thread_pool()
+	{
+		abort();
+	}
+
+	void dh_thread_pool::set_num_threads(int const num_threads)
+	{
+		if (m_abort) return;
+		if (num_threads == int(m_threads.size())) return;
+
+		stop_threads();
+		if (num_threads <= 0) return;
+
+		m_job_ios.reset(new boost::asio::io_service);
+		m_work.reset(new boost::asio::io_service::work(*m_job_ios));
+		boost::asio::io_service* job_ios = m_job_ios.get();
+		for (int i = 0; i < num_threads; ++i)
+			m_threads.emplace_back([job_ios] { job_ios->run(); });
+		fill_pool();
+	}
+
+	void dh_thread_pool::set_pool_size(int const pool_size)
+	{
+		m_pool_size = std::max(pool_size, 0);
+		if (int(m_pool->keys.size()) > m_pool_size)
+			m_pool->keys.resize(std::size_t(m_pool_size));
+		fill_pool();
+	}
+
+	std::shared_ptr<dh_key_exchange> dh_thread_pool::get_keypair()
+	{
+		std::shared_ptr<dh_key_exchange> ret;
+		if (!m_pool->keys.empty())
+		{
+			ret = std::move(m_pool->keys.back());
+			m_pool->keys.pop_back();
+		}
+		else
+		{
+			ret = std::make_shared<dh_key_exchange>();
+		}
+		fill_pool();
+		return ret;
+	}
+
+	void dh_thread_pool::async_compute_secret(std::shared_ptr<dh_key_exchange> kx
+		, std::array<char, 96> const& remote_key, std::function<void()> handler)
+	{
+		TORRENT_ASSERT(kx);
+		TORRENT_ASSERT(!m_threads.empty());
+
+		io_service& ios = m_ios;
+		std::atomic<bool>& abort = m_abort;
+		m_job_ios->post([&ios, &abort, kx, remote_key, handler]
+		{
+			if (abort) return;
+			kx->compute_secret(reinterpret_cast<std::uint8_t const*>(remote_key.data()));
+			ios.post(handler);
+		});
+	}
+
+	void dh_thread_pool::abort()
+	{
+		m_abort = true;
+		stop_threads();
+	}
+
+	void dh_thread_pool::fill_pool()
+	{
+		if (m_threads.empty()) return;
+
+		io_service& ios = m_ios;
+		std::atomic<bool>& abort = m_abort;
+		std::weak_ptr<keypair_pool> pool = m_pool;
+		while (int(m_pool->keys.size()) + m_pool->outstanding < m_pool_size)
+		{
+			++m_pool->outstanding;
+			m_job_ios->post([&ios, &abort, pool]
+			{
+				if (abort) return;
+				auto kx = std::make_shared<dh_key_exchange>();
+				ios.post([pool, kx]
+				{
+					std::shared_ptr<keypair_pool> p = pool.lock();
+					if (!p) return;
+					--p->outstanding;
+					p->keys.push_back(kx);
+				});
+			});
+		}
+	}
+
+	void dh_thread_pool::stop_threads()
+	{
+		// the threads exit once they have drained the job queue. When aborting,
+		// the remaining jobs return immediately
+		m_work.reset();
+		for (auto& t : m_threads) t.join();
+		m_threads.clear();
+		m_job_ios.reset();
+	}
+
 	std::tuple<int, span<span<char const>>>
 	encryption_handler::encrypt(
 		span<span<char>> iovec)
@@ -345,6 +452,162 @@ namespace libtorrent {
 		return std::make_tuple(0, bytes_processed, 0);
 	}
 
+namespace {
+
+	// the number of ChaCha20 blocks generated at a time. The blocks are
+	// computed side by side, one lane each, which lets the compiler keep them
+	// in SIMD registers
+	constexpr int chacha20_lanes = 4;
+	static_assert(chacha20_lanes * 64 == sizeof(chacha20::keystream)
+		, "the keystream buffer must hold one block per lane");
+
+	std::uint32_t rotl(std::uint32_t const v, int const n)
+	{
+		return (v << n) | (v >> (32 - n));
+	}
+
+	std::uint32_t load_le32(char const* p)
+	{
+		auto const* b = reinterpret_cast<std::uint8_t const*>(p);
+		return std::uint32_t(b[0]) | (std::uint32_t(b[1]) << 8)
+			| (std::uint32_t(b[2]) << 16) | (std::uint32_t(b[3]) << 24);
+	}
+
+	void chacha20_init(span<char const> key, chacha20& st)
+	{
+		TORRENT_ASSERT(key.size() == 32);
+
+		// "expand 32-byte k"
+		st.state[0] = 0x61707865;
+		st.state[1] = 0x3320646e;
+		st.state[2] = 0x79622d32;
+		st.state[3] = 0x6b206574;
+		for (std::size_t i = 0; i < 8; ++i)
+			st.state[4 + i] = load_le32(key.data() + i * 4);
+
+		// words 12 and 13 are a 64 bit block counter, 14 and 15 the nonce
+		for (std::size_t i = 12; i < 16; ++i) st.state[i] = 0;
+		st.used = int(st.keystream.size());
+	}
+
+	// fills in the keystream buffer with the next chacha20_lanes blocks
+	void chacha20_generate(chacha20& st)
+	{
+		std::uint32_t x[16][chacha20_lanes];
+		for (std::size_t i = 0; i < 16; ++i)
+			for (int l = 0; l < chacha20_lanes; ++l)
+				x[i][l] = st.state[i];
+		// the lanes don't carry into the high word of the counter. The counter
+		// is always a multiple of chacha20_lanes here, so they never need to
+		for (int l = 0; l < chacha20_lanes; ++l)
+			x[12][l] += std::uint32_t(l);
+
+		auto const quarter_round = [&x](int const a, int const b, int const c, int const d)
+		{
+			for (int l = 0; l < chacha20_lanes; ++l)
+			{
+				x[a][l] += x[b][l]; x[d][l] = rotl(x[d][l] ^ x[a][l], 16);
+				x[c][l] += x[d][l]; x[b][l] = rotl(x[b][l] ^ x[c][l], 12);
+				x[a][l] += x[b][l]; x[d][l] = rotl(x[d][l] ^ x[a][l], 8);
+				x[c][l] += x[d][l]; x[b][l] = rotl(x[b][l] ^ x[c][l], 7);
+			}
+		};
+
+		for (int round = 0; round < 10; ++round)
+		{
+			quarter_round(0, 4, 8, 12);
+			quarter_round(1, 5, 9, 13);
+			quarter_round(2, 6, 10, 14);
+			quarter_round(3, 7, 11, 15);
+			quarter_round(0, 5, 10, 15);
+			quarter_round(1, 6, 11, 12);
+			quarter_round(2, 7, 8, 13);
+			quarter_round(3, 4, 9, 14);
+		}
+
+		for (int l = 0; l < chacha20_lanes; ++l)
+		{
+			std::uint8_t* out = st.keystream.data() + l * 64;
+			for (std::size_t i = 0; i < 16; ++i)
+			{
+				std::uint32_t const v = x[i][l] + st.state[i]
+					+ (i == 12 ? std::uint32_t(l) : 0);
+				out[i * 4] = std::uint8_t(v);
+				out[i * 4 + 1] = std::uint8_t(v >> 8);
+				out[i * 4 + 2] = std::uint8_t(v >> 16);
+				out[i * 4 + 3] = std::uint8_t(v >> 24);
+			}
+		}
+
+		std::uint64_t const counter = (std::uint64_t(st.state[13]) << 32)
+			+ st.state[12] + chacha20_lanes;
+		st.state[12] = std::uint32_t(counter);
+		st.state[13] = std::uint32_t(counter >> 32);
+		st.used = 0;
+	}
+
+	void chacha20_crypt(span<char> buf, chacha20& st)
+	{
+		int const block_size = int(st.keystream.size());
+		while (!buf.empty())
+		{
+			if (st.used == block_size) chacha20_generate(st);
+			int const len = std::min(int(buf.size()), block_size - st.used);
+			std::uint8_t const* ks = st.keystream.data() + st.used;
+			auto* out = reinterpret_cast<std::uint8_t*>(buf.data());
+			for (int i = 0; i < len; ++i) out[i] ^= ks[i];
+			st.used += len;
+			buf = buf.subspan(len);
+		}
+	}
+} // anonymous namespace
+
+	chacha20_handler::chacha20_handler()
+		: m_encrypt(false)
+		, m_decrypt(false)
+	{}
+
+	void chacha20_handler::set_incoming_key(span<char const> key)
+	{
+		m_decrypt = true;
+		chacha20_init(key, m_incoming);
+	}
+
+	void chacha20_handler::set_outgoing_key(span<char const> key)
+	{
+		m_encrypt = true;
+		chacha20_init(key, m_outgoing);
+	}
+
+	std::tuple<int, span<span<char const>>>
+	chacha20_handler::encrypt(span<span<char>> bufs)
+	{
+		span<span<char const>> empty;
+		if (!m_encrypt) return std::make_tuple(0, empty);
+		if (bufs.empty()) return std::make_tuple(0, empty);
+
+		int bytes_processed = 0;
+		for (auto& buf : bufs)
+		{
+			bytes_processed += int(buf.size());
+			chacha20_crypt(buf, m_outgoing);
+		}
+		return std::make_tuple(bytes_processed, empty);
+	}
+
+	std::tuple<int, int, int> chacha20_handler::decrypt(span<span<char>> bufs)
+	{
+		if (!m_decrypt) return std::make_tuple(0, 0, 0);
+
+		int bytes_processed = 0;
+		for (auto& buf : bufs)
+		{
+			bytes_processed += int(buf.size());
+			chacha20_crypt(buf, m_incoming);
+		}
+		return std::make_tuple(0, bytes_processed, 0);
+	}
+
 // All this code is based on libTomCrypt (http://www.libtomcrypt.com/)
 // this library is public domain and has been specially
 // tailored for libtorrent by Arvid Norberg
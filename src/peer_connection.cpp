@@ -154,6 +154,9 @@ namespace libtorrent {
 		, m_have_all(false)
 		, m_peer_interested(false)
 		, m_need_interest_update(false)
+		, m_deferred_send(false)
+		, m_request_blocks_queued(false)
+		, m_receive_suspended(false)
 		, m_has_metadata(true)
 		, m_exceeded_limit(false)
 		, m_slow_start(true)
@@ -535,21 +538,14 @@ namespace libtorrent {
 		if (!t->is_upload_only())
 		{
 			t->need_picker();
-			piece_picker const& p = t->picker();
-			piece_index_t const end_piece(p.num_pieces());
-			for (piece_index_t j(0); j != end_piece; ++j)
+			piece_index_t const j = t->picker().first_wanted_piece(m_have_piece);
+			if (j != piece_index_t(-1))
 			{
-				if (m_have_piece[j]
-					&& t->piece_priority(j) > dont_download
-					&& !p.has_piece_passed(j))
-				{
-					interested = true;
+				interested = true;
 #ifndef TORRENT_DISABLE_LOGGING
-					peer_log(peer_log_alert::info, "UPDATE_INTEREST", "interesting, piece: %d"
-						, static_cast<int>(j));
+				peer_log(peer_log_alert::info, "UPDATE_INTEREST", "interesting, piece: %d"
+					, static_cast<int>(j));
 #endif
-					break;
-				}
 			}
 		}
 
@@ -821,15 +817,9 @@ namespace libtorrent {
 		{
 			TORRENT_ASSERT(m_have_piece.size() == t->torrent_file().num_pieces());
 			t->peer_has(m_have_piece, this);
-			bool interesting = false;
-			for (auto const i : m_have_piece.range())
-			{
-				if (!m_have_piece[i]) continue;
-				// if the peer has a piece and we don't, the peer is interesting
-				if (!t->have_piece(i)
-					&& t->picker().piece_priority(i) != dont_download)
-					interesting = true;
-			}
+			// if the peer has a piece and we don't, the peer is interesting
+			bool const interesting
+				= t->picker().first_wanted_piece(m_have_piece) != piece_index_t(-1);
 			if (interesting) t->peer_is_interesting(*this);
 			else send_not_interested();
 		}
@@ -1032,6 +1022,19 @@ namespace libtorrent {
 			return;
 		}
 
+		// when HAVE messages are batched, peers that already have the piece,
+		// or won't download anything from us, don't need to hear about it
+		if (m_settings.get_int(settings_pack::have_batch_interval) > 0
+			&& (has_piece(index) || m_upload_only))
+		{
+#ifndef TORRENT_DISABLE_LOGGING
+			peer_log(peer_log_alert::outgoing_message, "HAVE", "piece: %d SUPRESSED"
+				, static_cast<int>(index));
+#endif
+			m_counters.inc_stats_counter(counters::num_suppressed_have);
+			return;
+		}
+
 		if (disconnect_if_redundant()) return;
 
 #ifndef TORRENT_DISABLE_LOGGING
@@ -1183,7 +1186,7 @@ namespace libtorrent {
 		t->received_synack(ipv6);
 	}
 
-	typed_bitfield<piece_index_t> const& peer_connection::get_bitfield() const
+	aux::have_bitfield const& peer_connection::get_bitfield() const
 	{
 		TORRENT_ASSERT(is_single_thread());
 		return m_have_piece;
@@ -1406,8 +1409,10 @@ namespace libtorrent {
 	std::uint32_t peer_connection::peer_rank() const
 	{
 		TORRENT_ASSERT(is_single_thread());
-		return m_peer_info == nullptr ? 0
-			: m_peer_info->rank(m_ses.external_address(), m_ses.listen_port());
+		if (m_peer_info == nullptr) return 0;
+		if (m_peer_rank == 0)
+			m_peer_rank = m_peer_info->rank(m_ses.external_address(), m_ses.listen_port());
+		return m_peer_rank;
 	}
 
 	// message handlers
@@ -2117,6 +2122,19 @@ namespace libtorrent {
 
 		if (was_seed)
 			t->set_seed(m_peer_info, false);
+
+		// the HAVE message for this piece may have been suppressed, since the
+		// peer had it. Now it may want it from us
+		if (t->have_piece(index)
+			&& (m_settings.get_int(settings_pack::have_batch_interval) > 0
+				|| !m_settings.get_bool(settings_pack::send_redundant_have)))
+		{
+#ifndef TORRENT_DISABLE_LOGGING
+			peer_log(peer_log_alert::outgoing_message, "HAVE", "piece: %d"
+				, static_cast<int>(index));
+#endif
+			write_have(index);
+		}
 	}
 
 	// -----------------------------
@@ -2236,13 +2254,13 @@ namespace libtorrent {
 			return;
 		}
 
-		// let the torrent know which pieces the peer has if we're a seed, we
-		// don't keep track of piece availability
-		t->peer_has(bits, this);
-
 		m_have_piece = bits;
 		m_num_pieces = num_pieces;
 
+		// let the torrent know which pieces the peer has if we're a seed, we
+		// don't keep track of piece availability
+		t->peer_has(m_have_piece, this);
+
 		update_interest();
 	}
 
@@ -2722,9 +2740,19 @@ namespace libtorrent {
 	// -----------------------------
 
 	void peer_connection::incoming_piece(peer_request const& p, char const* data)
+	{
+		incoming_piece_impl(p, data, disk_buffer_holder(), false);
+	}
+
+	// ``buffer`` is set when the payload was received straight into a disk
+	// buffer, in which case ``data`` points into it. ``exceeded`` is whether
+	// allocating that buffer took the disk cache above its limit
+	void peer_connection::incoming_piece_impl(peer_request const& p, char const* data
+		, disk_buffer_holder buffer, bool exceeded)
 	{
 		TORRENT_ASSERT(is_single_thread());
 		INVARIANT_CHECK;
+		TORRENT_ASSERT(!buffer || buffer.data() == data);
 
 		std::shared_ptr<torrent> t = m_torrent.lock();
 		TORRENT_ASSERT(t);
@@ -2920,9 +2948,13 @@ namespace libtorrent {
 		if (t->is_deleted()) return;
 
 		auto conn = self();
-		bool const exceeded = m_disk_thread.async_write(t->storage(), p, data, self()
-			, [conn, p, t] (storage_error const& e)
-			{ conn->wrap(&peer_connection::on_disk_write_complete, e, p, t); });
+		std::function<void(storage_error const&)> handler
+			= [conn, p, t] (storage_error const& e)
+			{ conn->wrap(&peer_connection::on_disk_write_complete, e, p, t); };
+		if (buffer)
+			m_disk_thread.async_write(t->storage(), p, std::move(buffer), std::move(handler));
+		else
+			exceeded = m_disk_thread.async_write(t->storage(), p, data, self(), std::move(handler));
 
 		// every peer is entitled to have two disk blocks allocated at any given
 		// time, regardless of whether the cache size is exceeded or not. If this
@@ -2940,8 +2972,8 @@ namespace libtorrent {
 #endif
 		}
 
-		std::int64_t const write_queue_size = m_counters.inc_stats_counter(
-			counters::queued_write_bytes, p.length);
+		m_counters.inc_stats_counter(counters::queued_write_bytes, p.length);
+		std::int64_t const write_queue_size = m_counters[counters::queued_write_bytes];
 		m_outstanding_writing_bytes += p.length;
 
 		std::int64_t const max_queue_size = m_settings.get_int(
@@ -3049,8 +3081,9 @@ namespace libtorrent {
 
 		if (is_disconnecting()) return;
 
-		if (request_a_block(*t, *this))
-			m_counters.inc_stats_counter(counters::incoming_piece_picks);
+		// refilling the request queue is done for all peers that received a
+		// block in this round of the message loop at once
+		t->defer_request_blocks(this);
 		send_block_requests();
 	}
 
@@ -4561,7 +4594,7 @@ namespace libtorrent {
 			p.downloading_total = 0;
 		}
 
-		p.pieces = get_bitfield();
+		p.pieces = get_bitfield().to_bitfield();
 		p.last_request = now - m_last_request;
 		p.last_active = now - std::max(m_last_sent, m_last_receive);
 
@@ -5427,6 +5460,12 @@ namespace libtorrent {
 		{
 			t->add_suggest_piece(r.piece);
 		}
+
+		// disk jobs complete in batches. Don't send this block until all
+		// blocks of the batch have been queued, so they go out in a single
+		// writev, straight from the disk buffers, together with their
+		// message headers
+		defer_send();
 		write_piece(r, std::move(buffer));
 	}
 
@@ -5697,6 +5736,8 @@ namespace libtorrent {
 		m_socket_is_writing = true;
 #endif
 
+		m_coalesced_bytes = 0;
+
 		auto conn = self();
 		m_socket->async_write_some(vec, make_handler(
 				std::bind(&peer_connection::on_send_data, conn, _1, _2)
@@ -5706,6 +5747,174 @@ namespace libtorrent {
 		m_last_sent = aux::time_now();
 	}
 
+	void peer_connection::defer_send()
+	{
+		TORRENT_ASSERT(is_single_thread());
+
+		// if there already is an outstanding write (or the socket is corked
+		// already) everything we append will be coalesced into the next write
+		// anyway
+		if (m_channel_state[upload_channel] & peer_info::bw_network) return;
+
+		m_channel_state[upload_channel] |= peer_info::bw_network;
+		m_deferred_send = true;
+
+		// if do_deferred_send() is still posted from before an early flush by
+		// coalesce_send(), this won't post another one. That call will pick up
+		// this send instead
+		auto conn = self();
+		m_deferred_send_handler.post(m_ios, aux::make_handler([conn]
+			{ conn->wrap(&peer_connection::do_deferred_send); }
+			, m_deferred_send_storage, *this));
+	}
+
+	// when send_coalesce_bytes is set, messages sent through send_buffer() are
+	// not written to the socket right away. They are held back until the
+	// current batch of handlers has run, or until send_coalesce_bytes of them
+	// have accumulated, so that a burst of small messages (HAVE, REQUEST,
+	// CANCEL, extension messages) goes out in a single write
+	void peer_connection::coalesce_send(int const bytes)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		if (m_disconnecting) return;
+
+		int const limit = m_settings.get_int(settings_pack::send_coalesce_bytes);
+		m_coalesced_bytes += bytes;
+		if (limit > 0 && m_coalesced_bytes < limit)
+		{
+			defer_send();
+			return;
+		}
+
+		if (m_deferred_send)
+		{
+			// enough has accumulated, don't wait for the deferred send. The
+			// posted do_deferred_send() will find nothing left to do, unless
+			// defer_send() is called again before it runs
+			m_deferred_send = false;
+			m_channel_state[upload_channel] &= ~peer_info::bw_network;
+		}
+		setup_send();
+	}
+
+	void peer_connection::do_deferred_send()
+	{
+		TORRENT_ASSERT(is_single_thread());
+
+		// the deferred send may have been flushed early by coalesce_send()
+		if (!m_deferred_send) return;
+		TORRENT_ASSERT(m_channel_state[upload_channel] & peer_info::bw_network);
+		m_deferred_send = false;
+		m_channel_state[upload_channel] &= ~peer_info::bw_network;
+
+		if (m_disconnecting)
+		{
+			// we skipped clearing the send buffer in disconnect() since the
+			// socket looked busy. Release the disk buffers now
+			m_send_buffer.clear();
+			return;
+		}
+		setup_send();
+	}
+
+	void peer_connection::suspend_receive()
+	{
+		TORRENT_ASSERT(is_single_thread());
+#ifndef TORRENT_DISABLE_LOGGING
+		peer_log(peer_log_alert::info, "SUSPEND_RECEIVE", "");
+#endif
+		m_receive_suspended = true;
+	}
+
+	void peer_connection::resume_receive()
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(m_receive_suspended);
+		// since reading was suspended, there is no outstanding read into the
+		// receive buffer, and it's safe to compact it
+		TORRENT_ASSERT(!(m_channel_state[download_channel] & peer_info::bw_network));
+#ifndef TORRENT_DISABLE_LOGGING
+		peer_log(peer_log_alert::info, "RESUME_RECEIVE", "");
+#endif
+		m_receive_suspended = false;
+		if (m_disconnecting) return;
+
+		m_recv_buffer.normalize();
+		if (m_recv_buffer.max_receive() == 0)
+		{
+			m_recv_buffer.grow(m_settings.get_int(settings_pack::max_peer_recv_buffer_size));
+		}
+		setup_receive();
+	}
+
+	bool peer_connection::receive_piece_into_disk_buffer(peer_request const& r
+		, span<char const> const received)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(!m_recv_piece_buffer);
+		TORRENT_ASSERT(int(received.size()) < r.length);
+
+		// a disk buffer holds exactly one block
+		if (r.length <= 0 || r.length > default_block_size) return false;
+
+		// any bytes in the receive buffer that have not been handed to the
+		// protocol layer yet would be skipped by reading into the disk buffer
+		if (m_recv_buffer.bytes_pending() > 0) return false;
+
+		bool exceeded = false;
+		disk_buffer_holder buffer = m_disk_thread.allocate_disk_buffer(exceeded
+			, self(), "receive buffer");
+		if (!buffer) return false;
+
+		if (!received.empty())
+			std::memcpy(buffer.data(), received.data(), std::size_t(received.size()));
+
+		m_recv_piece_buffer = std::move(buffer);
+		m_recv_piece = r;
+		m_recv_piece_pos = int(received.size());
+		m_recv_piece_exceeded = exceeded;
+		return true;
+	}
+
+	piece_block_progress peer_connection::disk_buffer_piece_progress() const
+	{
+		TORRENT_ASSERT(m_recv_piece_buffer);
+		std::shared_ptr<torrent> t = m_torrent.lock();
+		if (!t) return {};
+
+		piece_block_progress p;
+		p.piece_index = m_recv_piece.piece;
+		p.block_index = m_recv_piece.start / t->block_size();
+		p.bytes_downloaded = m_recv_piece_pos;
+		p.full_block_bytes = m_recv_piece.length;
+		return p;
+	}
+
+	void peer_connection::incoming_piece_payload(int const bytes)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(m_recv_piece_buffer);
+		TORRENT_ASSERT(bytes <= m_recv_piece.length - m_recv_piece_pos);
+
+		received_bytes(bytes, 0);
+		if (m_torrent.expired())
+		{
+			disconnect(errors::torrent_removed, operation_t::bittorrent, failure);
+			return;
+		}
+		incoming_piece_fragment(bytes);
+		if (is_disconnecting()) return;
+
+		m_recv_piece_pos += bytes;
+		if (m_recv_piece_pos < m_recv_piece.length) return;
+
+		disk_buffer_holder buffer = std::move(m_recv_piece_buffer);
+		TORRENT_ASSERT(!m_recv_piece_buffer);
+		m_recv_piece_pos = 0;
+		char const* data = buffer.data();
+		incoming_piece_impl(m_recv_piece, data, std::move(buffer), m_recv_piece_exceeded);
+	}
+
 	void peer_connection::on_disk()
 	{
 		TORRENT_ASSERT(is_single_thread());
@@ -5733,8 +5942,12 @@ namespace libtorrent {
 			m_recv_buffer.reserve(100);
 		}
 
-		// we may want to request more quota at this point
-		int const buffer_size = m_recv_buffer.max_receive();
+		// we may want to request more quota at this point. While receiving the
+		// payload of a PIECE message into a disk buffer, read no further than
+		// the end of the payload
+		int const buffer_size = m_recv_piece_buffer
+			? m_recv_piece.length - m_recv_piece_pos
+			: m_recv_buffer.max_receive();
 		request_bandwidth(download_channel, buffer_size);
 
 		if (m_channel_state[download_channel] & peer_info::bw_network) return;
@@ -5773,12 +5986,14 @@ namespace libtorrent {
 
 		if (max_receive == 0) return;
 
-		span<char> const vec = m_recv_buffer.reserve(max_receive);
+		span<char> const vec = m_recv_piece_buffer
+			? span<char>(m_recv_piece_buffer.data() + m_recv_piece_pos, max_receive)
+			: m_recv_buffer.reserve(max_receive);
 		TORRENT_ASSERT(!(m_channel_state[download_channel] & peer_info::bw_network));
 		m_channel_state[download_channel] |= peer_info::bw_network;
 #ifndef TORRENT_DISABLE_LOGGING
 		peer_log(peer_log_alert::incoming, "ASYNC_READ"
-			, "max: %d bytes", max_receive);
+			, "max: %d bytes%s", max_receive, m_recv_piece_buffer ? " (disk buffer)" : "");
 #endif
 
 		ADD_OUTSTANDING_ASYNC("peer_connection::on_receive_data");
@@ -5802,8 +6017,9 @@ namespace libtorrent {
 	{
 		TORRENT_ASSERT(is_single_thread());
 
+		int const size = int(buf.size());
 		int const free_space = std::min(
-			m_send_buffer.space_in_last_buffer(), int(buf.size()));
+			m_send_buffer.space_in_last_buffer(), size);
 		if (free_space > 0)
 		{
 			char* dst = m_send_buffer.append(buf.first(free_space));
@@ -5814,13 +6030,15 @@ namespace libtorrent {
 			TORRENT_ASSERT(dst != nullptr);
 			buf = buf.subspan(free_space);
 		}
-		if (buf.empty()) return;
 
-		// allocate a buffer and initialize the beginning of it with 'buf'
-		buffer snd_buf(std::max(int(buf.size()), 128), buf);
-		m_send_buffer.append_buffer(std::move(snd_buf), int(buf.size()));
+		if (!buf.empty())
+		{
+			// allocate a buffer and initialize the beginning of it with 'buf'
+			buffer snd_buf(std::max(int(buf.size()), 128), buf);
+			m_send_buffer.append_buffer(std::move(snd_buf), int(buf.size()));
+		}
 
-		setup_send();
+		coalesce_send(size);
 	}
 
 	// --------------------------
@@ -5829,9 +6047,7 @@ namespace libtorrent {
 
 	void peer_connection::account_received_bytes(int const bytes_transferred)
 	{
-		// tell the receive buffer we just fed it this many bytes of incoming data
 		TORRENT_ASSERT(bytes_transferred > 0);
-		m_recv_buffer.received(bytes_transferred);
 
 		// update the dl quota
 		TORRENT_ASSERT(bytes_transferred <= m_quota[download_channel]);
@@ -5906,11 +6122,19 @@ namespace libtorrent {
 		// flush the send buffer at the end of this function
 		cork _c(*this);
 
+		// the bytes were read straight into the disk buffer of a PIECE message,
+		// they never enter the receive buffer
+		bool const disk_buffer = bool(m_recv_piece_buffer);
+
 		// if we received exactly as many bytes as we provided a receive buffer
 		// for. There most likely are more bytes to read, and we should grow our
 		// receive buffer.
-		TORRENT_ASSERT(int(bytes_transferred) <= m_recv_buffer.max_receive());
-		bool const grow_buffer = (int(bytes_transferred) == m_recv_buffer.max_receive());
+		TORRENT_ASSERT(disk_buffer || int(bytes_transferred) <= m_recv_buffer.max_receive());
+		bool const grow_buffer = !disk_buffer
+			&& int(bytes_transferred) == m_recv_buffer.max_receive();
+
+		// tell the receive buffer we just fed it this many bytes of incoming data
+		if (!disk_buffer) m_recv_buffer.received(int(bytes_transferred));
 		account_received_bytes(int(bytes_transferred));
 
 		if (m_extension_outstanding_bytes > 0)
@@ -5919,6 +6143,19 @@ namespace libtorrent {
 		check_graceful_pause();
 		if (m_disconnecting) return;
 
+		if (disk_buffer)
+		{
+			incoming_piece_payload(int(bytes_transferred));
+			if (m_disconnecting) return;
+
+			// allow reading from the socket again
+			TORRENT_ASSERT(m_channel_state[download_channel] & peer_info::bw_network);
+			m_channel_state[download_channel] &= ~peer_info::bw_network;
+
+			setup_receive();
+			return;
+		}
+
 		// this is the case where we try to grow the receive buffer and try to
 		// drain the socket
 		if (grow_buffer)
@@ -5969,6 +6206,7 @@ namespace libtorrent {
 				}
 				else
 				{
+					m_recv_buffer.received(int(bytes));
 					account_received_bytes(int(bytes));
 					bytes_transferred += bytes;
 				}
@@ -6045,6 +6283,8 @@ namespace libtorrent {
 
 		if (!bw_limit) return false;
 
+		if (m_receive_suspended) return false;
+
 		if (m_outstanding_bytes > 0)
 		{
 			// if we're expecting to download piece data, we might not
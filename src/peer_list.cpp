@@ -31,6 +31,7 @@ POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <functional>
+#include <array>
 
 #include "libtorrent/peer_connection.hpp"
 #include "libtorrent/web_peer_connection.hpp"
@@ -174,8 +175,9 @@ namespace libtorrent {
 	void peer_list::clear_peer_prio()
 	{
 		INVARIANT_CHECK;
-		for (auto& p : m_peers)
-			p->peer_rank = 0;
+		// the candidates were ordered by their rank relative to our old
+		// external address
+		m_candidate_cache.clear();
 	}
 
 	// disconnects and removes all peers that are now filtered
@@ -456,6 +458,10 @@ namespace libtorrent {
 		const int candidate_count = 10;
 		peers.reserve(candidate_count);
 
+		// the best candidates found so far, best first
+		std::array<candidate_key, candidate_count> candidates;
+		int num_candidates = 0;
+
 		int erase_candidate = -1;
 
 		if (bool(m_finished) != state->is_finished)
@@ -514,23 +520,30 @@ namespace libtorrent {
 				(int(pe.failcount) + 1) * state->min_reconnect_time)
 				continue;
 
+			candidate_key const key = make_candidate_key(&pe);
+
 			// compare peer returns true if lhs is better than rhs. In this
 			// case, it returns true if the current candidate is better than
 			// pe, which is the peer m_round_robin points to. If it is, just
 			// keep looking.
-			if (peers.size() == candidate_count
-				&& compare_peer(peers.back(), &pe, external, external_port)) continue;
-
-			if (peers.size() >= candidate_count)
-				peers.resize(candidate_count - 1);
+			if (num_candidates == candidate_count
+				&& compare_peer(candidates[candidate_count - 1], key, external, external_port))
+				continue;
 
-			// insert this candidate sorted into peers
-			auto const i = std::lower_bound(peers.begin(), peers.end()
-				, &pe, std::bind(&peer_list::compare_peer, this, _1, _2, std::cref(external), external_port));
+			if (num_candidates == candidate_count) --num_candidates;
 
-			peers.insert(i, &pe);
+			// insert this candidate sorted into candidates
+			auto const end = candidates.begin() + num_candidates;
+			auto const i = std::lower_bound(candidates.begin(), end, key
+				, std::bind(&peer_list::compare_peer, this, _1, _2, std::cref(external), external_port));
+			std::move_backward(i, end, end + 1);
+			*i = key;
+			++num_candidates;
 		}
 
+		for (int i = 0; i < num_candidates; ++i)
+			peers.push_back(candidates[i].peer);
+
 		if (erase_candidate > -1)
 		{
 			erase_peer(m_peers.begin() + erase_candidate, state);
@@ -1295,29 +1308,38 @@ namespace libtorrent {
 		return lhs.trust_points < rhs.trust_points;
 	}
 
+	peer_list::candidate_key peer_list::make_candidate_key(torrent_peer* p) const
+	{
+		candidate_key ret;
+		ret.peer = p;
+		ret.rank = 0;
+		ret.last_connected = p->last_connected;
+		ret.failcount = static_cast<std::uint8_t>(p->failcount);
+		ret.source_rank = static_cast<std::uint8_t>(source_rank(p->peer_source()));
+		ret.local = is_local(p->address());
+		return ret;
+	}
+
 	// this returns true if lhs is a better connect candidate than rhs
-	bool peer_list::compare_peer(torrent_peer const* lhs, torrent_peer const* rhs
+	bool peer_list::compare_peer(candidate_key const& lhs, candidate_key const& rhs
 		, external_ip const& external, int external_port) const
 	{
 		TORRENT_ASSERT(is_single_thread());
 		// prefer peers with lower failcount
-		if (lhs->failcount != rhs->failcount)
-			return lhs->failcount < rhs->failcount;
+		if (lhs.failcount != rhs.failcount)
+			return lhs.failcount < rhs.failcount;
 
 		// Local peers should always be tried first
-		bool const lhs_local = is_local(lhs->address());
-		bool const rhs_local = is_local(rhs->address());
-		if (lhs_local != rhs_local) return int(lhs_local) > int(rhs_local);
+		if (lhs.local != rhs.local) return int(lhs.local) > int(rhs.local);
 
-		if (lhs->last_connected != rhs->last_connected)
-			return lhs->last_connected < rhs->last_connected;
+		if (lhs.last_connected != rhs.last_connected)
+			return lhs.last_connected < rhs.last_connected;
 
-		int const lhs_rank = source_rank(lhs->peer_source());
-		int const rhs_rank = source_rank(rhs->peer_source());
-		if (lhs_rank != rhs_rank) return lhs_rank > rhs_rank;
+		if (lhs.source_rank != rhs.source_rank)
+			return lhs.source_rank > rhs.source_rank;
 
-		std::uint32_t const lhs_peer_rank = lhs->rank(external, external_port);
-		std::uint32_t const rhs_peer_rank = rhs->rank(external, external_port);
-		return lhs_peer_rank > rhs_peer_rank;
+		if (lhs.rank == 0) lhs.rank = lhs.peer->rank(external, external_port);
+		if (rhs.rank == 0) rhs.rank = rhs.peer->rank(external, external_port);
+		return lhs.rank > rhs.rank;
 	}
 }
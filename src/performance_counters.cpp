@@ -32,15 +32,31 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/performance_counters.hpp"
 #include "libtorrent/assert.hpp"
+#include "libtorrent/aux_/ffs.hpp" // for log2p1
 #include <cstring> // for memset
 
 namespace libtorrent {
 
+#ifdef ATOMIC_LLONG_LOCK_FREE
+	constexpr int counters::num_shards;
+
+	int counters::thread_shard()
+	{
+		static std::atomic<int> next_shard{0};
+		thread_local int const shard
+			= next_shard.fetch_add(1, std::memory_order_relaxed) % num_shards;
+		return shard;
+	}
+#endif
+
+	constexpr int counters::num_latency_buckets;
+
 	counters::counters() TORRENT_COUNTER_NOEXCEPT
 	{
 #ifdef ATOMIC_LLONG_LOCK_FREE
-		for (auto& counter : m_stats_counter)
-			counter.store(0, std::memory_order_relaxed);
+		for (auto& s : m_shards)
+			for (auto& counter : s.values)
+				counter.store(0, std::memory_order_relaxed);
 #else
 		m_stats_counter.fill(0);
 #endif
@@ -49,10 +65,12 @@ namespace libtorrent {
 	counters::counters(counters const& c) TORRENT_COUNTER_NOEXCEPT
 	{
 #ifdef ATOMIC_LLONG_LOCK_FREE
-		for (int i = 0; i < m_stats_counter.end_index(); ++i)
-			m_stats_counter[i].store(
-				c.m_stats_counter[i].load(std::memory_order_relaxed)
-					, std::memory_order_relaxed);
+		// the copy collects all counts in the first shard
+		for (int i = 0; i < num_counters; ++i)
+			m_shards[0].values[i].store(c[i], std::memory_order_relaxed);
+		for (int s = 1; s < num_shards; ++s)
+			for (auto& counter : m_shards[s].values)
+				counter.store(0, std::memory_order_relaxed);
 #else
 		std::lock_guard<std::mutex> l(c.m_mutex);
 		m_stats_counter = c.m_stats_counter;
@@ -63,10 +81,11 @@ namespace libtorrent {
 	{
 		if (&c == this) return *this;
 #ifdef ATOMIC_LLONG_LOCK_FREE
-		for (int i = 0; i < m_stats_counter.end_index(); ++i)
-			m_stats_counter[i].store(
-				c.m_stats_counter[i].load(std::memory_order_relaxed)
-					, std::memory_order_relaxed);
+		for (int i = 0; i < num_counters; ++i)
+			m_shards[0].values[i].store(c[i], std::memory_order_relaxed);
+		for (int s = 1; s < num_shards; ++s)
+			for (auto& counter : m_shards[s].values)
+				counter.store(0, std::memory_order_relaxed);
 #else
 		std::lock_guard<std::mutex> l(m_mutex);
 		std::lock_guard<std::mutex> l2(c.m_mutex);
@@ -81,7 +100,10 @@ namespace libtorrent {
 		TORRENT_ASSERT(i < num_counters);
 
 #ifdef ATOMIC_LLONG_LOCK_FREE
-		return m_stats_counter[i].load(std::memory_order_relaxed);
+		std::int64_t ret = 0;
+		for (auto const& s : m_shards)
+			ret += s.values[i].load(std::memory_order_relaxed);
+		return ret;
 #else
 		std::lock_guard<std::mutex> l(m_mutex);
 		return m_stats_counter[i];
@@ -90,7 +112,7 @@ namespace libtorrent {
 
 	// the argument specifies which counter to
 	// increment or decrement
-	std::int64_t counters::inc_stats_counter(int const c, std::int64_t const value) TORRENT_COUNTER_NOEXCEPT
+	void counters::inc_stats_counter(int const c, std::int64_t const value) TORRENT_COUNTER_NOEXCEPT
 	{
 		// if c >= num_stats_counters, it means it's not
 		// a monotonically increasing counter, but a gauge
@@ -100,13 +122,15 @@ namespace libtorrent {
 		TORRENT_ASSERT(c < num_counters);
 
 #ifdef ATOMIC_LLONG_LOCK_FREE
-		std::int64_t pv = m_stats_counter[c].fetch_add(value, std::memory_order_relaxed);
-		TORRENT_ASSERT(pv + value >= 0);
-		return pv + value;
+		// a gauge may be incremented by one thread and decremented by another,
+		// so an individual shard may go negative. Since the shards aren't read
+		// atomically, a sum taken while other threads update them may too,
+		// which is why there's no assert on the result here
+		m_shards[thread_shard()].values[c].fetch_add(value, std::memory_order_relaxed);
 #else
 		std::lock_guard<std::mutex> l(m_mutex);
 		TORRENT_ASSERT(m_stats_counter[c] + value >= 0);
-		return m_stats_counter[c] += value;
+		m_stats_counter[c] += value;
 #endif
 	}
 
@@ -120,14 +144,12 @@ namespace libtorrent {
 		TORRENT_ASSERT(ratio <= 100);
 
 #ifdef ATOMIC_LLONG_LOCK_FREE
-		std::int64_t current = m_stats_counter[c].load(std::memory_order_relaxed);
-		std::int64_t new_value = (current * (100 - ratio) + value * ratio) / 100;
-
-		while (!m_stats_counter[c].compare_exchange_weak(current, new_value
-			, std::memory_order_relaxed))
-		{
-			new_value = (current * (100 - ratio) + value * ratio) / 100;
-		}
+		// blended gauges are only updated from a single thread, so the value
+		// won't change between reading and adjusting it
+		std::int64_t const current = (*this)[c];
+		std::int64_t const new_value = (current * (100 - ratio) + value * ratio) / 100;
+		m_shards[thread_shard()].values[c].fetch_add(new_value - current
+			, std::memory_order_relaxed);
 #else
 		std::lock_guard<std::mutex> l(m_mutex);
 		std::int64_t current = m_stats_counter[c];
@@ -135,13 +157,37 @@ namespace libtorrent {
 #endif
 	}
 
+	int counters::latency_bucket(std::int64_t const microseconds)
+	{
+		if (microseconds < 128) return 0;
+		if (microseconds >= (1 << 20)) return num_latency_buckets - 1;
+		auto const v = std::uint32_t(microseconds);
+		int const octave = aux::log2p1(v);
+		// the bit below the most significant one picks the lower or upper
+		// half of the octave
+		int const half = (v >> (octave - 1)) & 1;
+		return 1 + (octave - 7) * 2 + half;
+	}
+
+	void counters::add_latency_sample(int const histogram, std::int64_t const microseconds) TORRENT_COUNTER_NOEXCEPT
+	{
+		TORRENT_ASSERT(histogram >= disk_queue_latency);
+		TORRENT_ASSERT(histogram <= on_tick_latency);
+		TORRENT_ASSERT((histogram - disk_queue_latency) % num_latency_buckets == 0);
+		inc_stats_counter(histogram + latency_bucket(microseconds));
+	}
+
 	void counters::set_value(int const c, std::int64_t const value) TORRENT_COUNTER_NOEXCEPT
 	{
 		TORRENT_ASSERT(c >= 0);
 		TORRENT_ASSERT(c < num_counters);
 
 #ifdef ATOMIC_LLONG_LOCK_FREE
-		m_stats_counter[c].store(value);
+		// other shards may be updated concurrently, so rather than storing the
+		// value, adjust this thread's shard to make the sum come out right.
+		// An increment racing with this is counted as if it happened after it
+		std::int64_t const current = (*this)[c];
+		m_shards[thread_shard()].values[c].fetch_add(value - current);
 #else
 		std::lock_guard<std::mutex> l(m_mutex);
 
@@ -40,6 +40,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/piece_picker.hpp"
 #include "libtorrent/bitfield.hpp"
+#include "libtorrent/aux_/have_bitfield.hpp"
 #include "libtorrent/random.hpp"
 #include "libtorrent/aux_/alloca.hpp"
 #include "libtorrent/aux_/range.hpp"
@@ -187,6 +188,14 @@ namespace libtorrent {
 #endif
 		}
 
+		m_all_pieces.resize(total_num_pieces, true);
+
+		// nothing has passed anymore, only the filtered pieces remain
+		m_passed_or_filtered.resize(total_num_pieces);
+		m_passed_or_filtered.clear_all();
+		for (auto const i : m_piece_map.range())
+			if (m_piece_map[i].filtered()) m_passed_or_filtered.set_bit(i);
+
 		for (auto i = m_piece_map.begin() + static_cast<int>(m_cursor)
 			, end(m_piece_map.end()); i != end && (i->have() || i->filtered());
 			++i, ++m_cursor);
@@ -434,7 +443,7 @@ namespace libtorrent {
 #endif // TORRENT_USE_INVARIANT_CHECKS
 
 #if TORRENT_USE_INVARIANT_CHECKS
-	void piece_picker::check_peer_invariant(typed_bitfield<piece_index_t> const& have
+	void piece_picker::check_peer_invariant(aux::have_bitfield const& have
 		, torrent_peer const* p) const
 	{
 #ifdef TORRENT_DEBUG_REFCOUNTS
@@ -465,6 +474,7 @@ namespace libtorrent {
 		TORRENT_ASSERT(m_have_filtered_pad_blocks >= 0);
 		TORRENT_ASSERT(m_have_filtered_pad_blocks + m_filtered_pad_blocks <= num_pad_blocks());
 		TORRENT_ASSERT(m_have_filtered_pad_blocks <= m_have_pad_blocks);
+		TORRENT_ASSERT(m_passed_or_filtered.size() == num_pieces());
 
 		// make sure the priority boundaries are monotonically increasing. The
 		// difference between two cursors cannot be negative, but ranges are
@@ -625,6 +635,9 @@ namespace libtorrent {
 #ifdef TORRENT_DEBUG_REFCOUNTS
 			TORRENT_ASSERT(int(p.have_peers.size()) == p.peer_count + m_seeds);
 #endif
+			TORRENT_ASSERT(m_passed_or_filtered[piece]
+				== (p.filtered() || has_piece_passed(piece)));
+
 			if (p.index == piece_pos::we_have_index)
 			{
 				++num_have;
@@ -1086,6 +1099,42 @@ namespace libtorrent {
 #endif
 	}
 
+	void piece_picker::inc_refcount(aux::have_bitfield const& pieces
+		, const torrent_peer* peer)
+	{
+		switch (pieces.form())
+		{
+			case aux::have_bitfield::form_t::all:
+				inc_refcount_all(peer);
+				break;
+			case aux::have_bitfield::form_t::dense:
+				inc_refcount(pieces.dense_bits(), peer);
+				break;
+			case aux::have_bitfield::form_t::sparse:
+				for (piece_index_t const p : pieces.sparse_pieces())
+					inc_refcount(p, peer);
+				break;
+		}
+	}
+
+	void piece_picker::dec_refcount(aux::have_bitfield const& pieces
+		, const torrent_peer* peer)
+	{
+		switch (pieces.form())
+		{
+			case aux::have_bitfield::form_t::all:
+				dec_refcount_all(peer);
+				break;
+			case aux::have_bitfield::form_t::dense:
+				dec_refcount(pieces.dense_bits(), peer);
+				break;
+			case aux::have_bitfield::form_t::sparse:
+				for (piece_index_t const p : pieces.sparse_pieces())
+					dec_refcount(p, peer);
+				break;
+		}
+	}
+
 	void piece_picker::inc_refcount_all(const torrent_peer* peer)
 	{
 #ifdef TORRENT_EXPENSIVE_INVARIANT_CHECKS
@@ -1280,18 +1329,19 @@ namespace libtorrent {
 			// and mark the picker as dirty, so we'll rebuild it next time we need it.
 			// this only matters if we're not already dirty, in which case the fasted
 			// thing to do is to just update the counters and be done
-			piece_index_t index = piece_index_t(0);
-			int num_inc = 0;
-			for (auto i = bitmask.begin(), end(bitmask.end()); i != end; ++i, ++index)
-			{
-				if (!*i) continue;
-				if (num_inc < size) incremented[num_inc] = index;
-				++num_inc;
-				if (num_inc >= size) break;
-			}
+			int const num_inc = bitmask.count();
 
 			if (num_inc < size)
 			{
+				piece_index_t index = piece_index_t(0);
+				int found = 0;
+				for (auto i = bitmask.begin(), end(bitmask.end());
+					found < num_inc && i != end; ++i, ++index)
+				{
+					if (*i) incremented[found++] = index;
+				}
+				TORRENT_ASSERT(found == num_inc);
+
 				// not that many pieces were updated
 				// just update those individually instead of
 				// rebuilding the whole piece list
@@ -1376,18 +1426,19 @@ namespace libtorrent {
 			// and mark the picker as dirty, so we'll rebuild it next time we need it.
 			// this only matters if we're not already dirty, in which case the fasted
 			// thing to do is to just update the counters and be done
-			piece_index_t index = piece_index_t(0);
-			int num_dec = 0;
-			for (auto i = bitmask.begin(), end(bitmask.end()); i != end; ++i, ++index)
-			{
-				if (!*i) continue;
-				if (num_dec < size) decremented[num_dec] = index;
-				++num_dec;
-				if (num_dec >= size) break;
-			}
+			int const num_dec = bitmask.count();
 
 			if (num_dec < size)
 			{
+				piece_index_t index = piece_index_t(0);
+				int found = 0;
+				for (auto i = bitmask.begin(), end(bitmask.end());
+					found < num_dec && i != end; ++i, ++index)
+				{
+					if (*i) decremented[found++] = index;
+				}
+				TORRENT_ASSERT(found == num_dec);
+
 				// not that many pieces were updated
 				// just update those individually instead of
 				// rebuilding the whole piece list
@@ -1556,6 +1607,7 @@ namespace libtorrent {
 		TORRENT_ASSERT(!i->passed_hash_check);
 		i->passed_hash_check = true;
 		++m_num_passed;
+		m_passed_or_filtered.set_bit(index);
 
 		if (i->finished < blocks_in_piece(index)) return;
 
@@ -1585,6 +1637,7 @@ namespace libtorrent {
 				i->passed_hash_check = false;
 				TORRENT_ASSERT(m_num_passed > 0);
 				--m_num_passed;
+				if (!p.filtered()) m_passed_or_filtered.clear_bit(index);
 			}
 			erase_download_piece(i);
 			return;
@@ -1592,6 +1645,7 @@ namespace libtorrent {
 
 		TORRENT_ASSERT(m_num_passed > 0);
 		--m_num_passed;
+		if (!p.filtered()) m_passed_or_filtered.clear_bit(index);
 		if (p.filtered())
 		{
 			m_filtered_pad_blocks += pad_blocks_in_piece(index);
@@ -1666,6 +1720,7 @@ namespace libtorrent {
 		}
 		++m_num_have;
 		++m_num_passed;
+		m_passed_or_filtered.set_bit(index);
 		m_have_pad_blocks += pad_blocks_in_piece(index);
 		TORRENT_ASSERT(m_have_pad_blocks <= num_pad_blocks());
 		p.set_have();
@@ -1724,6 +1779,7 @@ namespace libtorrent {
 		m_reverse_cursor = piece_index_t{0};
 		m_num_passed = num_pieces();
 		m_num_have = num_pieces();
+		m_passed_or_filtered.set_all();
 
 		for (auto& queue : m_downloads) queue.clear();
 		for (auto& p : m_piece_map)
@@ -1793,6 +1849,7 @@ namespace libtorrent {
 						--m_reverse_cursor;
 				}
 			}
+			m_passed_or_filtered.set_bit(index);
 			ret = true;
 		}
 		else if (new_piece_priority != dont_download
@@ -1821,6 +1878,7 @@ namespace libtorrent {
 					m_cursor = m_piece_map.end_index();
 				}
 			}
+			if (!has_piece_passed(index)) m_passed_or_filtered.clear_bit(index);
 			ret = true;
 		}
 		TORRENT_ASSERT(m_num_filtered >= 0);
@@ -1925,6 +1983,36 @@ namespace {
 	// the return value is a combination of picker_flags_t,
 	// indicating which path thought the picker we took to arrive at the
 	// returned block picks.
+	picker_flags_t piece_picker::pick_pieces(aux::have_bitfield const& pieces
+		, std::vector<piece_block>& interesting_blocks, int const num_blocks
+		, int const prefer_contiguous_blocks, torrent_peer* peer
+		, picker_options_t const options, std::vector<piece_index_t> const& suggested_pieces
+		, int const num_peers
+		, counters& pc
+		) const
+	{
+		// the sparse form is expanded into this. It's reused across calls to
+		// avoid allocating a bitfield of every piece each time
+		thread_local typed_bitfield<piece_index_t> storage;
+
+		typed_bitfield<piece_index_t> const* bits = &m_all_pieces;
+		switch (pieces.form())
+		{
+			case aux::have_bitfield::form_t::all:
+				TORRENT_ASSERT(pieces.size() == m_all_pieces.size());
+				break;
+			case aux::have_bitfield::form_t::dense:
+				bits = &pieces.dense_bits();
+				break;
+			case aux::have_bitfield::form_t::sparse:
+				bits = &pieces.bitfield(storage);
+				break;
+		}
+		return pick_pieces(*bits, interesting_blocks, num_blocks
+			, prefer_contiguous_blocks, peer, options, suggested_pieces
+			, num_peers, pc);
+	}
+
 	picker_flags_t piece_picker::pick_pieces(typed_bitfield<piece_index_t> const& pieces
 		, std::vector<piece_block>& interesting_blocks, int num_blocks
 		, int prefer_contiguous_blocks, torrent_peer* peer
@@ -1972,8 +2060,12 @@ namespace {
 
 		// this will be filled with blocks that we should not request
 		// unless we can't find num_blocks among the other ones.
-		std::vector<piece_block> backup_blocks;
-		std::vector<piece_block> backup_blocks2;
+		// these are scratch buffers, kept around between calls to avoid
+		// allocating them every time a peer needs more requests
+		thread_local std::vector<piece_block> backup_blocks;
+		thread_local std::vector<piece_block> backup_blocks2;
+		backup_blocks.clear();
+		backup_blocks2.clear();
 		static const std::vector<piece_index_t> empty_vector;
 
 		// When prefer_contiguous_blocks is set (usually set when downloading from
@@ -2878,6 +2970,22 @@ get_out:
 		return true;
 	}
 
+	piece_index_t piece_picker::first_wanted_piece(aux::have_bitfield const& pieces) const
+	{
+		switch (pieces.form())
+		{
+			case aux::have_bitfield::form_t::all:
+				return piece_index_t(m_passed_or_filtered.find_first_clear());
+			case aux::have_bitfield::form_t::dense:
+				return first_wanted_piece(pieces.dense_bits());
+			case aux::have_bitfield::form_t::sparse:
+				for (piece_index_t const p : pieces.sparse_pieces())
+					if (!m_passed_or_filtered[p]) return p;
+				break;
+		}
+		return piece_index_t(-1);
+	}
+
 	bool piece_picker::has_piece_passed(piece_index_t const index) const
 	{
 		TORRENT_ASSERT(index < m_piece_map.end_index());
@@ -3398,6 +3506,8 @@ get_out:
 			i->passed_hash_check = false;
 			TORRENT_ASSERT(m_num_passed > 0);
 			--m_num_passed;
+			if (!m_piece_map[piece].filtered())
+				m_passed_or_filtered.clear_bit(piece);
 		}
 
 		// prevent this piece from being picked until it's restored
@@ -3450,6 +3560,8 @@ get_out:
 			i->passed_hash_check = false;
 			TORRENT_ASSERT(m_num_passed > 0);
 			--m_num_passed;
+			if (!m_piece_map[block.piece_index].filtered())
+				m_passed_or_filtered.clear_bit(block.piece_index);
 		}
 
 		// prevent this hash job from actually completing
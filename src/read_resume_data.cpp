@@ -369,6 +369,9 @@ namespace {
 
 	add_torrent_params read_resume_data(span<char const> buffer, error_code& ec)
 	{
+		if (aux::is_binary_resume_data(buffer))
+			return read_resume_data_binary(buffer, ec);
+
 		bdecode_node rd = bdecode(buffer, ec);
 		if (ec) return add_torrent_params();
 
@@ -385,6 +388,9 @@ namespace {
 
 	add_torrent_params read_resume_data(span<char const> buffer)
 	{
+		if (aux::is_binary_resume_data(buffer))
+			return read_resume_data_binary(buffer);
+
 		error_code ec;
 		bdecode_node rd = bdecode(buffer, ec);
 		if (ec) throw system_error(ec);
@@ -93,6 +93,14 @@ int receive_buffer::advance_pos(int const bytes)
 	return sub_transferred;
 }
 
+void receive_buffer::rewind(int const bytes)
+{
+	INVARIANT_CHECK;
+	TORRENT_ASSERT(bytes >= 0);
+	TORRENT_ASSERT(bytes <= m_recv_pos);
+	m_recv_pos -= bytes;
+}
+
 // size = the packet size to remove from the receive buffer
 // packet_size = the next packet size to receive in the buffer
 // offset = the offset into the receive buffer where to remove `size` bytes
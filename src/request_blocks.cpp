@@ -107,7 +107,12 @@ namespace libtorrent {
 		t.need_picker();
 
 		piece_picker& p = t.picker();
-		std::vector<piece_block> interesting_pieces;
+
+		// this is invoked for every peer whose request queue needs refilling.
+		// Reuse the same buffer across calls rather than allocating a new one
+		// every time
+		thread_local std::vector<piece_block> interesting_pieces;
+		interesting_pieces.clear();
 		interesting_pieces.reserve(100);
 
 		int prefer_contiguous_blocks = c.prefer_contiguous_blocks();
@@ -151,36 +156,46 @@ namespace libtorrent {
 		std::vector<pending_block> const& rq = c.request_queue();
 
 		std::vector<piece_index_t> const& suggested = c.suggested_pieces();
-		auto const* bits = &c.get_bitfield();
-		typed_bitfield<piece_index_t> fast_mask;
+		aux::have_bitfield const& have = c.get_bitfield();
 
+		// picks the interesting pieces from this peer
+		// the integer is the number of pieces that
+		// should be guaranteed to be available for download
+		// (if num_requests is too big, too many pieces are
+		// picked and cpu-time is wasted)
+		// the last argument is if we should prefer whole pieces
+		// for this peer. If we're downloading one piece in 20 seconds
+		// then use this mode.
+		picker_flags_t flags;
 		if (c.has_peer_choked())
 		{
 			// if we are choked we can only pick pieces from the
 			// allowed fast set. The allowed fast set is sorted
 			// in ascending priority order
 
-			// build a bitmask with only the allowed pieces in it
-			fast_mask.resize(c.get_bitfield().size(), false);
+			// build a bitmask with only the allowed pieces in it. Like
+			// interesting_pieces, it's reused across calls to avoid allocating
+			// a bitfield of every piece for each of them
+			thread_local typed_bitfield<piece_index_t> mask;
+			mask.resize(have.size());
+			mask.clear_all();
 			for (auto const& i : c.allowed_fast())
 			{
-				if ((*bits)[i]) fast_mask.set_bit(i);
+				if (have[i]) mask.set_bit(i);
 			}
-			bits = &fast_mask;
+			flags = p.pick_pieces(mask, interesting_pieces
+				, num_requests, prefer_contiguous_blocks, c.peer_info_struct()
+				, c.picker_options(), suggested, t.num_peers()
+				, ses.stats_counters());
+		}
+		else
+		{
+			// the peer's pieces are passed in the form they're stored in
+			flags = p.pick_pieces(have, interesting_pieces
+				, num_requests, prefer_contiguous_blocks, c.peer_info_struct()
+				, c.picker_options(), suggested, t.num_peers()
+				, ses.stats_counters());
 		}
-
-		// picks the interesting pieces from this peer
-		// the integer is the number of pieces that
-		// should be guaranteed to be available for download
-		// (if num_requests is too big, too many pieces are
-		// picked and cpu-time is wasted)
-		// the last argument is if we should prefer whole pieces
-		// for this peer. If we're downloading one piece in 20 seconds
-		// then use this mode.
-		picker_flags_t const flags = p.pick_pieces(*bits, interesting_pieces
-			, num_requests, prefer_contiguous_blocks, c.peer_info_struct()
-			, c.picker_options(), suggested, t.num_peers()
-			, ses.stats_counters());
 
 #ifndef TORRENT_DISABLE_LOGGING
 		if (t.alerts().should_post<picker_log_alert>()
@@ -425,6 +425,35 @@ namespace {
 		guard.disarm();
 	}
 
+	void session_handle::async_add_torrents(std::vector<add_torrent_params> params)
+	{
+		for (auto& p : params)
+		{
+			TORRENT_ASSERT_PRECOND(!p.save_path.empty());
+			p.save_path = complete(p.save_path);
+
+#if TORRENT_ABI_VERSION == 1
+			handle_backwards_compatible_resume_data(p);
+#endif
+		}
+
+		auto* v = new std::vector<add_torrent_params>(std::move(params));
+		auto guard = aux::scope_end([v]{ delete v; });
+		async_call(&session_impl::async_add_torrents, v);
+		guard.disarm();
+	}
+
+	void session_handle::async_load_torrents(std::vector<std::vector<char>> resume_data
+		, std::string const& save_path)
+	{
+		TORRENT_ASSERT_PRECOND(!save_path.empty());
+
+		auto* v = new std::vector<std::vector<char>>(std::move(resume_data));
+		auto guard = aux::scope_end([v]{ delete v; });
+		async_call(&session_impl::async_load_torrents, v, complete(save_path));
+		guard.disarm();
+	}
+
 #ifndef BOOST_NO_EXCEPTIONS
 #if TORRENT_ABI_VERSION == 1
 	// if the torrent already exists, this will throw duplicate_torrent
@@ -824,6 +853,8 @@ namespace {
 	void session_handle::set_ip_filter(ip_filter const& f)
 	{
 		std::shared_ptr<ip_filter> copy = std::make_shared<ip_filter>(f);
+		// build the lookup structure here, rather than on the network thread
+		copy->compile();
 		async_call(&session_impl::set_ip_filter, copy);
 	}
 
@@ -988,7 +1019,7 @@ namespace {
 				<= settings_pack::pe_disabled);
 		TORRENT_ASSERT_PRECOND(!s.has_val(settings_pack::allowed_enc_level)
 			|| s.get_int(settings_pack::allowed_enc_level)
-				<= settings_pack::pe_both);
+				<= settings_pack::pe_all);
 
 		auto copy = std::make_shared<settings_pack>(s);
 		async_call(&session_impl::apply_settings_pack, copy);
@@ -1004,7 +1035,7 @@ namespace {
 				<= settings_pack::pe_disabled);
 		TORRENT_ASSERT_PRECOND(!s.has_val(settings_pack::allowed_enc_level)
 			|| s.get_int(settings_pack::allowed_enc_level)
-				<= settings_pack::pe_both);
+				<= settings_pack::pe_all);
 
 		auto copy = std::make_shared<settings_pack>(std::move(s));
 		async_call(&session_impl::apply_settings_pack, copy);
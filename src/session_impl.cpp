@@ -78,6 +78,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/instantiate_connection.hpp"
 #include "libtorrent/peer_info.hpp"
 #include "libtorrent/random.hpp"
+#include "libtorrent/read_resume_data.hpp"
 #include "libtorrent/magnet_uri.hpp"
 #include "libtorrent/aux_/session_settings.hpp"
 #include "libtorrent/torrent_peer.hpp"
@@ -969,6 +970,23 @@ namespace aux {
 			p->disconnect(errors::stopping_torrent, operation_t::bittorrent);
 		}
 
+#if !defined TORRENT_DISABLE_ENCRYPTION
+		// handshakes waiting for a DH secret are being disconnected, there's
+		// no point in finishing those
+		m_dh_threads.abort();
+#endif
+
+		// the torrent load threads refer back to this object. Batches that
+		// haven't been started are dropped, the ones being prepared are
+		// finished and their handlers ignore them (see on_torrent_load_batch())
+		for (auto& t : m_torrent_load_threads) t->ios.stop();
+		m_torrent_load_threads.clear();
+		if (m_ip_filter_thread)
+		{
+			m_ip_filter_thread->ios.stop();
+			m_ip_filter_thread.reset();
+		}
+
 		// close the listen sockets
 		for (auto const& l : m_listen_sockets)
 		{
@@ -1059,9 +1077,51 @@ namespace aux {
 	{
 		TORRENT_ASSERT(is_single_thread());
 		if (!m_ip_filter) m_ip_filter = std::make_shared<ip_filter>();
+		// if the filter is compiled, this rule is kept on the side rather
+		// than recompiling the whole filter here
 		m_ip_filter->add_rule(addr, addr, ip_filter::blocked);
 		for (auto& i : m_torrents)
 			i.second->set_ip_filter(m_ip_filter);
+
+		if (m_compiling_ip_filter)
+		{
+			m_bans_while_compiling.push_back(addr);
+			return;
+		}
+
+		if (m_abort || !m_ip_filter->should_compile()) return;
+
+		// the rules on the side are piling up. Compile a copy of the filter
+		// on another thread, before the compiled form is discarded
+		if (!m_ip_filter_thread) m_ip_filter_thread.reset(new work_thread_t());
+		m_compiling_ip_filter = true;
+		std::shared_ptr<ip_filter> orig = m_ip_filter;
+		auto copy = std::make_shared<ip_filter>(*m_ip_filter);
+		m_ip_filter_thread->ios.post([this, orig, copy]
+		{
+			copy->compile();
+			m_io_service.post([this, orig, copy]
+			{ this->wrap(&session_impl::on_ip_filter_compiled, orig, copy); });
+		});
+	}
+
+	void session_impl::on_ip_filter_compiled(std::shared_ptr<ip_filter> const& orig
+		, std::shared_ptr<ip_filter> const& compiled)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		m_compiling_ip_filter = false;
+		std::vector<address> bans;
+		bans.swap(m_bans_while_compiling);
+
+		// if set_ip_filter() replaced the filter in the meantime, the copy is
+		// out of date
+		if (m_abort || m_ip_filter != orig) return;
+
+		for (auto const& a : bans)
+			compiled->add_rule(a, a, ip_filter::blocked);
+		m_ip_filter = compiled;
+		for (auto& i : m_torrents)
+			i.second->set_ip_filter(m_ip_filter);
 	}
 
 	ip_filter const& session_impl::get_ip_filter()
@@ -3161,6 +3221,13 @@ namespace {
 		COMPLETE_ASYNC("session_impl::on_tick");
 		m_stats_counters.inc_stats_counter(counters::on_tick_counter);
 
+		time_point const tick_start = clock_type::now();
+		auto const record_tick_time = aux::scope_end([this, tick_start]
+		{
+			m_stats_counters.add_latency_sample(counters::on_tick_latency
+				, total_microseconds(clock_type::now() - tick_start));
+		});
+
 		TORRENT_ASSERT(is_single_thread());
 
 		// submit all disk jobs when we leave this function
@@ -3246,6 +3313,14 @@ namespace {
 		// only tick the following once per second
 		if (now - m_last_second_tick < seconds(1)) return;
 
+		// sampling the gauges includes asking the disk thread for its
+		// counters, don't do that more often than we have to
+		if (m_stats_page.is_open())
+		{
+			update_stats_gauges();
+			m_stats_page.update(m_stats_counters);
+		}
+
 #ifndef TORRENT_DISABLE_DHT
 		if (m_dht
 			&& m_dht_interval_update_torrents < 40
@@ -4661,6 +4736,15 @@ namespace {
 			m_posted_stats_header = true;
 			m_alerts.emplace_alert<session_stats_header_alert>();
 		}
+		update_stats_gauges();
+
+		m_alerts.emplace_alert<session_stats_alert>(m_stats_counters);
+	}
+
+	// refresh the counters that are sampled rather than incremented as events
+	// happen
+	void session_impl::update_stats_gauges()
+	{
 		m_disk_thread.update_stats_counters(m_stats_counters);
 
 #ifndef TORRENT_DISABLE_DHT
@@ -4684,8 +4768,7 @@ namespace {
 		m_stats_counters.set_value(counters::limiter_down_bytes
 			, m_download_rate.queued_bytes());
 
-		m_alerts.emplace_alert<session_stats_alert>(m_stats_counters);
-
+		m_stats_counters.set_value(counters::alerts_dropped, m_alerts.num_dropped());
 	}
 
 	void session_impl::post_dht_stats()
@@ -4718,6 +4801,58 @@ namespace {
 		return torrent_handle(find_torrent(info_hash));
 	}
 
+namespace {
+
+	// the number of torrents in each batch added by async_add_torrents() and
+	// async_load_torrents(). Each batch is added to the session by a single
+	// handler on the network thread
+	constexpr std::size_t torrent_load_batch_size = 64;
+
+	// validates add_torrent_params and, for the deprecated URL fields, loads
+	// the torrent. This does not depend on the state of the session, so it
+	// may run on a torrent load thread.
+	void prepare_add_torrent_params(add_torrent_params& params, error_code& ec)
+	{
+#if TORRENT_ABI_VERSION == 1
+		if (string_begins_no_case("magnet:", params.url.c_str()))
+		{
+			parse_magnet_uri(params.url, params, ec);
+			if (ec) return;
+			params.url.clear();
+		}
+
+		if (!params.ti && string_begins_no_case("file://", params.url.c_str()))
+		{
+			std::string const torrent_file_path = resolve_file_url(params.url);
+			params.url.clear();
+			auto t = std::make_shared<torrent_info>(torrent_file_path, std::ref(ec), 0);
+			if (ec) return;
+			params.ti = t;
+		}
+#endif
+
+		if (params.ti && !params.ti->is_valid())
+		{
+			ec = errors::no_metadata;
+			return;
+		}
+
+		if (params.ti && params.ti->is_valid() && params.ti->num_files() == 0)
+		{
+			ec = errors::no_files_in_torrent;
+			return;
+		}
+
+		if (params.ti
+			&& !params.info_hash.is_all_zeros()
+			&& params.info_hash != params.ti->info_hash())
+		{
+			ec = errors::mismatching_info_hash;
+			return;
+		}
+	}
+}
+
 	void session_impl::async_add_torrent(add_torrent_params* params)
 	{
 		std::unique_ptr<add_torrent_params> holder(params);
@@ -4749,6 +4884,124 @@ namespace {
 		add_torrent(std::move(*params), ec);
 	}
 
+	void session_impl::async_add_torrents(std::vector<add_torrent_params>* params)
+	{
+		std::unique_ptr<std::vector<add_torrent_params>> holder(params);
+
+		auto job = std::make_shared<torrent_load_job>();
+		for (std::size_t i = 0; i < params->size(); i += torrent_load_batch_size)
+		{
+			auto const end = params->begin() + std::ptrdiff_t(
+				std::min(i + torrent_load_batch_size, params->size()));
+			job->batches.emplace_back();
+			auto& b = job->batches.back();
+			b.params.assign(std::make_move_iterator(params->begin() + std::ptrdiff_t(i))
+				, std::make_move_iterator(end));
+		}
+		start_torrent_load_job(std::move(job));
+	}
+
+	void session_impl::async_load_torrents(std::vector<std::vector<char>>* resume_data
+		, std::string const& save_path)
+	{
+		std::unique_ptr<std::vector<std::vector<char>>> holder(resume_data);
+
+		auto job = std::make_shared<torrent_load_job>();
+		job->save_path = save_path;
+		for (std::size_t i = 0; i < resume_data->size(); i += torrent_load_batch_size)
+		{
+			auto const end = resume_data->begin() + std::ptrdiff_t(
+				std::min(i + torrent_load_batch_size, resume_data->size()));
+			job->batches.emplace_back();
+			auto& b = job->batches.back();
+			b.resume_data.assign(std::make_move_iterator(resume_data->begin() + std::ptrdiff_t(i))
+				, std::make_move_iterator(end));
+		}
+		start_torrent_load_job(std::move(job));
+	}
+
+	void session_impl::start_torrent_load_job(std::shared_ptr<torrent_load_job> job)
+	{
+		// the torrent load threads have been stopped
+		if (m_abort) return;
+
+		// the number of threads is checked for every job. If it has been
+		// lowered, the threads past it are left idle
+		std::size_t const num_threads = std::size_t(std::max(1
+			, m_settings.get_int(settings_pack::torrent_load_threads)));
+		while (m_torrent_load_threads.size() < num_threads)
+			m_torrent_load_threads.emplace_back(new work_thread_t());
+
+		for (std::size_t i = 0; i < job->batches.size(); ++i)
+		{
+			m_next_torrent_load_thread %= num_threads;
+			auto& t = *m_torrent_load_threads[m_next_torrent_load_thread];
+			++m_next_torrent_load_thread;
+
+			// the network thread does not touch a batch until the handler below
+			// marks it as ready, so the worker has exclusive access to it
+			torrent_load_batch* b = &job->batches[i];
+			t.ios.post([this, job, b, i]
+			{
+				if (!b->resume_data.empty())
+				{
+					b->params.resize(b->resume_data.size());
+					b->errors.resize(b->resume_data.size());
+					for (std::size_t k = 0; k < b->resume_data.size(); ++k)
+					{
+						error_code& ec = b->errors[k];
+						b->params[k] = read_resume_data(b->resume_data[k], ec);
+						if (ec) continue;
+						if (b->params[k].save_path.empty())
+							b->params[k].save_path = job->save_path;
+					}
+					b->resume_data.clear();
+					b->resume_data.shrink_to_fit();
+				}
+				b->errors.resize(b->params.size());
+
+				for (std::size_t k = 0; k < b->params.size(); ++k)
+				{
+					if (b->errors[k]) continue;
+					prepare_add_torrent_params(b->params[k], b->errors[k]);
+				}
+
+				m_io_service.post([this, job, i]
+				{ this->wrap(&session_impl::on_torrent_load_batch, job, i); });
+			});
+		}
+	}
+
+	void session_impl::on_torrent_load_batch(std::shared_ptr<torrent_load_job> job
+		, std::size_t const batch)
+	{
+		// the torrents can't be added to a session that's shutting down
+		if (m_abort) return;
+
+		job->batches[batch].ready = true;
+
+		// batches may complete out of order, but torrents are added in the order
+		// they were passed in
+		while (job->next < job->batches.size() && job->batches[job->next].ready)
+		{
+			torrent_load_batch& b = job->batches[job->next];
+			for (std::size_t i = 0; i < b.params.size(); ++i)
+			{
+				error_code ec = b.errors[i];
+				if (ec)
+				{
+					m_alerts.emplace_alert<add_torrent_alert>(torrent_handle()
+						, b.params[i], ec);
+					continue;
+				}
+				add_torrent(std::move(b.params[i]), ec);
+			}
+			b = torrent_load_batch();
+			b.ready = true;
+			++job->next;
+		}
+	}
+
 #if TORRENT_ABI_VERSION == 1
 	void session_impl::on_async_load_torrent(add_torrent_params* params, error_code ec)
 	{
@@ -4888,43 +5141,8 @@ namespace {
 
 		using ptr_t = std::shared_ptr<torrent>;
 
-#if TORRENT_ABI_VERSION == 1
-		if (string_begins_no_case("magnet:", params.url.c_str()))
-		{
-			parse_magnet_uri(params.url, params, ec);
-			if (ec) return std::make_pair(ptr_t(), false);
-			params.url.clear();
-		}
-
-		if (!params.ti && string_begins_no_case("file://", params.url.c_str()))
-		{
-			std::string const torrent_file_path = resolve_file_url(params.url);
-			params.url.clear();
-			auto t = std::make_shared<torrent_info>(torrent_file_path, std::ref(ec), 0);
-			if (ec) return std::make_pair(ptr_t(), false);
-			params.ti = t;
-		}
-#endif
-
-		if (params.ti && !params.ti->is_valid())
-		{
-			ec = errors::no_metadata;
-			return std::make_pair(ptr_t(), false);
-		}
-
-		if (params.ti && params.ti->is_valid() && params.ti->num_files() == 0)
-		{
-			ec = errors::no_files_in_torrent;
-			return std::make_pair(ptr_t(), false);
-		}
-
-		if (params.ti
-			&& !params.info_hash.is_all_zeros()
-			&& params.info_hash != params.ti->info_hash())
-		{
-			ec = errors::mismatching_info_hash;
-			return std::make_pair(ptr_t(), false);
-		}
+		prepare_add_torrent_params(params, ec);
+		if (ec) return std::make_pair(ptr_t(), false);
 
 #ifndef TORRENT_DISABLE_DHT
 		// add params.dht_nodes to the DHT, if enabled
@@ -6508,6 +6726,14 @@ namespace {
 #endif
 	}
 
+	void session_impl::update_dh_threads()
+	{
+#if !defined TORRENT_DISABLE_ENCRYPTION
+		m_dh_threads.set_pool_size(m_settings.get_int(settings_pack::dh_keypair_pool_size));
+		m_dh_threads.set_num_threads(m_settings.get_int(settings_pack::dh_threads));
+#endif
+	}
+
 	void session_impl::update_report_web_seed_downloads()
 	{
 		// if this flag changed, update all web seed connections
@@ -6731,6 +6957,27 @@ namespace {
 #endif
 	}
 
+	void session_impl::update_stats_page()
+	{
+		std::string const& path = m_settings.get_str(settings_pack::stats_page_path);
+		if (path.empty())
+		{
+			m_stats_page.close();
+			return;
+		}
+
+		error_code ec;
+		m_stats_page.open(path, ec);
+		if (ec)
+		{
+			if (m_alerts.should_post<session_error_alert>())
+				m_alerts.emplace_alert<session_error_alert>(ec, "failed to open stats page");
+			return;
+		}
+		update_stats_gauges();
+		m_stats_page.update(m_stats_counters);
+	}
+
 	void session_impl::pop_alerts(std::vector<alert*>* alerts)
 	{
 		m_alerts.get_all(*alerts);
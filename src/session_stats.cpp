@@ -53,6 +53,40 @@ namespace {
 	};
 
 #define METRIC(category, name) { #category "." #name, counters:: name },
+#define LATENCY_BUCKET(category, name, n) { #category "." #name "_" #n, counters:: name + n },
+#define LATENCY_HISTOGRAM(category, name) \
+		LATENCY_BUCKET(category, name, 0) \
+		LATENCY_BUCKET(category, name, 1) \
+		LATENCY_BUCKET(category, name, 2) \
+		LATENCY_BUCKET(category, name, 3) \
+		LATENCY_BUCKET(category, name, 4) \
+		LATENCY_BUCKET(category, name, 5) \
+		LATENCY_BUCKET(category, name, 6) \
+		LATENCY_BUCKET(category, name, 7) \
+		LATENCY_BUCKET(category, name, 8) \
+		LATENCY_BUCKET(category, name, 9) \
+		LATENCY_BUCKET(category, name, 10) \
+		LATENCY_BUCKET(category, name, 11) \
+		LATENCY_BUCKET(category, name, 12) \
+		LATENCY_BUCKET(category, name, 13) \
+		LATENCY_BUCKET(category, name, 14) \
+		LATENCY_BUCKET(category, name, 15) \
+		LATENCY_BUCKET(category, name, 16) \
+		LATENCY_BUCKET(category, name, 17) \
+		LATENCY_BUCKET(category, name, 18) \
+		LATENCY_BUCKET(category, name, 19) \
+		LATENCY_BUCKET(category, name, 20) \
+		LATENCY_BUCKET(category, name, 21) \
+		LATENCY_BUCKET(category, name, 22) \
+		LATENCY_BUCKET(category, name, 23) \
+		LATENCY_BUCKET(category, name, 24) \
+		LATENCY_BUCKET(category, name, 25) \
+		LATENCY_BUCKET(category, name, 26) \
+		LATENCY_BUCKET(category, name, 27)
+
+	static_assert(counters::num_latency_buckets == 28
+		, "LATENCY_HISTOGRAM needs to be updated to match num_latency_buckets");
+
 	aux::array<stats_metric_impl, counters::num_counters> const metrics
 	({{
 		// ``error_peers`` is the total number of peer disconnects
@@ -243,6 +277,10 @@ namespace {
 		METRIC(ses, num_have_pieces)
 		METRIC(ses, num_total_pieces_added)
 
+		// the number of alerts that were dropped because the alert queue was
+		// full. The alerts_dropped_alert tells which types were dropped
+		METRIC(ses, alerts_dropped)
+
 #if TORRENT_ABI_VERSION == 1
 		// this counts the number of times a torrent has been
 		// evicted (only applies when dynamic-loading-of-torrent-files
@@ -299,6 +337,7 @@ namespace {
 		METRIC(ses, num_outgoing_pex)
 		METRIC(ses, num_outgoing_metadata)
 		METRIC(ses, num_outgoing_extended)
+		METRIC(ses, num_suppressed_have)
 
 		// the number of wasted downloaded bytes by reason of the bytes being
 		// wasted.
@@ -510,6 +549,12 @@ namespace {
 		METRIC(utp, utp_invalid_pkts_in)
 		METRIC(utp, utp_redundant_pkts_in)
 
+		// the number of sockets compared against incoming uTP packets when
+		// looking up the socket they belong to. Packets matching the socket
+		// of the previous packet are not counted. Relative to utp_packets_in
+		// this is the average cost of demultiplexing a packet
+		METRIC(utp, utp_demux_probes)
+
 		// the number of uTP sockets in each respective state
 		METRIC(utp, num_utp_idle)
 		METRIC(utp, num_utp_syn_sent)
@@ -564,6 +609,29 @@ namespace {
 		METRIC(sock_bufs, socket_recv_size19)
 		METRIC(sock_bufs, socket_recv_size20)
 
+		// latency histograms, in microseconds. Each histogram has a counter
+		// per bucket, with the bucket number appended to the name. Bucket 0
+		// counts samples below 128 us and bucket 27 samples of 2^20 us (about
+		// 1 s) or more. The buckets in between split every power of two in
+		// two, i.e. bucket 1 is [128, 192), bucket 2 is [192, 256), bucket 3
+		// is [256, 384) and so on.
+
+		// the time disk jobs are queued before a disk thread picks them up
+		LATENCY_HISTOGRAM(disk, disk_queue_latency)
+
+		// the time it takes to execute disk jobs, by type. Jobs other than
+		// read, write and hash are counted in disk_other_latency
+		LATENCY_HISTOGRAM(disk, disk_read_latency)
+		LATENCY_HISTOGRAM(disk, disk_write_latency)
+		LATENCY_HISTOGRAM(disk, disk_hash_latency)
+		LATENCY_HISTOGRAM(disk, disk_other_latency)
+
+		// the round-trip time of DHT requests that were answered
+		LATENCY_HISTOGRAM(dht, dht_rpc_latency)
+
+		// the time the session's periodic tick takes
+		LATENCY_HISTOGRAM(net, on_tick_latency)
+
 		// if the outstanding tracker announce limit is reached, tracker
 		// announces are queued, to be issued when an announce slot opens up.
 		// this measure the number of tracker announces currently in the
@@ -572,6 +640,8 @@ namespace {
 		// ... more
 	}});
 #undef METRIC
+#undef LATENCY_HISTOGRAM
+#undef LATENCY_BUCKET
 	} // anonymous namespace
 
 	std::vector<stats_metric> session_stats_metrics()
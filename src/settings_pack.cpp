@@ -125,7 +125,8 @@ constexpr int CLOSE_FILE_INTERVAL = 0;
 		SET(proxy_password, "", &session_impl::update_proxy),
 		SET(i2p_hostname, "", &session_impl::update_i2p_bridge),
 		SET(peer_fingerprint, "-LT12A0-", nullptr),
-		SET(dht_bootstrap_nodes, "dht.libtorrent.org:25401", &session_impl::update_dht_bootstrap_nodes)
+		SET(dht_bootstrap_nodes, "dht.libtorrent.org:25401", &session_impl::update_dht_bootstrap_nodes),
+		SET(stats_page_path, "", &session_impl::update_stats_page)
 	}});
 
 	aux::array<bool_setting_entry_t, settings_pack::num_bool_settings> const bool_settings
@@ -211,6 +212,8 @@ constexpr int CLOSE_FILE_INTERVAL = 0;
 		SET(dht_prefer_verified_node_ids, true, &session_impl::update_dht_settings),
 		SET(piece_extent_affinity, false, nullptr),
 		SET(validate_https_trackers, false, &session_impl::update_validate_https),
+		SET(utp_pacing, false, nullptr),
+		SET(utp_sack_scoreboard, true, nullptr),
 	}});
 
 	aux::array<int_setting_entry_t, settings_pack::num_int_settings> const int_settings
@@ -353,6 +356,12 @@ constexpr int CLOSE_FILE_INTERVAL = 0;
 		SET(rate_choker_initial_threshold, 1024, nullptr),
 		SET(upnp_lease_duration, 3600, nullptr),
 		SET(max_concurrent_http_announces, 50, nullptr),
+		SET(utp_congestion_control, settings_pack::utp_ledbat, nullptr),
+		SET(torrent_load_threads, 4, nullptr),
+		SET(dh_threads, 1, &session_impl::update_dh_threads),
+		SET(dh_keypair_pool_size, 16, &session_impl::update_dh_threads),
+		SET(send_coalesce_bytes, 0, nullptr),
+		SET(have_batch_interval, 0, nullptr),
 	}});
 
 #undef SET
@@ -0,0 +1,203 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/aux_/stats_page.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/session_stats.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring> // for memcpy, strlen
+#include <new>
+
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+#include <boost/crc.hpp>
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+
+#if TORRENT_HAVE_MMAP
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+#endif
+
+namespace libtorrent { namespace aux {
+
+	constexpr std::uint32_t stats_page::magic;
+	constexpr std::uint32_t stats_page::version;
+	constexpr int stats_page::header_size;
+
+namespace {
+
+	struct page_header
+	{
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::atomic<std::uint64_t> sequence;
+		std::uint32_t num_counters;
+		std::uint32_t layout;
+	};
+
+	static_assert(sizeof(page_header) == stats_page::header_size
+		, "the stats page header layout is part of its interface");
+}
+
+	stats_page::~stats_page() { close(); }
+
+	std::uint32_t stats_page::layout()
+	{
+		static std::uint32_t const ret = []
+		{
+			std::vector<stats_metric> metrics = session_stats_metrics();
+			std::sort(metrics.begin(), metrics.end()
+				, [](stats_metric const& lhs, stats_metric const& rhs)
+				{ return lhs.value_index < rhs.value_index; });
+
+			// include the terminator, to separate the names
+			boost::crc_32_type crc;
+			for (auto const& m : metrics)
+				crc.process_bytes(m.name, std::strlen(m.name) + 1);
+			return std::uint32_t(crc.checksum());
+		}();
+		return ret;
+	}
+
+	void stats_page::open(std::string const& path, error_code& ec)
+	{
+		close();
+
+#if TORRENT_HAVE_MMAP
+		std::size_t const size = std::size_t(header_size)
+			+ std::size_t(counters::num_counters) * sizeof(std::int64_t);
+
+		int const fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+		{
+			ec.assign(errno, system_category());
+			return;
+		}
+
+		if (::ftruncate(fd, off_t(size)) != 0)
+		{
+			ec.assign(errno, system_category());
+			::close(fd);
+			return;
+		}
+
+		void* const page = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		int const err = errno;
+		// the mapping keeps the file alive
+		::close(fd);
+		if (page == MAP_FAILED)
+		{
+			ec.assign(err, system_category());
+			return;
+		}
+
+		m_page = page;
+		m_size = size;
+
+		// the file was just truncated, so all counters are 0
+		auto* hdr = new (m_page) page_header;
+		hdr->sequence.store(0, std::memory_order_relaxed);
+		hdr->num_counters = std::uint32_t(counters::num_counters);
+		hdr->layout = layout();
+		hdr->version = version;
+		std::atomic_thread_fence(std::memory_order_release);
+		hdr->magic = magic;
+#else
+		TORRENT_UNUSED(path);
+		ec = boost::asio::error::operation_not_supported;
+#endif
+	}
+
+	void stats_page::close()
+	{
+		if (m_page == nullptr) return;
+#if TORRENT_HAVE_MMAP
+		::munmap(m_page, m_size);
+#endif
+		m_page = nullptr;
+		m_size = 0;
+	}
+
+	void stats_page::update(counters const& c)
+	{
+		if (m_page == nullptr) return;
+
+		auto* hdr = static_cast<page_header*>(m_page);
+		auto* values = reinterpret_cast<std::int64_t*>(static_cast<char*>(m_page) + header_size);
+
+		// there is a single writer, the session's network thread
+		std::uint64_t const seq = hdr->sequence.load(std::memory_order_relaxed);
+		hdr->sequence.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (int i = 0; i < counters::num_counters; ++i)
+			values[i] = c[i];
+
+		hdr->sequence.store(seq + 2, std::memory_order_release);
+	}
+
+	bool stats_page::read(span<char const> page, std::vector<std::int64_t>& out)
+	{
+		if (page.size() < header_size) return false;
+
+		auto const* hdr = reinterpret_cast<page_header const*>(page.data());
+		if (hdr->magic != magic || hdr->version != version) return false;
+		if (hdr->layout != layout()) return false;
+
+		std::size_t const num = hdr->num_counters;
+		if (std::size_t(page.size()) < header_size + num * sizeof(std::int64_t))
+			return false;
+
+		out.resize(num);
+		char const* values = page.data() + header_size;
+
+		for (int attempt = 0; attempt < 100; ++attempt)
+		{
+			std::uint64_t const before = hdr->sequence.load(std::memory_order_acquire);
+			// the writer is in the middle of an update
+			if (before & 1) continue;
+
+			std::memcpy(out.data(), values, num * sizeof(std::int64_t));
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			if (hdr->sequence.load(std::memory_order_relaxed) == before) return true;
+		}
+		return false;
+	}
+}}
@@ -3952,8 +3952,23 @@ bool is_downloading_state(int const st)
 			// a request for it, and not sending it because
 			// we were waiting to receive the piece, now that
 			// we have received it, try to send stuff (fill_send_buffer)
-			if (announce_piece) p->announce_piece(index);
-			else p->fill_send_buffer();
+			if (!announce_piece) p->fill_send_buffer();
+		}
+
+		// the HAVE messages are sent once all pieces passing in this round
+		// have been queued up. If they are batched, second_tick() sends them
+		if (announce_piece && !m_connections.empty())
+		{
+			m_pending_haves.push_back(index);
+			if (settings().get_int(settings_pack::have_batch_interval) == 0)
+			{
+				std::weak_ptr<torrent> weak_t = shared_from_this();
+				m_deferred_have.post(m_ses.get_io_service(), aux::make_handler([=]()
+				{
+					std::shared_ptr<torrent> t = weak_t.lock();
+					if (t) t->wrap(&torrent::broadcast_haves);
+				}, m_deferred_have_handler_storage, *this));
+			}
 		}
 
 #ifndef TORRENT_DISABLE_EXTENSIONS
@@ -4389,7 +4404,7 @@ bool is_downloading_state(int const st)
 	}
 
 	// when we get a bitfield message, this is called for that piece
-	void torrent::peer_has(typed_bitfield<piece_index_t> const& bits
+	void torrent::peer_has(aux::have_bitfield const& bits
 		, peer_connection const* peer)
 	{
 		if (has_picker())
@@ -4417,7 +4432,7 @@ bool is_downloading_state(int const st)
 		}
 	}
 
-	void torrent::peer_lost(typed_bitfield<piece_index_t> const& bits
+	void torrent::peer_lost(aux::have_bitfield const& bits
 		, peer_connection const* peer)
 	{
 		if (has_picker())
@@ -4569,7 +4584,7 @@ bool is_downloading_state(int const st)
 
 	// TODO: 3 this should return optional<>. piece index -1 should not be
 	// allowed
-	piece_index_t torrent::get_piece_to_super_seed(typed_bitfield<piece_index_t> const& bits)
+	piece_index_t torrent::get_piece_to_super_seed(aux::have_bitfield const& bits)
 	{
 		// return a piece with low availability that is not in
 		// the bitfield and that is not currently being super
@@ -5764,6 +5779,72 @@ bool is_downloading_state(int const st)
 		update_want_tick();
 	}
 
+	void torrent::defer_request_blocks(peer_connection* p)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(p->associated_torrent().lock().get() == this);
+
+		// all blocks this peer received in this round are covered by a single
+		// pick
+		if (p->request_blocks_queued()) return;
+		p->request_blocks_queued(true);
+
+		m_peers_to_request.push_back(p->self());
+		std::weak_ptr<torrent> weak_t = shared_from_this();
+		m_deferred_request.post(m_ses.get_io_service(), aux::make_handler([=]()
+		{
+			std::shared_ptr<torrent> t = weak_t.lock();
+			if (t) t->wrap(&torrent::request_deferred_blocks);
+		}, m_deferred_request_handler_storage, *this));
+	}
+
+	void torrent::request_deferred_blocks()
+	{
+		TORRENT_ASSERT(is_single_thread());
+
+		std::vector<std::weak_ptr<peer_connection>> peers;
+		peers.swap(m_peers_to_request);
+		for (auto const& w : peers)
+		{
+			std::shared_ptr<peer_connection> p = w.lock();
+			if (!p) continue;
+			p->request_blocks_queued(false);
+			if (p->is_disconnecting()) continue;
+			if (p->associated_torrent().lock().get() != this) continue;
+
+			if (request_a_block(*this, *p))
+				inc_stats_counter(counters::incoming_piece_picks);
+			p->send_block_requests();
+		}
+
+		// hand the storage back, to not allocate it again next round
+		peers.clear();
+		if (m_peers_to_request.empty()) m_peers_to_request.swap(peers);
+	}
+
+	void torrent::broadcast_haves()
+	{
+		TORRENT_ASSERT(is_single_thread());
+
+		std::vector<piece_index_t> pieces;
+		pieces.swap(m_pending_haves);
+		if (m_abort) return;
+
+		for (auto c : m_connections)
+		{
+			auto p = c->self();
+			if (p->is_disconnecting()) continue;
+
+			// all HAVE messages to this peer go out in a single write
+			cork c_(*p);
+			for (auto const i : pieces)
+			{
+				p->announce_piece(i);
+				if (p->is_disconnecting()) break;
+			}
+		}
+	}
+
 	void torrent::remove_web_seed_iter(std::list<web_seed_t>::iterator web)
 	{
 		if (web->resolving)
@@ -9186,6 +9267,18 @@ bool is_downloading_state(int const st)
 		if (m_abort) return;
 #endif
 
+		// announce the pieces that passed since the last batch of HAVE
+		// messages
+		if (!m_pending_haves.empty())
+		{
+			int const interval = settings().get_int(settings_pack::have_batch_interval);
+			if (aux::time_now32() - m_last_have_batch >= seconds(interval))
+			{
+				m_last_have_batch = aux::time_now32();
+				broadcast_haves();
+			}
+		}
+
 		// if we're in upload only mode and we're auto-managed
 		// leave upload mode every 10 minutes hoping that the error
 		// condition has been fixed
@@ -9736,6 +9829,10 @@ bool is_downloading_state(int const st)
 		std::vector<piece_block> backup1;
 		std::vector<piece_block> backup2;
 		std::vector<piece_index_t> ignore;
+		// peers' pieces not stored as a plain bitfield are expanded into this
+		// one. It's reused across calls, since this runs for every
+		// time-critical piece on every tick
+		thread_local typed_bitfield<piece_index_t> bits_storage;
 
 		time_point const now = aux::time_now();
 
@@ -9775,8 +9872,9 @@ bool is_downloading_state(int const st)
 			// specifically request blocks with no affinity towards fast or slow
 			// pieces. If we would, the picked block might end up in one of
 			// the backup lists
-			picker->add_blocks(i->piece, c.get_bitfield(), interesting_blocks
-				, backup1, backup2, blocks_in_piece, 0, c.peer_info_struct()
+			picker->add_blocks(i->piece, c.get_bitfield().bitfield(bits_storage)
+				, interesting_blocks, backup1, backup2, blocks_in_piece, 0
+				, c.peer_info_struct()
 				, ignore, {});
 
 			interesting_blocks.insert(interesting_blocks.end()
@@ -10597,6 +10695,7 @@ bool is_downloading_state(int const st)
 	void torrent::new_external_ip()
 	{
 		if (m_peer_list) m_peer_list->clear_peer_prio();
+		for (auto p : m_connections) p->clear_peer_rank();
 	}
 
 	void torrent::stop_when_ready(bool const b)
@@ -75,6 +75,15 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/escape_string.hpp"
 #endif
 
+#if TORRENT_HAVE_MMAP
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+#endif
+
 namespace libtorrent {
 
 	TORRENT_EXPORT from_span_t from_span;
@@ -539,6 +548,61 @@ namespace {
 		return 0;
 	}
 
+#if TORRENT_HAVE_MMAP
+	// maps the file into memory, read-only. The file is unmapped once the
+	// last copy of the returned buffer is destructed
+	boost::shared_array<char> map_torrent_file(std::string const& filename
+		, std::size_t& size, error_code& ec, int const max_buffer_size)
+	{
+		ec.clear();
+		size = 0;
+		int const fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			ec.assign(errno, system_category());
+			return {};
+		}
+
+		struct ::stat st;
+		if (::fstat(fd, &st) != 0)
+		{
+			ec.assign(errno, system_category());
+			::close(fd);
+			return {};
+		}
+
+		if (st.st_size > max_buffer_size)
+		{
+			ec = errors::metadata_too_large;
+			::close(fd);
+			return {};
+		}
+
+		// an empty file can't be mapped, but it's not a valid torrent either.
+		// let bdecode() report the error
+		if (st.st_size == 0)
+		{
+			::close(fd);
+			return {};
+		}
+
+		std::size_t const len = std::size_t(st.st_size);
+		void* const m = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+		int const err = errno;
+		// the mapping keeps the file alive
+		::close(fd);
+		if (m == MAP_FAILED)
+		{
+			ec.assign(err, system_category());
+			return {};
+		}
+
+		size = len;
+		return boost::shared_array<char>(static_cast<char*>(m)
+			, [len](char* p) { ::munmap(p, len); });
+	}
+#endif
+
 } // anonymous namespace
 
 	web_seed_entry::web_seed_entry(std::string const& url_, type_t type_
@@ -881,8 +945,28 @@ namespace {
 	torrent_info::torrent_info(std::string const& filename
 		, load_torrent_limits const& cfg)
 	{
-		std::vector<char> buf;
 		error_code ec;
+#if TORRENT_HAVE_MMAP
+		if (cfg.map_file)
+		{
+			std::size_t size = 0;
+			boost::shared_array<char> const mapping = map_torrent_file(filename, size
+				, ec, cfg.max_buffer_size);
+			if (ec) aux::throw_ex<system_error>(ec);
+
+			bdecode_node e = bdecode({mapping.get(), std::ptrdiff_t(size)}, ec
+				, nullptr, cfg.max_decode_depth, cfg.max_decode_tokens);
+			if (ec) aux::throw_ex<system_error>(ec);
+
+			if (!parse_torrent_file(e, ec, cfg.max_pieces, mapping))
+				aux::throw_ex<system_error>(ec);
+
+			INVARIANT_CHECK;
+			return;
+		}
+#endif
+
+		std::vector<char> buf;
 		int ret = load_file(filename, buf, ec, cfg.max_buffer_size);
 		if (ret < 0) aux::throw_ex<system_error>(ec);
 
@@ -1046,6 +1130,13 @@ namespace {
 
 	bool torrent_info::parse_info_section(bdecode_node const& info
 		, error_code& ec, int const max_pieces)
+	{
+		return parse_info_section(info, ec, max_pieces, boost::shared_array<char>());
+	}
+
+	bool torrent_info::parse_info_section(bdecode_node const& info
+		, error_code& ec, int const max_pieces
+		, boost::shared_array<char> const& backing)
 	{
 		if (info.type() != bdecode_node::dict_t)
 		{
@@ -1062,10 +1153,21 @@ namespace {
 			return false;
 		}
 
-		// copy the info section
 		m_info_section_size = int(section.size());
-		m_info_section.reset(new char[aux::numeric_cast<std::size_t>(m_info_section_size)]);
-		std::memcpy(m_info_section.get(), section.data(), aux::numeric_cast<std::size_t>(m_info_section_size));
+		if (backing)
+		{
+			// the info section lives in a buffer that we can keep a reference
+			// to (typically a memory mapped .torrent file). Refer to it in
+			// place instead of copying it
+			m_info_section.reset(const_cast<char*>(section.data())
+				, [backing](char*) {});
+		}
+		else
+		{
+			// copy the info section
+			m_info_section.reset(new char[aux::numeric_cast<std::size_t>(m_info_section_size)]);
+			std::memcpy(m_info_section.get(), section.data(), aux::numeric_cast<std::size_t>(m_info_section_size));
+		}
 		TORRENT_ASSERT(section[0] == 'd');
 		TORRENT_ASSERT(section[m_info_section_size - 1] == 'e');
 
@@ -1127,6 +1229,10 @@ namespace {
 			}
 			m_flags |= multifile;
 		}
+
+		// all paths have been added, the index is no longer needed
+		files.clear_path_index();
+
 		if (files.num_files() == 0)
 		{
 			ec = errors::no_files_in_torrent;
@@ -1372,6 +1478,14 @@ namespace {
 
 	bool torrent_info::parse_torrent_file(bdecode_node const& torrent_file
 		, error_code& ec, int const piece_limit)
+	{
+		return parse_torrent_file(torrent_file, ec, piece_limit
+			, boost::shared_array<char>());
+	}
+
+	bool torrent_info::parse_torrent_file(bdecode_node const& torrent_file
+		, error_code& ec, int const piece_limit
+		, boost::shared_array<char> const& backing)
 	{
 		if (torrent_file.type() != bdecode_node::dict_t)
 		{
@@ -1399,7 +1513,7 @@ namespace {
 			ec = errors::torrent_missing_info;
 			return false;
 		}
-		if (!parse_info_section(info, ec, piece_limit)) return false;
+		if (!parse_info_section(info, ec, piece_limit, backing)) return false;
 		resolve_duplicate_filenames();
 
 #ifndef TORRENT_DISABLE_MUTABLE_TORRENTS
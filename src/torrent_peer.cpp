@@ -137,7 +137,6 @@ namespace libtorrent {
 		: prev_amount_upload(0)
 		, prev_amount_download(0)
 		, connection(nullptr)
-		, peer_rank(0)
 		, last_optimistically_unchoked(0)
 		, last_connected(0)
 		, port(port_)
@@ -171,12 +170,11 @@ namespace libtorrent {
 	std::uint32_t torrent_peer::rank(external_ip const& external, int external_port) const
 	{
 		TORRENT_ASSERT(in_use);
-//TODO: how do we deal with our external address changing?
-		if (peer_rank == 0)
-			peer_rank = peer_priority(
-				tcp::endpoint(external.external_address(this->address()), std::uint16_t(external_port))
-				, tcp::endpoint(this->address(), this->port));
-		return peer_rank;
+		// this is not cached in the torrent_peer, to keep it small. It's only
+		// needed to break ties between connect candidates
+		return peer_priority(
+			tcp::endpoint(external.external_address(this->address()), std::uint16_t(external_port))
+			, tcp::endpoint(this->address(), this->port));
 	}
 
 #ifndef TORRENT_DISABLE_LOGGING
@@ -58,6 +58,7 @@ namespace libtorrent {
 		, m_sett(sett)
 		, m_counters(cnt)
 		, m_ios(ios)
+		, m_pacing_timer(ios)
 		, m_ssl_context(ssl_context)
 	{
 		m_restrict_mtu.fill(65536);
@@ -185,13 +186,18 @@ namespace libtorrent {
 
 		auto r = m_utp_sockets.equal_range(id);
 
+		int probes = 0;
 		for (; r.first != r.second; ++r.first)
 		{
+			++probes;
 			if (!utp_match(r.first->second, ep, id)) continue;
+			m_counters.inc_stats_counter(counters::utp_demux_probes, probes);
 			bool ret = utp_incoming_packet(r.first->second, p, ep, receive_time);
 			if (ret) m_last_socket = r.first->second;
 			return ret;
 		}
+		if (probes > 0)
+			m_counters.inc_stats_counter(counters::utp_demux_probes, probes);
 
 //		UTP_LOGV("incoming packet id:%d source:%s\n", id, print_endpoint(ep).c_str());
 
@@ -254,6 +260,38 @@ namespace libtorrent {
 		m_stalled_sockets.push_back(s);
 	}
 
+	void utp_socket_manager::subscribe_paced(utp_socket_impl* s, time_point const when)
+	{
+		TORRENT_ASSERT(std::find(m_paced_sockets.begin(), m_paced_sockets.end()
+			, s) == m_paced_sockets.end());
+		m_paced_sockets.push_back(s);
+
+		if (when >= m_pacing_deadline) return;
+
+		// this cancels the currently outstanding wait, if any
+		m_pacing_deadline = when;
+		m_pacing_timer.expires_at(when);
+		m_pacing_timer.async_wait(std::bind(&utp_socket_manager::on_pacing_timer
+			, this, std::placeholders::_1));
+	}
+
+	void utp_socket_manager::on_pacing_timer(error_code const& ec)
+	{
+		// this means the timer was re-armed, or that we're shutting down. In
+		// the latter case, we can't touch any members
+		if (ec) return;
+
+		m_pacing_deadline = time_point::max();
+		if (m_paced_sockets.empty()) return;
+
+		m_temp_sockets.clear();
+		m_paced_sockets.swap(m_temp_sockets);
+		// sockets that still aren't due will subscribe again, and re-arm
+		// the timer
+		for (auto const &s : m_temp_sockets)
+			utp_paced(s);
+	}
+
 	void utp_socket_manager::writable()
 	{
 		if (!m_stalled_sockets.empty())
@@ -324,7 +362,7 @@ namespace libtorrent {
 	void utp_socket_manager::inc_stats_counter(int counter, int delta)
 	{
 		TORRENT_ASSERT((counter >= counters::utp_packet_loss
-				&& counter <= counters::utp_redundant_pkts_in)
+				&& counter <= counters::utp_demux_probes)
 			|| (counter >= counters::num_utp_idle
 				&& counter <= counters::num_utp_deleted));
 		m_counters.inc_stats_counter(counter, delta);
@@ -133,6 +133,11 @@ enum
 	dup_ack_limit = 3
 };
 
+// with pacing enabled, packets that are due within this long are sent right
+// away instead of waiting for the pacing timer. This bounds the number of
+// timer wake-ups, at the cost of sending small bursts
+constexpr milliseconds pacing_granularity(1);
+
 // compare if lhs is less than rhs, taking wrapping
 // into account. if lhs is close to UINT_MAX and rhs
 // is close to 0, lhs is assumed to have wrapped and
@@ -214,11 +219,15 @@ struct utp_socket_impl
 		, m_attached(true)
 		, m_nagle(true)
 		, m_slow_start(true)
+		, m_bbr(sm.congestion_control() == settings_pack::utp_bbr)
+		, m_bbr_probe_rtt(false)
+		, m_bbr_round_loss(false)
 		, m_cwnd_full(false)
 		, m_null_buffers(false)
 		, m_deferred_ack(false)
 		, m_subscribe_drained(false)
 		, m_stalled(false)
+		, m_paced(false)
 		, m_confirmed(false)
 	{
 		TORRENT_ASSERT((m_recv_id == ((m_send_id + 1) & 0xffff))
@@ -272,6 +281,7 @@ struct utp_socket_impl
 	void write_sack(std::uint8_t* buf, int size) const;
 	void incoming(std::uint8_t const* buf, int size, packet_ptr p, time_point now);
 	void do_ledbat(int acked_bytes, int delay, int in_flight);
+	void do_bbr(int acked_bytes, std::uint32_t rtt, time_point now);
 	int packet_timeout() const;
 	bool test_socket_state();
 	void maybe_trigger_receive_callback();
@@ -389,6 +399,10 @@ struct utp_socket_impl
 	// 100 ms
 	time_point m_next_loss;
 
+	// when pacing is enabled, this is the earliest time the next packet with
+	// new payload may be sent
+	time_point m_next_send;
+
 	// the max number of bytes in-flight. This is a fixed point
 	// value, to get the true number of bytes, shift right 16 bits
 	// the value is always >= 0, but the calculations performed on
@@ -459,6 +473,34 @@ struct utp_socket_impl
 	// average RTT
 	sliding_average<int, 16> m_rtt;
 
+	// state for the BBR-style congestion controller (when m_bbr is set).
+	// ACKs are grouped into rounds of one min-RTT each. Every round yields
+	// one delivery rate sample (bytes per second).
+	time_point m_bbr_round_start;
+	time_point m_bbr_min_rtt_stamp;
+
+	// the time the current PROBE_RTT phase ends. This is not set until the
+	// bytes in flight have drained down to the capped window
+	time_point m_bbr_probe_rtt_end;
+	std::int32_t m_bbr_round_delivered = 0;
+
+	// the lowest RTT sample (in microseconds) seen in the last
+	// bbr_min_rtt_window. This is the estimate of the propagation delay
+	std::uint32_t m_bbr_min_rtt = std::numeric_limits<std::uint32_t>::max();
+
+	// the lowest RTT sample (in microseconds) seen during the current
+	// PROBE_RTT phase, after the queue drained
+	std::uint32_t m_bbr_probe_min_rtt = std::numeric_limits<std::uint32_t>::max();
+
+	// the max delivery rate seen in the current and the previous window
+	// of bbr_bw_rounds rounds. The bottleneck bandwidth estimate is the
+	// larger of the two
+	std::array<std::int32_t, 2> m_bbr_max_bw{{0, 0}};
+
+	// the bottleneck bandwidth estimate when we last saw it grow by at
+	// least 25%. Used to detect when to leave slow-start
+	std::int32_t m_bbr_full_bw = 0;
+
 	// if this is != 0, it means the upper layer provided a reason for why
 	// the connection is being closed. The reason is indicated by this
 	// non-zero value which is included in a packet header extension
@@ -527,6 +569,12 @@ struct utp_socket_impl
 	// we have outstanding packets following it.
 	std::uint8_t m_duplicate_acks = 0;
 
+	// the number of packets in m_outbuf that have need_resend set, i.e.
+	// the packets the scoreboard considers lost that haven't been resent
+	// yet. When this is 0, send_pkt() doesn't need to look for packets to
+	// resend
+	std::int32_t m_num_need_resend = 0;
+
 	// the number of packet timeouts we've seen in a row
 	// this affects the packet timeout time
 	std::uint8_t m_num_timeouts = 0;
@@ -567,6 +615,13 @@ struct utp_socket_impl
 		UTP_STATE_DELETE
 	};
 
+	// the number of rounds since m_bbr_max_bw was rotated
+	std::uint8_t m_bbr_rounds = 0;
+
+	// the number of rounds in a row in slow-start where the bandwidth
+	// estimate didn't grow significantly
+	std::uint8_t m_bbr_full_bw_rounds = 0;
+
 	// this is the cursor into m_delay_sample_hist
 	std::uint8_t m_delay_sample_idx:2;
 
@@ -590,6 +645,20 @@ struct utp_socket_impl
 	// link capacity faster. This behaves similar to TCP slow start
 	bool m_slow_start:1;
 
+	// when set, the congestion window is controlled by do_bbr() rather than
+	// do_ledbat(). This is determined by the utp_congestion_control setting
+	// when the socket is created
+	bool m_bbr:1;
+
+	// set while the BBR controller drains the queue at the bottleneck to
+	// take a fresh min-RTT sample, once the old estimate has expired. The
+	// congestion window is capped at bbr_probe_rtt_packets during this time
+	bool m_bbr_probe_rtt:1;
+
+	// set when we detected packet loss during the current BBR round. The
+	// next round then targets one bandwidth-delay product rather than two
+	bool m_bbr_round_loss:1;
+
 	// this is true as long as we have as many packets in
 	// flight as allowed by the congestion window (cwnd)
 	bool m_cwnd_full:1;
@@ -617,6 +686,11 @@ struct utp_socket_impl
 	// the socket being writable again
 	bool m_stalled:1;
 
+	// this is set when the socket is held back by pacing, and has subscribed
+	// to the utp socket manager's pacing timer. Just like m_stalled, the
+	// socket may not be deleted while this is set
+	bool m_paced:1;
+
 	// this is false by default and set to true once we've received a non-SYN
 	// packet for this connection with a correct ack_nr, confirming that the
 	// other end is not spoofing its source IP
@@ -704,6 +778,13 @@ void utp_writable(utp_socket_impl* s)
 	s->writable();
 }
 
+void utp_paced(utp_socket_impl* s)
+{
+	TORRENT_ASSERT(s->m_paced);
+	s->m_paced = false;
+	s->writable();
+}
+
 void utp_send_ack(utp_socket_impl* s)
 {
 	TORRENT_ASSERT(s->m_deferred_ack);
@@ -1176,7 +1257,7 @@ bool utp_socket_impl::should_delete() const
 	// the pointer is removed from that queue. Otherwise we would
 	// leave a dangling pointer in the socket manager
 	bool ret = (m_state >= UTP_STATE_ERROR_WAIT || m_state == UTP_STATE_NONE)
-		&& !m_attached && !m_stalled;
+		&& !m_attached && !m_stalled && !m_paced;
 
 	if (ret)
 	{
@@ -1470,21 +1551,101 @@ std::pair<std::uint32_t, int> utp_socket_impl::parse_sack(std::uint16_t const pa
 		, static_cast<void*>(this), ack_nr, bitmask.c_str(), m_seq_nr, m_fast_resend_seq_nr);
 #endif
 
-	aux::array<std::uint16_t, 5> resend;
-	int num_to_resend = 0;
-
 	int acked_bytes = 0;
 	std::uint32_t min_rtt = std::numeric_limits<std::uint32_t>::max();
 
-	// this was implicitly lost
-	if (!compare_less_wrap((packet_ack + 1) & ACK_MASK, m_fast_resend_seq_nr, ACK_MASK))
+	std::uint8_t const* const start = ptr;
+	std::uint8_t const* const end = ptr + size;
+
+	// first, scan the bits in reverse, and count the number of ACKed packets.
+	// This is the scoreboard's loss criterion (similar to IsLost() in RFC
+	// 6675): a hole is considered lost once more than 'dup_ack_limit' packets
+	// after it have been selectively ACKed. Start with the sequence number
+	// represented by the last bit in the SACK bitmask and find the last
+	// sequence number meeting that criterion
+	std::uint16_t last_resend = (packet_ack + 1 + size * 8) & ACK_MASK;
+
+	// the number of acked packets past the fast re-send sequence number
+	// this is used to determine if we should trigger more fast re-sends
+	int dups = 0;
+
+	for (std::uint8_t const* i = end; i != start; --i)
 	{
-		resend[num_to_resend++] = (packet_ack + 1) & ACK_MASK;
+		std::uint8_t const bitfield = i[-1];
+		std::uint8_t mask = 0x80;
+		// for each bit
+		for (int k = 0; k < 8; ++k)
+		{
+			if (mask & bitfield) ++dups;
+			if (dups > dup_ack_limit) break;
+			last_resend = (last_resend - 1) & ACK_MASK;
+			mask >>= 1;
+		}
+		if (dups > dup_ack_limit) break;
 	}
 
+	// we did not get enough packets acked in this message to warrant a resend
+	if (dups <= dup_ack_limit)
+	{
+		UTP_LOGV("%8p: only %d ACKs in SACK, requires more than %d to trigger fast retransmit\n"
+			, static_cast<void*>(this), dups, dup_ack_limit);
+	}
+
+	// the first and the last packet we marked as lost, if any
+	int first_lost = -1;
+	int last_lost = -1;
+	bool cut_cwnd = true;
+
+	// marks a hole in the SACK as lost, if it meets the criterion and hasn't
+	// been marked (or fast re-sent) already. Lost packets no longer count as
+	// in-flight, which makes room in the congestion window to resend them
+	auto mark_lost = [&](std::uint16_t const seq)
+	{
+		if (dups <= dup_ack_limit) return;
+		if (!compare_less_wrap(seq, last_resend, ACK_MASK)) return;
+		if (compare_less_wrap(seq, m_fast_resend_seq_nr, ACK_MASK)) return;
+		packet* p = m_outbuf.at(seq);
+		if (!p || p->need_resend) return;
+
+		UTP_LOGV("%8p: Packet %d lost. (fast_resend_seq_nr:%d trigger fast-resend)\n"
+			, static_cast<void*>(this), seq, m_fast_resend_seq_nr);
+
+		p->need_resend = true;
+		++m_num_need_resend;
+		TORRENT_ASSERT(m_bytes_in_flight >= p->size - p->header_size);
+		m_bytes_in_flight -= p->size - p->header_size;
+
+		// don't cut cwnd if the packet we lost was the MTU probe
+		// the logic to handle a lost MTU probe is in resend_packet()
+		if (cut_cwnd && (seq != m_mtu_seq || m_mtu_seq == 0))
+		{
+			experienced_loss(seq, now);
+			cut_cwnd = false;
+		}
+
+		if (first_lost == -1) first_lost = seq;
+		last_lost = seq;
+	};
+
+	// without the scoreboard, the first 5 holes in the SACK are collected
+	// here and resent right away below (if they meet the loss criterion).
+	// Holes past those are not considered lost
+	bool const scoreboard = m_sm.sack_scoreboard();
+	aux::array<std::uint16_t, 5> resend;
+	int num_to_resend = 0;
+
+	auto add_resend = [&](std::uint16_t const seq)
+	{
+		if (compare_less_wrap(seq, m_fast_resend_seq_nr, ACK_MASK)) return;
+		if (num_to_resend >= int(resend.size())) return;
+		resend[num_to_resend++] = seq;
+	};
+
+	// this was implicitly lost
+	if (scoreboard) mark_lost((packet_ack + 1) & ACK_MASK);
+	else add_resend((packet_ack + 1) & ACK_MASK);
+
 	// for each byte
-	std::uint8_t const* const start = ptr;
-	std::uint8_t const* const end = ptr + size;
 	for (; ptr != end; ++ptr)
 	{
 		std::uint8_t bitfield = *ptr;
@@ -1511,10 +1672,13 @@ std::pair<std::uint32_t, int> utp_socket_impl::parse_sack(std::uint16_t const pa
 					maybe_inc_acked_seq_nr();
 				}
 			}
-			else if (!compare_less_wrap(ack_nr, m_fast_resend_seq_nr, ACK_MASK)
-				&& num_to_resend < int(resend.size()))
+			else if (scoreboard)
+			{
+				mark_lost(ack_nr);
+			}
+			else
 			{
-				resend[num_to_resend++] = ack_nr;
+				add_resend(ack_nr);
 			}
 
 			mask <<= 1;
@@ -1530,76 +1694,60 @@ std::pair<std::uint32_t, int> utp_socket_impl::parse_sack(std::uint16_t const pa
 
 	if (m_outbuf.empty()) m_duplicate_acks = 0;
 
-	// now, scan the bits in reverse, and count the number of ACKed packets. Only
-	// lost packets followed by 'dup_ack_limit' packets may be resent
-	// start with the sequence number represented by the last bit in the SACK
-	// bitmask
-	std::uint16_t last_resend = (packet_ack + 1 + size * 8) & ACK_MASK;
-
-	// the number of acked packets past the fast re-send sequence number
-	// this is used to determine if we should trigger more fast re-sends
-	int dups = 0;
+	TORRENT_ASSERT(m_outbuf.at((m_acked_seq_nr + 1) & ACK_MASK) || ((m_seq_nr - m_acked_seq_nr) & ACK_MASK) <= 1);
 
-	for (std::uint8_t const* i = end; i != start; --i)
+	if (!scoreboard)
 	{
-		std::uint8_t const bitfield = i[-1];
-		std::uint8_t mask = 0x80;
-		// for each bit
-		for (int k = 0; k < 8; ++k)
+		// we did not get enough packets acked in this message to warrant a
+		// resend
+		if (dups <= dup_ack_limit) num_to_resend = 0;
+
+		// prune the tail of the resend list, since all "unacked" packets that
+		// weren't followed by an acked one, don't count
+		while (num_to_resend > 0
+			&& !compare_less_wrap(resend[num_to_resend - 1], last_resend, ACK_MASK))
 		{
-			if (mask & bitfield) ++dups;
-			if (dups > dup_ack_limit) break;
-			last_resend = (last_resend - 1) & ACK_MASK;
-			mask >>= 1;
+			--num_to_resend;
 		}
-		if (dups > dup_ack_limit) break;
-	}
 
-	// we did not get enough packets acked in this message to warrant a resend
-	if (dups <= dup_ack_limit)
-	{
-		UTP_LOGV("%8p: only %d ACKs in SACK, requires more than %d to trigger fast retransmit\n"
-			, static_cast<void*>(this), dups, dup_ack_limit);
-		num_to_resend = 0;
-	}
-
-	// now we need to (likely) prune the tail of the resend list, since all
-	// "unacked" packets that weren't followed by an acked one, don't count
-	while (num_to_resend > 0 && !compare_less_wrap(resend[num_to_resend - 1], last_resend, ACK_MASK))
-	{
-		--num_to_resend;
-	}
+		for (int i = 0; i < num_to_resend; ++i)
+		{
+			std::uint16_t const pkt_seq = resend[i];
 
-	TORRENT_ASSERT(m_outbuf.at((m_acked_seq_nr + 1) & ACK_MASK) || ((m_seq_nr - m_acked_seq_nr) & ACK_MASK) <= 1);
+			packet* p = m_outbuf.at(pkt_seq);
+			UTP_LOGV("%8p: Packet %d lost. (fast_resend_seq_nr:%d trigger fast-resend)\n"
+				, static_cast<void*>(this), pkt_seq, m_fast_resend_seq_nr);
+			if (!p) continue;
 
-	bool cut_cwnd = true;
+			// don't cut cwnd if the packet we lost was the MTU probe
+			// the logic to handle a lost MTU probe is in resend_packet()
+			if (cut_cwnd && (pkt_seq != m_mtu_seq || m_mtu_seq == 0))
+			{
+				experienced_loss(pkt_seq, now);
+				cut_cwnd = false;
+			}
 
-	// we received more than dup_ack_limit ACKs in this SACK message.
-	// trigger fast re-send. This is not an equal check because 3 identical ACKS
-	// are only 2 duplicates
-	for (int i = 0; i < num_to_resend; ++i)
-	{
-		std::uint16_t const pkt_seq = resend[i];
+			if (resend_packet(p, true))
+			{
+				m_duplicate_acks = 0;
+				m_fast_resend_seq_nr = (pkt_seq + 1) & ACK_MASK;
+			}
+		}
+		return { min_rtt, acked_bytes };
+	}
 
-		packet* p = m_outbuf.at(pkt_seq);
-		UTP_LOGV("%8p: Packet %d lost. (fast_resend_seq_nr:%d trigger fast-resend)\n"
-			, static_cast<void*>(this), pkt_seq, m_fast_resend_seq_nr);
-		if (!p) continue;
+	if (first_lost == -1) return { min_rtt, acked_bytes };
 
-		// don't cut cwnd if the packet we lost was the MTU probe
-		// the logic to handle a lost MTU probe is in resend_packet()
-		if (cut_cwnd && (pkt_seq != m_mtu_seq || m_mtu_seq == 0))
-		{
-			experienced_loss(pkt_seq, now);
-			cut_cwnd = false;
-		}
+	// don't mark these holes as lost again. Once they have been resent, only
+	// a timeout will resend them again
+	m_duplicate_acks = 0;
+	m_fast_resend_seq_nr = (last_lost + 1) & ACK_MASK;
 
-		if (resend_packet(p, true))
-		{
-			m_duplicate_acks = 0;
-			m_fast_resend_seq_nr = (pkt_seq + 1) & ACK_MASK;
-		}
-	}
+	// resend the first lost packet right away, even if the window is full.
+	// The remaining ones are resent by send_pkt() as the window allows, which
+	// lets us recover from several losses in the same round-trip
+	packet* p = m_outbuf.at(aux::numeric_cast<packet_buffer::index_type>(first_lost));
+	if (p && p->need_resend) resend_packet(p, true);
 
 	return { min_rtt, acked_bytes };
 }
@@ -1724,13 +1872,15 @@ bool utp_socket_impl::send_pkt(int const flags)
 
 	// first see if we need to resend any packets
 
-	// TODO: this loop is not very efficient. It could be fixed by having
-	// a separate list of sequence numbers that need resending
-	for (int i = (m_acked_seq_nr + 1) & ACK_MASK; i != m_seq_nr; i = (i + 1) & ACK_MASK)
+	// the lost packets are resent in sequence number order. Stop as soon as
+	// we've seen all of them
+	int to_resend = m_num_need_resend;
+	for (int i = (m_acked_seq_nr + 1) & ACK_MASK; to_resend > 0 && i != m_seq_nr; i = (i + 1) & ACK_MASK)
 	{
 		packet* p = m_outbuf.at(aux::numeric_cast<packet_buffer::index_type>(i));
 		if (!p) continue;
 		if (!p->need_resend) continue;
+		--to_resend;
 		if (!resend_packet(p))
 		{
 			// we couldn't resend the packet. It probably doesn't
@@ -1823,6 +1973,22 @@ bool utp_socket_impl::send_pkt(int const flags)
 		}
 	}
 
+	// with pacing, new payload is held back until it's this socket's turn.
+	// Just like when the window is full, we may still send an ACK
+	if (payload_size > 0 && (flags & pkt_fin) == 0 && m_sm.pacing()
+		&& m_next_send > clock_type::now() + pacing_granularity)
+	{
+		payload_size = 0;
+
+		if (!m_paced)
+		{
+			m_paced = true;
+			m_sm.subscribe_paced(this, m_next_send);
+		}
+
+		if (!force) return false;
+	}
+
 	// if we don't have any data to send, or can't send any data
 	// and we don't have any data to force, don't send a packet
 	if (payload_size == 0 && !force && !m_nagle_packet)
@@ -2019,6 +2185,17 @@ bool utp_socket_impl::send_pkt(int const flags)
 	++m_out_packets;
 	m_sm.inc_stats_counter(counters::utp_packets_out);
 
+	if (payload_size > 0 && m_sm.pacing() && m_rtt.num_samples() > 0)
+	{
+		// schedule the next packet such that a whole cwnd is sent over one
+		// RTT. The 5/4 gain makes sure pacing itself never is what limits
+		// the send rate
+		std::int64_t const cwnd = std::max(m_cwnd >> 16, std::int64_t(m_mtu));
+		std::int64_t const interval = std::int64_t(p->size) * m_rtt.mean() * 1000 * 4
+			/ (cwnd * 5);
+		m_next_send = std::max(m_next_send, now) + microseconds(interval);
+	}
+
 	if (ec == error::message_size)
 	{
 #if TORRENT_UTP_LOG
@@ -2091,6 +2268,7 @@ bool utp_socket_impl::send_pkt(int const flags)
 		{
 //			TORRENT_ASSERT(reinterpret_cast<utp_header*>(old->buf)->seq_nr == m_seq_nr);
 			if (!old->need_resend) m_bytes_in_flight -= old->size - old->header_size;
+			else --m_num_need_resend;
 			release_packet(std::move(old));
 		}
 		TORRENT_ASSERT(h->seq_nr == m_seq_nr);
@@ -2170,7 +2348,11 @@ bool utp_socket_impl::resend_packet(packet* p, bool fast_resend)
 	TORRENT_ASSERT(p->num_transmissions < m_sm.num_resends() + 1);
 
 	TORRENT_ASSERT(p->size - p->header_size >= 0);
-	if (p->need_resend) m_bytes_in_flight += p->size - p->header_size;
+	if (p->need_resend)
+	{
+		m_bytes_in_flight += p->size - p->header_size;
+		--m_num_need_resend;
+	}
 
 	m_sm.inc_stats_counter(counters::utp_packet_resend);
 	if (fast_resend) m_sm.inc_stats_counter(counters::utp_fast_retransmit);
@@ -2249,6 +2431,21 @@ bool utp_socket_impl::resend_packet(packet* p, bool fast_resend)
 	return !m_stalled;
 }
 
+namespace {
+
+	// the number of rounds in each of the two bandwidth windows
+	constexpr std::uint8_t bbr_bw_rounds = 8;
+
+	// the min-RTT estimate expires after this long, to pick up route changes
+	constexpr seconds bbr_min_rtt_window(10);
+
+	// when the min-RTT estimate has expired, the window is capped at this
+	// many packets for bbr_probe_rtt_time, to drain our own queue at the
+	// bottleneck before taking a new sample
+	constexpr int bbr_probe_rtt_packets = 4;
+	constexpr milliseconds bbr_probe_rtt_time(200);
+}
+
 void utp_socket_impl::experienced_loss(std::uint32_t const seq_nr, time_point const now)
 {
 	INVARIANT_CHECK;
@@ -2274,6 +2471,22 @@ void utp_socket_impl::experienced_loss(std::uint32_t const seq_nr, time_point co
 
 	m_next_loss = now + milliseconds(m_sm.cwnd_reduce_timer());
 
+	if (m_bbr)
+	{
+		// the BBR controller sizes cwnd from its bandwidth and RTT
+		// estimates, which isolated losses don't invalidate, so the window
+		// isn't cut in half. It is bounded by what's currently in flight
+		// though, and if the loss persists, the next round targets a
+		// single BDP (see do_bbr()). Timeouts still reset it (in tick())
+		m_bbr_round_loss = true;
+		m_cwnd = std::min(m_cwnd, std::int64_t(std::max(m_bytes_in_flight
+			, m_mtu * bbr_probe_rtt_packets)) * (1 << 16));
+		m_loss_seq_nr = m_seq_nr;
+		UTP_LOGV("%8p: Lost packet %d bounded bbr cwnd:%d m_loss_seq_nr:%d\n"
+			, static_cast<void*>(this), seq_nr, int(m_cwnd >> 16), m_seq_nr);
+		return;
+	}
+
 	// cut window size in 2
 	m_cwnd = std::max(m_cwnd * m_sm.loss_multiplier() / 100
 		, std::int64_t(m_mtu) * (1 << 16));
@@ -2354,6 +2567,10 @@ std::uint32_t utp_socket_impl::ack_packet(packet_ptr p, time_point const receive
 		TORRENT_ASSERT(m_bytes_in_flight >= p->size - p->header_size);
 		m_bytes_in_flight -= p->size - p->header_size;
 	}
+	else
+	{
+		--m_num_need_resend;
+	}
 
 	if (seq_nr == m_mtu_seq && m_mtu_seq != 0)
 	{
@@ -3135,10 +3352,16 @@ bool utp_socket_impl::incoming_packet(span<std::uint8_t const> buf
 				// sure to clamp it as a sanity check
 				if (delay > min_rtt) delay = min_rtt;
 
-				do_ledbat(acked_bytes, int(delay), prev_bytes_in_flight);
+				if (!m_bbr) do_ledbat(acked_bytes, int(delay), prev_bytes_in_flight);
 				m_send_delay = std::int32_t(delay);
 			}
 
+			if (m_bbr && acked_bytes
+				&& min_rtt != std::numeric_limits<std::uint32_t>::max())
+			{
+				do_bbr(acked_bytes, min_rtt, receive_time);
+			}
+
 			m_recv_delay = std::int32_t(std::min(their_delay, min_rtt));
 
 			consume_incoming_data(ph, ptr, payload_size, receive_time);
@@ -3494,6 +3717,142 @@ void utp_socket_impl::do_ledbat(const int acked_bytes, const int delay
 */
 }
 
+void utp_socket_impl::do_bbr(int const acked_bytes, std::uint32_t const rtt
+	, time_point const now)
+{
+	INVARIANT_CHECK;
+
+	TORRENT_ASSERT(acked_bytes > 0);
+
+	if (rtt == 0) return;
+
+	std::int64_t const probe_rtt_cwnd = std::int64_t(m_mtu) * bbr_probe_rtt_packets;
+
+	if (rtt <= m_bbr_min_rtt)
+	{
+		m_bbr_min_rtt = rtt;
+		m_bbr_min_rtt_stamp = now;
+	}
+	else if (!m_bbr_probe_rtt && now - m_bbr_min_rtt_stamp > bbr_min_rtt_window)
+	{
+		// the estimate has expired. With a window of twice the BDP, the RTT
+		// samples we get include the queue we built ourselves, so simply
+		// accepting the next sample would make the estimate (and with it
+		// the window) ratchet upwards. Keep the old estimate until we have
+		// drained the queue and taken a sample of the empty path
+		m_bbr_probe_rtt = true;
+		m_bbr_probe_rtt_end = time_point::max();
+		m_bbr_probe_min_rtt = std::numeric_limits<std::uint32_t>::max();
+		UTP_LOGV("%8p: bbr min_rtt expired (%u), probe_rtt -> 1\n"
+			, static_cast<void*>(this), m_bbr_min_rtt);
+	}
+
+	if (m_bbr_probe_rtt)
+	{
+		// the probe period starts once the bytes in flight have drained
+		// down to the capped window. Only samples after that count
+		if (m_bbr_probe_rtt_end == time_point::max())
+		{
+			if (m_bytes_in_flight <= probe_rtt_cwnd)
+				m_bbr_probe_rtt_end = now + bbr_probe_rtt_time;
+		}
+		else
+		{
+			m_bbr_probe_min_rtt = std::min(m_bbr_probe_min_rtt, rtt);
+		}
+
+		if (now >= m_bbr_probe_rtt_end)
+		{
+			m_bbr_probe_rtt = false;
+			m_bbr_min_rtt = m_bbr_probe_min_rtt;
+			m_bbr_min_rtt_stamp = now;
+
+			if (!m_slow_start)
+			{
+				std::int32_t const btl_bw = std::max(m_bbr_max_bw[0], m_bbr_max_bw[1]);
+				std::int64_t const bdp = std::int64_t(btl_bw) * m_bbr_min_rtt / 1000000;
+				m_cwnd = std::max(bdp * 2, probe_rtt_cwnd) * (1 << 16);
+			}
+			UTP_LOGV("%8p: bbr min_rtt:%u probe_rtt -> 0\n"
+				, static_cast<void*>(this), m_bbr_min_rtt);
+		}
+	}
+
+	if (m_bbr_round_delivered == 0) m_bbr_round_start = now;
+	m_bbr_round_delivered += acked_bytes;
+
+	// while in slow-start, grow exponentially, just like LEDBAT. Only if the
+	// upper layer is actually filling the window though
+	if (m_slow_start && m_bytes_in_flight + acked_bytes + m_mtu > (m_cwnd >> 16))
+		m_cwnd += std::int64_t(acked_bytes) * (1 << 16);
+
+	std::int64_t const elapsed = total_microseconds(now - m_bbr_round_start);
+	if (elapsed >= std::int64_t(m_bbr_min_rtt))
+	{
+		// the end of a round. Take a delivery rate sample
+		std::int32_t const bw = std::int32_t(std::min(std::int64_t(std::numeric_limits<std::int32_t>::max())
+			, std::int64_t(m_bbr_round_delivered) * 1000000 / std::max(elapsed, std::int64_t(1))));
+		m_bbr_round_delivered = 0;
+
+		m_bbr_max_bw[1] = std::max(m_bbr_max_bw[1], bw);
+		if (++m_bbr_rounds >= bbr_bw_rounds)
+		{
+			m_bbr_max_bw[0] = m_bbr_max_bw[1];
+			m_bbr_max_bw[1] = 0;
+			m_bbr_rounds = 0;
+		}
+
+		std::int32_t const btl_bw = std::max(m_bbr_max_bw[0], m_bbr_max_bw[1]);
+
+		if (m_slow_start)
+		{
+			// once the bandwidth estimate stops growing by at least 25% per
+			// round, for 3 rounds, we have found the capacity of the path
+			if (std::int64_t(btl_bw) * 4 >= std::int64_t(m_bbr_full_bw) * 5)
+			{
+				m_bbr_full_bw = btl_bw;
+				m_bbr_full_bw_rounds = 0;
+			}
+			else if (++m_bbr_full_bw_rounds >= 3)
+			{
+				m_slow_start = false;
+				UTP_LOGV("%8p: bbr bandwidth plateau (%d B/s) slow_start -> 0\n"
+					, static_cast<void*>(this), btl_bw);
+			}
+		}
+
+		if (!m_slow_start)
+		{
+			// the target window is twice the bandwidth-delay product. This
+			// leaves room for ACK aggregation and for the bandwidth estimate
+			// to grow, while bounding the queue we build at the bottleneck to
+			// one BDP. If we saw loss during the last round, the queue may
+			// be overflowing the bottleneck buffer, so don't build one
+			std::int64_t const bdp = std::int64_t(btl_bw) * m_bbr_min_rtt / 1000000;
+			std::int64_t const target = std::max(bdp * (m_bbr_round_loss ? 1 : 2)
+				, probe_rtt_cwnd);
+			m_cwnd = target * (1 << 16);
+		}
+		m_bbr_round_loss = false;
+
+		UTP_LOGV("%8p: do_bbr bw:%d min_rtt:%u cwnd:%d slow_start:%d\n"
+			, static_cast<void*>(this), btl_bw, m_bbr_min_rtt, int(m_cwnd >> 16)
+			, int(m_slow_start));
+	}
+
+	if (m_bbr_probe_rtt)
+		m_cwnd = std::min(m_cwnd, probe_rtt_cwnd * (1 << 16));
+
+	// cap the window at what the receiver can take, there's no point in
+	// growing it beyond that
+	m_cwnd = std::min(m_cwnd, std::max(std::int64_t(m_adv_wnd), std::int64_t(m_mtu)) * (1 << 16));
+
+	TORRENT_ASSERT(m_cwnd >= 0);
+
+	int const window_size_left = std::min(int(m_cwnd >> 16), int(m_adv_wnd)) - m_bytes_in_flight;
+	if (window_size_left >= m_mtu) m_cwnd_full = false;
+}
+
 void utp_stream::bind(endpoint_type const&, error_code&) { }
 
 void utp_stream::cancel_handlers(error_code const& ec)
@@ -3627,6 +3986,11 @@ void utp_socket_impl::tick(time_point const now)
 			// slow start before inducing more delay or loss.
 			m_slow_start = true;
 			UTP_LOGV("%8p: slow_start -> 1\n", static_cast<void*>(this));
+
+			// the BBR controller needs to find the capacity of the path
+			// again, from scratch
+			m_bbr_full_bw = 0;
+			m_bbr_full_bw_rounds = 0;
 		}
 
 		// we dropped all packets, that includes the mtu probe
@@ -3643,6 +4007,7 @@ void utp_socket_impl::tick(time_point const now)
 			if (!p) continue;
 			if (p->need_resend) continue;
 			p->need_resend = true;
+			++m_num_need_resend;
 			TORRENT_ASSERT(m_bytes_in_flight >= p->size - p->header_size);
 			m_bytes_in_flight -= p->size - p->header_size;
 			UTP_LOGV("%8p: Packet %d lost (timeout).\n", static_cast<void*>(this), i);
@@ -3729,18 +4094,21 @@ void utp_socket_impl::check_receive_buffers() const
 #if TORRENT_USE_INVARIANT_CHECKS
 void utp_socket_impl::check_invariant() const
 {
+	int num_need_resend = 0;
 	for (packet_buffer::index_type i = m_outbuf.cursor();
 		i != ((m_outbuf.cursor() + m_outbuf.span()) & ACK_MASK);
 		i = (i + 1) & ACK_MASK)
 	{
 		packet* p = m_outbuf.at(i);
 		if (!p) continue;
+		if (p->need_resend) ++num_need_resend;
 		if (m_mtu_seq == i && m_mtu_seq != 0)
 		{
 			TORRENT_ASSERT(p->mtu_probe);
 		}
 		TORRENT_ASSERT(reinterpret_cast<utp_header*>(p->buf)->seq_nr == i);
 	}
+	TORRENT_ASSERT(num_need_resend == m_num_need_resend);
 
 	if (m_nagle_packet)
 	{
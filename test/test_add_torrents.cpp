@@ -0,0 +1,192 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/session.hpp"
+#include "libtorrent/alert_types.hpp"
+#include "libtorrent/create_torrent.hpp"
+#include "libtorrent/torrent_info.hpp"
+#include "libtorrent/read_resume_data.hpp"
+#include "libtorrent/write_resume_data.hpp"
+#include "libtorrent/time.hpp"
+#include "settings.hpp"
+
+#include "test.hpp"
+
+#include <cstdio>
+
+using namespace lt;
+
+namespace {
+
+add_torrent_params make_params(int const idx)
+{
+	file_storage fs;
+	char name[100];
+	std::snprintf(name, sizeof(name), "test_add_torrents_%d/file", idx);
+	fs.add_file(name, 0x40000);
+	fs.add_file(std::string(name) + "2", 0x4000);
+	lt::create_torrent t(fs, 0x4000);
+	std::vector<char> tmp;
+	bencode(std::back_inserter(tmp), t.generate());
+
+	add_torrent_params atp;
+	atp.ti = std::make_shared<torrent_info>(tmp, from_span);
+	atp.info_hash = atp.ti->info_hash();
+	atp.save_path = ".";
+	atp.flags &= ~torrent_flags::auto_managed;
+	atp.flags |= torrent_flags::paused;
+	return atp;
+}
+
+settings_pack load_settings()
+{
+	settings_pack pack = settings();
+	pack.set_str(settings_pack::listen_interfaces, "127.0.0.1:0");
+	pack.set_int(settings_pack::alert_queue_size, 100000);
+	return pack;
+}
+
+// waits for num add_torrent_alerts and returns the info-hashes of the
+// torrents, in the order they were added. Failed torrents are recorded as an
+// all-zero hash
+std::vector<sha1_hash> wait_for_added(lt::session& ses, int const num)
+{
+	std::vector<sha1_hash> ret;
+	time_point const end = clock_type::now() + seconds(120);
+	std::vector<alert*> alerts;
+	while (int(ret.size()) < num && clock_type::now() < end)
+	{
+		ses.wait_for_alert(seconds(1));
+		ses.pop_alerts(&alerts);
+		for (alert* a : alerts)
+		{
+			auto const* at = alert_cast<add_torrent_alert>(a);
+			if (at == nullptr) continue;
+			ret.push_back(at->error ? sha1_hash() : at->handle.info_hash());
+		}
+	}
+	TEST_EQUAL(int(ret.size()), num);
+	return ret;
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(async_load_torrents)
+{
+	std::vector<std::vector<char>> buffers;
+	std::vector<sha1_hash> expected;
+	for (int i = 0; i < 300; ++i)
+	{
+		add_torrent_params atp = make_params(i);
+		expected.push_back(atp.ti->info_hash());
+		buffers.push_back(write_resume_data_buf(atp));
+	}
+
+	// a corrupt buffer fails to load, but does not affect the others
+	buffers[100].resize(20);
+	expected[100].clear();
+
+	// binary resume data is accepted too
+	buffers[200] = write_resume_data_binary(read_resume_data(buffers[200]));
+
+	lt::session ses(load_settings());
+	ses.async_load_torrents(std::move(buffers), ".");
+
+	TEST_CHECK(wait_for_added(ses, 300) == expected);
+	TEST_EQUAL(ses.get_torrents().size(), 299);
+}
+
+TORRENT_TEST(async_add_torrents)
+{
+	std::vector<add_torrent_params> params;
+	std::vector<sha1_hash> expected;
+	for (int i = 0; i < 150; ++i)
+	{
+		params.push_back(make_params(i));
+		expected.push_back(params.back().ti->info_hash());
+	}
+
+	// the info-hash does not match the torrent
+	params[70].info_hash = params[71].ti->info_hash();
+	expected[70].clear();
+
+	// adding the same torrent twice returns the existing one
+	params.push_back(params[20]);
+	expected.push_back(expected[20]);
+
+	lt::session ses(load_settings());
+	ses.async_add_torrents(std::move(params));
+
+	TEST_CHECK(wait_for_added(ses, 151) == expected);
+	TEST_EQUAL(ses.get_torrents().size(), 149);
+}
+
+// the session is destructed while the torrents are still being loaded. The
+// load threads must be stopped before the session goes away
+TORRENT_TEST(async_load_torrents_abort)
+{
+	std::vector<std::vector<char>> buffers;
+	for (int i = 0; i < 300; ++i)
+		buffers.push_back(write_resume_data_buf(make_params(i)));
+
+	lt::session ses(load_settings());
+	ses.async_load_torrents(std::move(buffers), ".");
+}
+
+// changing the number of load threads between jobs
+TORRENT_TEST(torrent_load_threads_change)
+{
+	std::vector<add_torrent_params> params;
+	std::vector<sha1_hash> expected;
+	for (int i = 0; i < 100; ++i)
+	{
+		params.push_back(make_params(i));
+		expected.push_back(params.back().ti->info_hash());
+	}
+
+	lt::session ses(load_settings());
+	ses.async_add_torrents(std::vector<add_torrent_params>(params.begin(), params.begin() + 50));
+	TEST_CHECK(wait_for_added(ses, 50) == std::vector<sha1_hash>(expected.begin(), expected.begin() + 50));
+
+	settings_pack p;
+	p.set_int(settings_pack::torrent_load_threads, 1);
+	ses.apply_settings(p);
+	ses.async_add_torrents(std::vector<add_torrent_params>(params.begin() + 50, params.end()));
+	TEST_CHECK(wait_for_added(ses, 50) == std::vector<sha1_hash>(expected.begin() + 50, expected.end()));
+
+	p.set_int(settings_pack::torrent_load_threads, 8);
+	ses.apply_settings(p);
+	ses.async_add_torrents(std::move(params));
+	std::vector<sha1_hash> const added = wait_for_added(ses, 100);
+	TEST_CHECK(added == expected);
+	TEST_EQUAL(ses.get_torrents().size(), 100);
+}
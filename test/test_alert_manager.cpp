@@ -305,9 +305,24 @@ TORRENT_TEST(dropped_alerts)
 	// size to 3
 	std::vector<alert*> alerts;
 	mgr.get_all(alerts);
-	auto const d = alert_cast<alerts_dropped_alert>(alerts.back())->dropped_alerts;
+	auto const* a = alert_cast<alerts_dropped_alert>(alerts.back());
+	auto const d = a->dropped_alerts;
 	TEST_EQUAL(d.count(), 1);
 	TEST_CHECK(d.test(torrent_finished_alert::alert_type));
+	TEST_EQUAL(a->num_dropped[torrent_finished_alert::alert_type], 1);
+	TEST_EQUAL(mgr.num_dropped(), 1);
+
+	// the per-type counts are reset every time the alerts are fetched, the
+	// total is not
+	mgr.emplace_alert<torrent_finished_alert>(torrent_handle());
+	mgr.emplace_alert<torrent_finished_alert>(torrent_handle());
+	mgr.emplace_alert<torrent_finished_alert>(torrent_handle());
+	mgr.emplace_alert<torrent_finished_alert>(torrent_handle());
+	mgr.get_all(alerts);
+	a = alert_cast<alerts_dropped_alert>(alerts.back());
+	TEST_CHECK(a != nullptr);
+	if (a) TEST_EQUAL(a->num_dropped[torrent_finished_alert::alert_type], 2);
+	TEST_EQUAL(mgr.num_dropped(), 3);
 }
 
 TORRENT_TEST(alerts_dropped_alert)
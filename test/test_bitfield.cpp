@@ -32,8 +32,10 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "test.hpp"
 #include "libtorrent/bitfield.hpp"
+#include "libtorrent/aux_/have_bitfield.hpp"
 #include "libtorrent/aux_/cpuid.hpp"
 #include <cstdlib>
+#include <algorithm> // for min
 
 using namespace lt;
 
@@ -426,3 +428,275 @@ TORRENT_TEST(bitfield_index_range)
 	TEST_EQUAL(sum, 15 * 16 / 2);
 }
 
+
+namespace {
+
+bitfield random_bitfield(int const size, int const density)
+{
+	bitfield ret(size, false);
+	for (int i = 0; i < size; ++i)
+		if (std::rand() % 100 < density) ret.set_bit(i);
+	return ret;
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(count_kernel)
+{
+	// cover every combination of the 256 bit main loop, the 64 bit loop
+	// and the trailing 32 bit word
+	for (int size = 0; size < 600; size += 7)
+	{
+		for (int const density : {0, 3, 50, 100})
+		{
+			bitfield const b = random_bitfield(size, density);
+			int expected = 0;
+			for (bool const bit : b) expected += bit;
+			TEST_EQUAL(b.count(), expected);
+		}
+	}
+}
+
+TORRENT_TEST(count_and)
+{
+	for (int size = 0; size < 600; size += 13)
+	{
+		for (int const size2 : {0, size / 2, size, size + 40})
+		{
+			bitfield const a = random_bitfield(size, 50);
+			bitfield const b = random_bitfield(size2, 50);
+			int expected = 0;
+			for (int i = 0; i < std::min(size, size2); ++i)
+				expected += a.get_bit(i) && b.get_bit(i);
+			TEST_EQUAL(a.count_and(b), expected);
+			TEST_EQUAL(b.count_and(a), expected);
+		}
+	}
+
+	bitfield const full(300, true);
+	TEST_EQUAL(full.count_and(full), 300);
+	TEST_EQUAL(full.count_and(bitfield(300, false)), 0);
+}
+
+TORRENT_TEST(find_first_set_and_not)
+{
+	for (int size = 0; size < 600; size += 11)
+	{
+		for (int const size2 : {0, size / 2, size, size + 40})
+		{
+			for (int const density : {1, 50, 98})
+			{
+				bitfield const a = random_bitfield(size, density);
+				bitfield const b = random_bitfield(size2, 99);
+				int expected = -1;
+				for (int i = 0; i < size; ++i)
+				{
+					if (a.get_bit(i) && (i >= size2 || !b.get_bit(i)))
+					{
+						expected = i;
+						break;
+					}
+				}
+				TEST_EQUAL(a.find_first_set_and_not(b), expected);
+			}
+		}
+	}
+}
+
+TORRENT_TEST(find_first_set_and_not_edges)
+{
+	bitfield a(1000, false);
+	bitfield b(1000, true);
+	TEST_EQUAL(a.find_first_set_and_not(b), -1);
+	a.set_all();
+	TEST_EQUAL(a.find_first_set_and_not(b), -1);
+	b.clear_bit(999);
+	TEST_EQUAL(a.find_first_set_and_not(b), 999);
+	b.clear_bit(0);
+	TEST_EQUAL(a.find_first_set_and_not(b), 0);
+	TEST_EQUAL(a.find_first_set_and_not(bitfield()), 0);
+	TEST_EQUAL(bitfield().find_first_set_and_not(a), -1);
+
+	// a is longer than b, the bits past the end of b count
+	bitfield c(500, true);
+	bitfield d(100, true);
+	TEST_EQUAL(c.find_first_set_and_not(d), 100);
+}
+
+TORRENT_TEST(find_first_clear)
+{
+	TEST_EQUAL(bitfield().find_first_clear(), -1);
+	TEST_EQUAL(bitfield(100, true).find_first_clear(), -1);
+	TEST_EQUAL(bitfield(96, true).find_first_clear(), -1);
+	TEST_EQUAL(bitfield(100, false).find_first_clear(), 0);
+
+	bitfield test1(100, true);
+	test1.clear_bit(99);
+	TEST_EQUAL(test1.find_first_clear(), 99);
+	test1.clear_bit(40);
+	TEST_EQUAL(test1.find_first_clear(), 40);
+}
+
+namespace {
+
+using have_form = aux::have_bitfield::form_t;
+
+bool same_bits(typed_bitfield<piece_index_t> const& lhs
+	, typed_bitfield<piece_index_t> const& rhs)
+{
+	if (lhs.size() != rhs.size()) return false;
+	for (auto const i : lhs.range())
+		if (lhs[i] != rhs[i]) return false;
+	return true;
+}
+
+// make sure the have_bitfield matches the plain bitfield bit by bit
+void check_have(aux::have_bitfield const& h, typed_bitfield<piece_index_t> const& b)
+{
+	TEST_EQUAL(h.size(), b.size());
+	TEST_EQUAL(h.count(), b.count());
+	TEST_EQUAL(h.all_set(), b.all_set());
+	TEST_EQUAL(h.none_set(), b.none_set());
+	for (auto const i : b.range())
+		TEST_EQUAL(h[i], b[i]);
+	TEST_CHECK(same_bits(h.to_bitfield(), b));
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(have_bitfield_forms)
+{
+	aux::have_bitfield h(1000, false);
+	typed_bitfield<piece_index_t> b(1000, false);
+	TEST_CHECK(h.form() == have_form::sparse);
+	check_have(h, b);
+
+	// up to 1000 / 32 pieces fit the sparse form
+	for (int i = 0; i < 31; ++i)
+	{
+		h.set_bit(piece_index_t(i * 31));
+		b.set_bit(piece_index_t(i * 31));
+	}
+	h.set_bit(piece_index_t(0));
+	TEST_CHECK(h.form() == have_form::sparse);
+	check_have(h, b);
+
+	h.set_bit(piece_index_t(999));
+	b.set_bit(piece_index_t(999));
+	TEST_CHECK(h.form() == have_form::dense);
+	check_have(h, b);
+
+	for (auto const i : b.range())
+	{
+		h.set_bit(i);
+		b.set_bit(i);
+	}
+	TEST_CHECK(h.form() == have_form::all);
+	check_have(h, b);
+
+	h.clear_bit(piece_index_t(10));
+	b.clear_bit(piece_index_t(10));
+	TEST_CHECK(h.form() == have_form::dense);
+	check_have(h, b);
+
+	h.clear_all();
+	b.clear_all();
+	TEST_CHECK(h.form() == have_form::sparse);
+	check_have(h, b);
+
+	h.set_all();
+	b.set_all();
+	TEST_CHECK(h.form() == have_form::all);
+	check_have(h, b);
+}
+
+TORRENT_TEST(have_bitfield_assign)
+{
+	typed_bitfield<piece_index_t> b(500, false);
+	aux::have_bitfield h(b);
+	TEST_CHECK(h.form() == have_form::sparse);
+	check_have(h, b);
+
+	b.set_bit(piece_index_t(3));
+	b.set_bit(piece_index_t(499));
+	h = b;
+	TEST_CHECK(h.form() == have_form::sparse);
+	check_have(h, b);
+
+	for (int i = 0; i < 500; i += 3) b.set_bit(piece_index_t(i));
+	h = b;
+	TEST_CHECK(h.form() == have_form::dense);
+	check_have(h, b);
+
+	b.set_all();
+	h = b;
+	TEST_CHECK(h.form() == have_form::all);
+	check_have(h, b);
+
+	typed_bitfield<piece_index_t> storage;
+	TEST_CHECK(same_bits(h.bitfield(storage), b));
+	h = typed_bitfield<piece_index_t>();
+	TEST_CHECK(h.empty());
+	TEST_CHECK(!h.all_set());
+}
+
+TORRENT_TEST(have_bitfield_resize)
+{
+	// growing while we don't have metadata yet
+	aux::have_bitfield h;
+	h.resize(1000, false);
+	h.set_bit(piece_index_t(999));
+	h.resize(2000, false);
+	h.set_bit(piece_index_t(1999));
+	TEST_CHECK(h.form() == have_form::sparse);
+	TEST_EQUAL(h.count(), 2);
+	TEST_CHECK(h[piece_index_t(999)]);
+	TEST_CHECK(!h[piece_index_t(1000)]);
+
+	// a seed
+	aux::have_bitfield s;
+	s.resize(100, true);
+	TEST_CHECK(s.form() == have_form::all);
+	TEST_EQUAL(s.count(), 100);
+
+	// shrinking and growing with set bits goes via a plain bitfield
+	typed_bitfield<piece_index_t> b = s.to_bitfield();
+	s.resize(50, false);
+	b.resize(50, false);
+	check_have(s, b);
+	s.resize(120, false);
+	b.resize(120, false);
+	check_have(s, b);
+	s.resize(200, true);
+	b.resize(200, true);
+	check_have(s, b);
+
+	s.clear();
+	TEST_CHECK(s.empty());
+	TEST_EQUAL(s.count(), 0);
+}
+
+TORRENT_TEST(have_bitfield_random)
+{
+	for (int size : {1, 2, 31, 32, 33, 100, 1000, 4000})
+	{
+		aux::have_bitfield h(size, false);
+		typed_bitfield<piece_index_t> b(size, false);
+		for (int i = 0; i < size * 3; ++i)
+		{
+			piece_index_t const idx(std::rand() % size);
+			if (std::rand() % 4 == 0)
+			{
+				h.clear_bit(idx);
+				b.clear_bit(idx);
+			}
+			else
+			{
+				h.set_bit(idx);
+				b.set_bit(idx);
+			}
+			TEST_EQUAL(h.count(), b.count());
+		}
+		check_have(h, b);
+	}
+}
@@ -38,8 +38,12 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/announce_entry.hpp"
 #include "libtorrent/aux_/escape_string.hpp" // for convert_path_to_posix
 #include "libtorrent/announce_entry.hpp"
+#include "libtorrent/settings_pack.hpp"
+#include "libtorrent/hasher.hpp"
+#include "setup_transfer.hpp" // for create_random_files
 
 #include <cstring>
+#include <fstream>
 
 
 // make sure creating a torrent from an existing handle preserves the
@@ -119,3 +123,67 @@ TORRENT_TEST(create_torrent_round_trip)
 	TEST_CHECK(info1.info_hash() == info2.info_hash());
 }
 
+
+TORRENT_TEST(set_piece_hashes_threads)
+{
+	std::vector<int> sizes;
+	for (int i = 0; i < 40; ++i) sizes.push_back(i * 7919 + (i % 3) * 0x10000);
+	create_random_files("test_hash_dir", sizes);
+
+	lt::file_storage fs;
+	lt::add_files(fs, "test_hash_dir");
+	TEST_EQUAL(fs.num_files(), 40);
+
+	int const piece_size = 0x4000;
+	for (int const threads : {1, 4})
+	{
+		// pad files are hashed as zeroes
+		lt::create_torrent t(fs, piece_size, piece_size);
+		lt::settings_pack pack;
+		pack.set_int(lt::settings_pack::aio_threads, threads);
+
+		// the progress callback is called for every piece, in order
+		int next = 0;
+		lt::error_code ec;
+		lt::set_piece_hashes(t, ".", pack, [&](lt::piece_index_t const p)
+			{ TEST_EQUAL(static_cast<int>(p), next); ++next; }, ec);
+		TEST_CHECK(!ec);
+		TEST_EQUAL(next, t.num_pieces());
+
+		// hash the files the simple way, one piece at a time
+		lt::file_storage const& files = t.files();
+		std::vector<char> content;
+		for (auto const i : files.file_range())
+		{
+			if (files.pad_file_at(i))
+			{
+				content.resize(content.size() + std::size_t(files.file_size(i)), 0);
+				continue;
+			}
+			std::ifstream in(files.file_path(i, "."), std::ios_base::binary);
+			content.insert(content.end(), std::istreambuf_iterator<char>(in)
+				, std::istreambuf_iterator<char>());
+		}
+		TEST_EQUAL(std::int64_t(content.size()), files.total_size());
+
+		std::vector<char> buffer;
+		lt::bencode(std::back_inserter(buffer), t.generate());
+		lt::torrent_info const ti(buffer, lt::from_span);
+		for (auto const p : ti.piece_range())
+		{
+			std::size_t const start = std::size_t(static_cast<int>(p)) * piece_size;
+			std::size_t const len = std::min(std::size_t(piece_size), content.size() - start);
+			TEST_CHECK(ti.hash_for_piece(p) == lt::hasher(&content[start], int(len)).final());
+		}
+	}
+}
+
+TORRENT_TEST(set_piece_hashes_missing_file)
+{
+	lt::file_storage fs;
+	fs.add_file("test_missing_dir/missing", 0x10000);
+	lt::create_torrent t(fs, 0x4000);
+	lt::error_code ec;
+	lt::set_piece_hashes(t, ".", ec);
+	TEST_CHECK(ec);
+}
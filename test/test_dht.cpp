@@ -3383,7 +3383,7 @@ TORRENT_TEST(rpc_invalid_error_msg)
 	counters cnt;
 
 	dht::routing_table table(node_id(), udp::v4(), 8, sett, &observer);
-	dht::rpc_manager rpc(node_id(), sett, table, ls, &s, &observer);
+	dht::rpc_manager rpc(node_id(), sett, table, ls, &s, &observer, cnt);
 	std::unique_ptr<dht_storage_interface> dht_storage(dht_default_storage_constructor(sett));
 	dht_storage->update_node_ids({node_id(nullptr)});
 	dht::node node(ls, &s, sett, node_id(nullptr), &observer, cnt, get_foreign_node_stub, *dht_storage);
@@ -45,13 +45,17 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/entry.hpp"
 #include "libtorrent/torrent_info.hpp"
 #include "libtorrent/aux_/path.hpp"
+#include "libtorrent/alert_types.hpp"
 
+#include <algorithm>
 #include <cstring>
 #include <functional>
 #include <iostream>
+#include <numeric>
 #include <fstream>
 #include <cstdarg>
 #include <cstdio> // for vsnprintf
+#include <vector>
 
 using namespace lt;
 using namespace std::placeholders;
@@ -256,7 +260,7 @@ void send_bitfield(tcp::socket& s, char const* bits)
 	log("==> bitfield [%s]", bits);
 	for (int i = 0; i < num_pieces; ++i)
 	{
-		ptr[i/8] |= (bits[i] == '1' ? 1 : 0) << i % 8;
+		ptr[i/8] |= (bits[i] == '1' ? 0x80 : 0) >> (i % 8);
 	}
 	error_code ec;
 	boost::asio::write(s, boost::asio::buffer(msg.data(), std::size_t(msg.size()))
@@ -511,6 +515,119 @@ std::shared_ptr<torrent_info> setup_peer(tcp::socket& s, sha1_hash& ih
 	return t;
 }
 
+void send_dont_have(tcp::socket& s, int const lt_dont_have, int const piece)
+{
+	using namespace lt::detail;
+
+	log("==> dont_have: %d", piece);
+	char msg[10];
+	char* ptr = msg;
+	write_uint32(6, ptr);
+	write_uint8(20, ptr);
+	write_uint8(lt_dont_have, ptr);
+	write_uint32(piece, ptr);
+	error_code ec;
+	boost::asio::write(s, boost::asio::buffer(msg, 10)
+		, boost::asio::transfer_all(), ec);
+	if (ec) TEST_ERROR(ec.message());
+}
+
+// waits a little while for the session to respond, and then returns all the
+// messages it has sent, without blocking for more
+std::vector<std::vector<char>> read_pending_messages(tcp::socket& s)
+{
+	std::this_thread::sleep_for(lt::milliseconds(500));
+
+	std::vector<std::vector<char>> ret;
+	char recv_buffer[1000];
+	error_code ec;
+	while (s.available(ec) >= 4 && !ec)
+	{
+		int const len = read_message(s, recv_buffer);
+		if (len == -1) break;
+		auto const buffer = span<char const>(recv_buffer).first(len);
+		print_message(buffer);
+		ret.emplace_back(buffer.begin(), buffer.end());
+	}
+	return ret;
+}
+
+// returns the pieces of the HAVE messages in msgs
+std::vector<int> have_messages(std::vector<std::vector<char>> const& msgs)
+{
+	using namespace lt::detail;
+
+	std::vector<int> ret;
+	for (auto const& m : msgs)
+	{
+		if (m.size() != 5 || m[0] != 4) continue;
+		char const* ptr = m.data() + 1;
+		ret.push_back(read_int32(ptr));
+	}
+	return ret;
+}
+
+// returns the message ID the session assigned to lt_donthave in its
+// extension handshake, or 0 if there was none
+int find_lt_donthave(std::vector<std::vector<char>> const& msgs)
+{
+	for (auto const& m : msgs)
+	{
+		if (m.size() < 2 || m[0] != 20 || m[1] != 0) continue;
+		error_code ec;
+		bdecode_node const e = bdecode(span<char const>(m).subspan(2), ec);
+		if (ec) continue;
+		bdecode_node const ext = e.dict_find_dict("m");
+		if (!ext) continue;
+		return int(ext.dict_find_int_value("lt_donthave"));
+	}
+	return 0;
+}
+
+// piece data matching the torrents created by setup_peer()
+std::vector<char> piece_data()
+{
+	std::vector<char> ret(16 * 1024);
+	for (int i = 0; i < int(ret.size()); ++i)
+		ret[std::size_t(i)] = char((i % 26) + 'A');
+	return ret;
+}
+
+#ifndef TORRENT_DISABLE_LOGGING
+// pops the session's alerts and returns the size of every write to a peer
+// socket since the last call, in the order they were issued
+std::vector<int> socket_writes(lt::session& ses)
+{
+	std::vector<int> ret;
+	print_alerts(ses, "ses", true, false, [&](lt::alert const* a)
+	{
+		auto const* pla = alert_cast<peer_log_alert>(a);
+		if (pla == nullptr || std::strcmp(pla->event_type, "ASYNC_WRITE") != 0)
+			return false;
+		int bytes = 0;
+		if (std::sscanf(pla->log_message(), "bytes: %d", &bytes) == 1)
+			ret.push_back(bytes);
+		return false;
+	});
+	return ret;
+}
+
+// returns the number of messages of the given type in msgs
+int count_messages(std::vector<std::vector<char>> const& msgs, int const type)
+{
+	return int(std::count_if(msgs.begin(), msgs.end()
+		, [=](std::vector<char> const& m) { return !m.empty() && m[0] == type; }));
+}
+
+// the number of bytes msgs took on the wire, including the length prefixes
+int wire_size(std::vector<std::vector<char>> const& msgs)
+{
+	int ret = 0;
+	for (auto const& m : msgs) ret += 4 + int(m.size());
+	return ret;
+}
+#endif
+
 } // anonymous namespace
 
 // makes sure that pieces that are allowed and then
@@ -1127,3 +1244,218 @@ TORRENT_TEST(dht_port_no_support)
 }
 // TODO: test sending invalid requests (out of bound piece index, offsets and
 // sizes)
+
+TORRENT_TEST(batched_haves)
+{
+	std::cout << "\n === test batched HAVE messages ===\n" << std::endl;
+
+	sha1_hash ih;
+	torrent_handle th;
+	std::shared_ptr<lt::session> ses;
+	io_service ios;
+	tcp::socket s(ios);
+	setup_peer(s, ih, ses, true, false, false, torrent_flags_t{}, &th);
+
+	settings_pack pack;
+	pack.set_int(settings_pack::have_batch_interval, 1);
+	ses->apply_settings(pack);
+
+	char recv_buffer[1000];
+	do_handshake(s, ih, recv_buffer);
+	// the peer has piece 0, and piece 12 to keep us interested
+	send_bitfield(s, "1000000000001");
+
+	int const lt_dont_have = find_lt_donthave(read_pending_messages(s));
+	TEST_CHECK(lt_dont_have != 0);
+	print_session_log(*ses);
+
+	std::vector<char> const piece = piece_data();
+	for (int i = 0; i < 3; ++i)
+		th.add_piece(piece_index_t(i), piece.data());
+
+	// wait for the batch to go out
+	std::this_thread::sleep_for(lt::milliseconds(1500));
+
+	// the peer already has piece 0, it's not told about it
+	std::vector<int> haves = have_messages(read_pending_messages(s));
+	std::sort(haves.begin(), haves.end());
+	TEST_CHECK((haves == std::vector<int>{1, 2}));
+	print_session_log(*ses);
+	TEST_CHECK(get_counters(*ses)["ses.num_suppressed_have"] >= 1);
+
+	// once the peer drops piece 0, it is told we have it
+	send_dont_have(s, lt_dont_have, 0);
+	haves = have_messages(read_pending_messages(s));
+	TEST_CHECK((haves == std::vector<int>{0}));
+	print_session_log(*ses);
+}
+
+TORRENT_TEST(dont_have_redundant_have)
+{
+	std::cout << "\n === test DONT_HAVE with redundant HAVE messages ===\n" << std::endl;
+
+	sha1_hash ih;
+	torrent_handle th;
+	std::shared_ptr<lt::session> ses;
+	io_service ios;
+	tcp::socket s(ios);
+	setup_peer(s, ih, ses, true, false, false, torrent_flags_t{}, &th);
+
+	char recv_buffer[1000];
+	do_handshake(s, ih, recv_buffer);
+	send_bitfield(s, "1000000000001");
+
+	int const lt_dont_have = find_lt_donthave(read_pending_messages(s));
+	TEST_CHECK(lt_dont_have != 0);
+	print_session_log(*ses);
+
+	// by default, the peer is told about pieces it already has
+	std::vector<char> const piece = piece_data();
+	th.add_piece(piece_index_t(0), piece.data());
+	TEST_CHECK((have_messages(read_pending_messages(s)) == std::vector<int>{0}));
+	print_session_log(*ses);
+	TEST_EQUAL(get_counters(*ses)["ses.num_suppressed_have"], 0);
+
+	// so there's no need to tell it again when it drops the piece
+	send_dont_have(s, lt_dont_have, 0);
+	TEST_CHECK(have_messages(read_pending_messages(s)).empty());
+	print_session_log(*ses);
+}
+
+#ifndef TORRENT_DISABLE_LOGGING
+// all pieces that pass in the same round are announced to a peer in a single
+// write
+TORRENT_TEST(haves_single_write)
+{
+	std::cout << "\n === test HAVE messages in a single write ===\n" << std::endl;
+
+	sha1_hash ih;
+	torrent_handle th;
+	std::shared_ptr<lt::session> ses;
+	io_service ios;
+	tcp::socket s(ios);
+	setup_peer(s, ih, ses, true, false, false, torrent_flags_t{}, &th);
+
+	// the first batch goes out 4 seconds after the torrent was added. All
+	// the pieces below have passed by then
+	settings_pack pack;
+	pack.set_int(settings_pack::have_batch_interval, 4);
+	ses->apply_settings(pack);
+
+	char recv_buffer[1000];
+	do_handshake(s, ih, recv_buffer);
+	// the peer has piece 12, which keeps us interested
+	send_bitfield(s, "0000000000001");
+	read_pending_messages(s);
+	socket_writes(*ses);
+
+	std::vector<char> const piece = piece_data();
+	for (int i = 0; i < 5; ++i)
+		th.add_piece(piece_index_t(i), piece.data());
+
+	std::this_thread::sleep_for(lt::milliseconds(4000));
+
+	std::vector<std::vector<char>> const msgs = read_pending_messages(s);
+	std::vector<int> haves = have_messages(msgs);
+	std::sort(haves.begin(), haves.end());
+	TEST_CHECK((haves == std::vector<int>{0, 1, 2, 3, 4}));
+
+	std::vector<int> const writes = socket_writes(*ses);
+	TEST_EQUAL(writes.size(), 1);
+	TEST_CHECK((writes == std::vector<int>{wire_size(msgs)}));
+	TEST_EQUAL(wire_size(msgs), 5 * 9);
+}
+
+namespace {
+
+// makes the session send a burst of CANCEL messages, by switching the torrent
+// to upload mode while it has requests outstanding to the peer. Returns the
+// sizes of the messages that went out in the first write
+std::vector<int> cancel_burst(int const coalesce_bytes)
+{
+	sha1_hash ih;
+	torrent_handle th;
+	std::shared_ptr<lt::session> ses;
+	io_service ios;
+	tcp::socket s(ios);
+	setup_peer(s, ih, ses, true, false, false, torrent_flags_t{}, &th);
+
+	settings_pack pack;
+	pack.set_int(settings_pack::send_coalesce_bytes, coalesce_bytes);
+	ses->apply_settings(pack);
+
+	char recv_buffer[1000];
+	do_handshake(s, ih, recv_buffer);
+	// the peer must not be a seed, or it would be disconnected once we're
+	// upload-only too
+	send_bitfield(s, "1111111111110");
+	send_unchoke(s);
+
+	int const num_requests = count_messages(read_pending_messages(s), 6);
+	log("requests: %d", num_requests);
+	TEST_CHECK(num_requests >= 3);
+	socket_writes(*ses);
+
+	// upload mode cancels all outstanding requests, one CANCEL each
+	th.set_flags(torrent_flags::upload_mode);
+
+	std::vector<std::vector<char>> const msgs = read_pending_messages(s);
+	TEST_EQUAL(count_messages(msgs, 8), num_requests);
+
+	std::vector<int> const writes = socket_writes(*ses);
+	TEST_CHECK(!writes.empty());
+	if (writes.empty()) return {};
+
+	// everything that was written arrived, and nothing else
+	int total = 0;
+	for (int const w : writes) total += w;
+	TEST_EQUAL(total, wire_size(msgs));
+
+	// with no limit, the CANCELs are held back until the end of the round,
+	// and go out in one write
+	if (coalesce_bytes > total)
+		TEST_EQUAL(writes.size(), 1);
+
+	std::vector<int> first_write;
+	int bytes = 0;
+	for (auto const& m : msgs)
+	{
+		if (bytes >= writes.front()) break;
+		first_write.push_back(int(m.size()) + 4);
+		bytes += first_write.back();
+	}
+	TEST_EQUAL(bytes, writes.front());
+	return first_write;
+}
+
+} // anonymous namespace
+
+// by default, the first message is written right away. The ones following
+// it, while the write is outstanding, are coalesced into the next one
+TORRENT_TEST(send_coalesce_disabled)
+{
+	std::cout << "\n === test send_coalesce_bytes 0 ===\n" << std::endl;
+	std::vector<int> const first_write = cancel_burst(0);
+	TEST_EQUAL(first_write.size(), 1);
+}
+
+// messages are held back until send_coalesce_bytes have accumulated. The
+// message that crosses the threshold flushes all of them
+TORRENT_TEST(send_coalesce_threshold)
+{
+	std::cout << "\n === test send_coalesce_bytes threshold ===\n" << std::endl;
+	std::vector<int> const first_write = cancel_burst(40);
+	TEST_CHECK(first_write.size() > 1);
+	if (first_write.empty()) return;
+	int const bytes = std::accumulate(first_write.begin(), first_write.end(), 0);
+	TEST_CHECK(bytes >= 40);
+	TEST_CHECK(bytes - first_write.back() < 40);
+}
+
+TORRENT_TEST(send_coalesce_round)
+{
+	std::cout << "\n === test send_coalesce_bytes end of round ===\n" << std::endl;
+	std::vector<int> const first_write = cancel_burst(1024 * 1024);
+	TEST_CHECK(first_write.size() >= 3);
+}
+#endif
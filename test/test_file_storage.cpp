@@ -775,6 +775,30 @@ TORRENT_TEST(query_symlinks)
 	TEST_CHECK(ret3 != ret4);
 }
 
+TORRENT_TEST(many_directories)
+{
+	// files are not ordered by directory, every file refers to a path that
+	// was added long before it
+	file_storage fs;
+	fs.set_piece_length(1024);
+	int const num_dirs = 1000;
+	for (int i = 0; i < 10 * num_dirs; ++i)
+	{
+		char path[100];
+		std::snprintf(path, sizeof(path), "test/%d/%d", i % num_dirs, i);
+		fs.add_file(path, 1);
+	}
+	TEST_EQUAL(int(fs.paths().size()), num_dirs);
+	TEST_EQUAL(fs.file_path(file_index_t{1234}), combine_path("test", combine_path("234", "1234")));
+
+	// paths are still found after the file_storage has been copied
+	file_storage fs2 = fs;
+	fs2.add_file("test/17/x", 1);
+	TEST_EQUAL(int(fs2.paths().size()), num_dirs);
+	fs2.add_file("test/new/x", 1);
+	TEST_EQUAL(int(fs2.paths().size()), num_dirs + 1);
+}
+
 // TODO: test file attributes
 // TODO: test symlinks
 // TODO: test reorder_file (make sure internal_file_entry::swap() is used)
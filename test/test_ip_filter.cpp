@@ -39,6 +39,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/socket_io.hpp"
 #include "libtorrent/session.hpp"
 
+#include <random>
+
 /*
 
 Currently this test only tests that the filter can handle
@@ -259,3 +261,137 @@ TORRENT_TEST(ip_filter)
 	TEST_CHECK(pf.access(6881) == 0);
 	TEST_CHECK(pf.access(65535) == 0);
 }
+
+namespace {
+
+address_v4 random_v4(std::mt19937& rng)
+{
+	return address_v4(std::uint32_t(rng()));
+}
+
+address_v6 random_v6(std::mt19937& rng)
+{
+	address_v6::bytes_type b;
+	for (auto& c : b) c = static_cast<unsigned char>(rng());
+	// cluster the addresses, to make ranges overlap
+	b[0] = b[1] = 0;
+	return address_v6(b);
+}
+
+// adds num narrow ranges, like the ones found in blocklists
+template <typename Addr>
+void add_random_rules(ip_filter& f, std::mt19937& rng, int const num
+	, Addr (*random_addr)(std::mt19937&))
+{
+	for (int i = 0; i < num; ++i)
+	{
+		Addr const a = random_addr(rng);
+		auto b = a.to_bytes();
+		b[b.size() - 2] |= static_cast<unsigned char>(rng() % 16);
+		b[b.size() - 1] = 0xff;
+		f.add_rule(a, Addr(b), rng() % 3 == 0 ? 0 : ip_filter::blocked);
+	}
+}
+
+template <typename Addr>
+void test_compiled(ip_filter const& f, ip_filter const& compiled
+	, std::vector<ip_range<Addr>> const& ranges, std::mt19937& rng
+	, Addr (*random_addr)(std::mt19937&))
+{
+	for (auto const& r : ranges)
+	{
+		TEST_EQUAL(compiled.access(r.first), r.flags);
+		TEST_EQUAL(compiled.access(r.last), r.flags);
+	}
+	for (int i = 0; i < 10000; ++i)
+	{
+		Addr const a = random_addr(rng);
+		TEST_EQUAL(compiled.access(a), f.access(a));
+	}
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(compiled_ip_filter)
+{
+	std::mt19937 rng(0x1337);
+	ip_filter f;
+
+	// an empty filter compiles too
+	{
+		ip_filter compiled = f;
+		compiled.compile();
+		TEST_EQUAL(compiled.access(addr("1.2.3.4")), 0);
+		TEST_EQUAL(compiled.access(addr("::1")), 0);
+	}
+
+	add_random_rules<address_v4>(f, rng, 3000, &random_v4);
+	add_random_rules<address_v6>(f, rng, 3000, &random_v6);
+
+	ip_filter compiled = f;
+	compiled.compile();
+	TEST_CHECK(compiled.export_filter() == f.export_filter());
+
+	test_compiled(f, compiled, std::get<0>(f.export_filter()), rng, &random_v4);
+	test_compiled(f, compiled, std::get<1>(f.export_filter()), rng, &random_v6);
+
+	// adding a rule to a compiled filter takes effect immediately
+	compiled.add_rule(addr("1.2.3.4"), addr("1.2.3.4"), ip_filter::blocked);
+	compiled.add_rule(addr("1.2.3.5"), addr("1.2.3.5"), 0);
+	TEST_EQUAL(compiled.access(addr("1.2.3.4")), ip_filter::blocked);
+	TEST_EQUAL(compiled.access(addr("1.2.3.5")), 0);
+	f.add_rule(addr("1.2.3.4"), addr("1.2.3.4"), ip_filter::blocked);
+	f.add_rule(addr("1.2.3.5"), addr("1.2.3.5"), 0);
+
+	// more rules than are kept on the side of the compiled form, including
+	// ranges overlapping earlier ones
+	for (int i = 0; i < 100; ++i)
+	{
+		ip_filter* filters[] = {&f, &compiled};
+		address_v4 const a = random_v4(rng);
+		auto b = a.to_bytes();
+		b[2] = 0xff;
+		std::uint32_t const flags = i % 2 ? 0 : ip_filter::blocked;
+		for (ip_filter* filter : filters)
+		{
+			filter->add_rule(a, address_v4(b), flags);
+			filter->add_rule(a, a, flags ^ ip_filter::blocked);
+		}
+
+		// first while the added rules are kept on the side, then after the
+		// compiled form has been discarded
+		if (i == 10 || i == 99)
+			test_compiled(f, compiled, std::get<0>(f.export_filter()), rng, &random_v4);
+	}
+}
+
+TORRENT_TEST(ip_filter_should_compile)
+{
+	ip_filter f;
+	f.add_rule(addr("10.0.0.0"), addr("10.255.255.255"), ip_filter::blocked);
+	TEST_CHECK(!f.should_compile());
+	f.compile();
+	TEST_CHECK(!f.should_compile());
+
+	// banning peers one at a time. Once half the rules that can be kept on
+	// the side have been added, the filter should be compiled again
+	int bans = 0;
+	while (!f.should_compile())
+	{
+		address_v4 const a(std::uint32_t(0x01020300 + bans));
+		f.add_rule(a, a, ip_filter::blocked);
+		++bans;
+		TEST_CHECK(bans < 1000);
+		if (bans >= 1000) break;
+	}
+	TEST_EQUAL(bans, 32);
+
+	// a copy compiled on another thread replaces it
+	ip_filter copy = f;
+	copy.compile();
+	TEST_CHECK(!copy.should_compile());
+	TEST_CHECK(copy.export_filter() == f.export_filter());
+	TEST_EQUAL(copy.access(addr("1.2.3.0")), ip_filter::blocked);
+	TEST_EQUAL(copy.access(addr("1.2.3.31")), ip_filter::blocked);
+	TEST_EQUAL(copy.access(addr("1.2.3.32")), 0);
+}
@@ -32,11 +32,14 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <algorithm>
 #include <iostream>
+#include <array>
+#include <cstring>
 
 #include "libtorrent/hasher.hpp"
 #include "libtorrent/pe_crypto.hpp"
 #include "libtorrent/random.hpp"
 #include "libtorrent/span.hpp"
+#include "libtorrent/time.hpp"
 
 #include "test.hpp"
 
@@ -135,6 +138,58 @@ TORRENT_TEST(diffie_hellman)
 	}
 }
 
+TORRENT_TEST(dh_thread_pool)
+{
+	using namespace lt;
+
+	io_service ios;
+	dh_thread_pool pool(ios);
+	pool.set_pool_size(4);
+	pool.set_num_threads(2);
+	TEST_EQUAL(pool.num_threads(), 2);
+
+	// the threads fill up the pool of key pairs
+	time_point const start = clock_type::now();
+	while (pool.num_keypairs() < 4 && clock_type::now() - start < seconds(20))
+	{
+		ios.reset();
+		ios.run_one();
+	}
+	TEST_EQUAL(pool.num_keypairs(), 4);
+
+	std::shared_ptr<dh_key_exchange> kx1 = pool.get_keypair();
+	std::shared_ptr<dh_key_exchange> kx2 = pool.get_keypair();
+	TEST_EQUAL(pool.num_keypairs(), 2);
+	TEST_CHECK(kx1->get_local_key() != kx2->get_local_key());
+
+	int done = 0;
+	pool.async_compute_secret(kx1, export_key(kx2->get_local_key()), [&done] { ++done; });
+	pool.async_compute_secret(kx2, export_key(kx1->get_local_key()), [&done] { ++done; });
+	while (done < 2 && clock_type::now() - start < seconds(20))
+	{
+		ios.reset();
+		ios.run_one();
+	}
+	TEST_EQUAL(done, 2);
+	TEST_EQUAL(kx1->get_secret(), kx2->get_secret());
+	TEST_CHECK(kx1->get_hash_xor_mask() == kx2->get_hash_xor_mask());
+
+	// without threads, key pairs are generated on the calling thread
+	pool.set_num_threads(0);
+	TEST_EQUAL(pool.num_threads(), 0);
+	ios.reset();
+	ios.poll();
+	int const keypairs = pool.num_keypairs();
+	for (int i = 0; i < keypairs + 2; ++i)
+		TEST_CHECK(pool.get_keypair());
+	TEST_EQUAL(pool.num_keypairs(), 0);
+
+	// aborting drops the jobs refilling the pool
+	pool.set_num_threads(1);
+	pool.abort();
+	TEST_EQUAL(pool.num_threads(), 0);
+}
+
 TORRENT_TEST(rc4)
 {
 	using namespace lt;
@@ -152,6 +207,54 @@ TORRENT_TEST(rc4)
 	test_enc_handler(rc41, rc42);
 }
 
+TORRENT_TEST(chacha20)
+{
+	using namespace lt;
+
+	std::array<char, 32> key1;
+	std::array<char, 32> key2;
+	aux::random_bytes(key1);
+	aux::random_bytes(key2);
+
+	chacha20_handler c1;
+	c1.set_incoming_key(key2);
+	c1.set_outgoing_key(key1);
+	chacha20_handler c2;
+	c2.set_incoming_key(key1);
+	c2.set_outgoing_key(key2);
+	test_enc_handler(c1, c2);
+}
+
+TORRENT_TEST(chacha20_test_vector)
+{
+	using namespace lt;
+
+	// RFC 8439 appendix A.1, test vectors 1 and 2. The all-zero key and nonce,
+	// at block counter 0 and 1
+	std::uint8_t const expected[128] = {
+		0x76, 0xb8, 0xe0, 0xad, 0xa0, 0xf1, 0x3d, 0x90, 0x40, 0x5d, 0x6a, 0xe5, 0x53, 0x86, 0xbd, 0x28,
+		0xbd, 0xd2, 0x19, 0xb8, 0xa0, 0x8d, 0xed, 0x1a, 0xa8, 0x36, 0xef, 0xcc, 0x8b, 0x77, 0x0d, 0xc7,
+		0xda, 0x41, 0x59, 0x7c, 0x51, 0x57, 0x48, 0x8d, 0x77, 0x24, 0xe0, 0x3f, 0xb8, 0xd8, 0x4a, 0x37,
+		0x6a, 0x43, 0xb8, 0xf4, 0x15, 0x18, 0xa1, 0x1c, 0xc3, 0x87, 0xb6, 0x69, 0xb2, 0xee, 0x65, 0x86,
+		0x9f, 0x07, 0xe7, 0xbe, 0x55, 0x51, 0x38, 0x7a, 0x98, 0xba, 0x97, 0x7c, 0x73, 0x2d, 0x08, 0x0d,
+		0xcb, 0x0f, 0x29, 0xa0, 0x48, 0xe3, 0x65, 0x69, 0x12, 0xc6, 0x53, 0x3e, 0x32, 0xee, 0x7a, 0xed,
+		0x29, 0xb7, 0x21, 0x76, 0x9c, 0xe6, 0x4e, 0x43, 0xd5, 0x71, 0x33, 0xb0, 0x74, 0xd8, 0x39, 0xd5,
+		0x31, 0xed, 0x1f, 0x28, 0x51, 0x0a, 0xfb, 0x45, 0xac, 0xe1, 0x0a, 0x1f, 0x4b, 0x79, 0x4d, 0x6f,
+	};
+
+	std::array<char, 32> const key{};
+	chacha20_handler c;
+	c.set_outgoing_key(key);
+
+	// encrypt zeroes, split over buffers that don't line up with blocks, to
+	// get the keystream
+	std::array<char, 128> buf{};
+	span<char> bufs[] = {span<char>(buf).first(5), span<char>(buf).subspan(5, 70)
+		, span<char>(buf).subspan(75)};
+	c.encrypt(bufs);
+	TEST_CHECK(std::memcmp(buf.data(), expected, sizeof(expected)) == 0);
+}
+
 #else
 TORRENT_TEST(disabled)
 {
@@ -0,0 +1,148 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "test.hpp"
+#include "libtorrent/performance_counters.hpp"
+
+#include <thread>
+#include <vector>
+
+using namespace lt;
+
+namespace {
+
+constexpr int num_threads = 16;
+
+template <typename Fun>
+void run_threads(Fun f)
+{
+	std::vector<std::thread> threads;
+	for (int t = 0; t < num_threads; ++t)
+		threads.emplace_back(f);
+	for (auto& t : threads) t.join();
+}
+
+}
+
+TORRENT_TEST(concurrent_increments)
+{
+	counters c;
+	run_threads([&c]
+	{
+		for (int i = 0; i < 10000; ++i)
+		{
+			c.inc_stats_counter(counters::num_read_ops);
+			c.inc_stats_counter(counters::num_running_disk_jobs, 1);
+			c.inc_stats_counter(counters::num_running_disk_jobs, -1);
+		}
+	});
+
+	TEST_EQUAL(c[counters::num_read_ops], num_threads * 10000);
+	TEST_EQUAL(c[counters::num_running_disk_jobs], 0);
+}
+
+TORRENT_TEST(gauge_across_threads)
+{
+	counters c;
+	// a gauge incremented by one thread and decremented by another sums up
+	// correctly
+	std::thread([&c] { c.inc_stats_counter(counters::queued_write_bytes, 100); }).join();
+	std::thread([&c] { c.inc_stats_counter(counters::queued_write_bytes, -40); }).join();
+	TEST_EQUAL(c[counters::queued_write_bytes], 60);
+
+	c.set_value(counters::queued_write_bytes, 10);
+	TEST_EQUAL(c[counters::queued_write_bytes], 10);
+
+	std::thread([&c] { c.set_value(counters::queued_write_bytes, 5); }).join();
+	TEST_EQUAL(c[counters::queued_write_bytes], 5);
+
+	c.blend_stats_counter(counters::request_latency, 100, 50);
+	TEST_EQUAL(c[counters::request_latency], 50);
+}
+
+TORRENT_TEST(copy)
+{
+	counters c;
+	std::thread([&c] { c.inc_stats_counter(counters::num_read_ops, 3); }).join();
+	c.inc_stats_counter(counters::num_read_ops, 4);
+
+	counters c2(c);
+	TEST_EQUAL(c2[counters::num_read_ops], 7);
+
+	counters c3;
+	c3.inc_stats_counter(counters::num_write_ops);
+	c3 = c;
+	TEST_EQUAL(c3[counters::num_read_ops], 7);
+	TEST_EQUAL(c3[counters::num_write_ops], 0);
+}
+
+TORRENT_TEST(latency_buckets)
+{
+	TEST_EQUAL(counters::latency_bucket(0), 0);
+	TEST_EQUAL(counters::latency_bucket(-10), 0);
+	TEST_EQUAL(counters::latency_bucket(127), 0);
+	TEST_EQUAL(counters::latency_bucket(128), 1);
+	TEST_EQUAL(counters::latency_bucket(191), 1);
+	TEST_EQUAL(counters::latency_bucket(192), 2);
+	TEST_EQUAL(counters::latency_bucket(255), 2);
+	TEST_EQUAL(counters::latency_bucket(256), 3);
+	TEST_EQUAL(counters::latency_bucket(384), 4);
+	TEST_EQUAL(counters::latency_bucket((1 << 20) - 1), counters::num_latency_buckets - 2);
+	TEST_EQUAL(counters::latency_bucket(1 << 20), counters::num_latency_buckets - 1);
+	TEST_EQUAL(counters::latency_bucket(std::int64_t(1) << 40), counters::num_latency_buckets - 1);
+
+	// the buckets are monotonic
+	int prev = 0;
+	for (std::int64_t us = 0; us < (1 << 21); us += 7)
+	{
+		int const b = counters::latency_bucket(us);
+		TEST_CHECK(b == prev || b == prev + 1);
+		prev = b;
+	}
+}
+
+TORRENT_TEST(latency_histogram)
+{
+	counters c;
+	c.add_latency_sample(counters::dht_rpc_latency, 50);
+	c.add_latency_sample(counters::dht_rpc_latency, 200);
+	c.add_latency_sample(counters::dht_rpc_latency, 210);
+	c.add_latency_sample(counters::dht_rpc_latency, 5000000);
+
+	TEST_EQUAL(c[counters::dht_rpc_latency], 1);
+	TEST_EQUAL(c[counters::dht_rpc_latency + 2], 2);
+	TEST_EQUAL(c[counters::dht_rpc_latency_last], 1);
+
+	// neighbouring histograms are not affected
+	TEST_EQUAL(c[counters::disk_other_latency_last], 0);
+	TEST_EQUAL(c[counters::on_tick_latency], 0);
+}
@@ -31,6 +31,7 @@ POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "libtorrent/piece_picker.hpp"
+#include "libtorrent/aux_/have_bitfield.hpp"
 #include "libtorrent/torrent_peer.hpp"
 #include "libtorrent/bitfield.hpp"
 #include "libtorrent/performance_counters.hpp"
@@ -1601,6 +1602,80 @@ TORRENT_TEST(piece_passed_causing_we_have)
 	TEST_EQUAL(p->have().num_pieces, 2);
 }
 
+TORRENT_TEST(first_wanted_piece)
+{
+	// pieces 0 and 2 we have, piece 4 is filtered
+	auto p = setup_picker("1111111", "* *    ", "1111011", "");
+
+	TEST_EQUAL(p->first_wanted_piece(string2vec("*******")), piece_index_t(1));
+	TEST_EQUAL(p->first_wanted_piece(string2vec("* * *  ")), piece_index_t(-1));
+	TEST_EQUAL(p->first_wanted_piece(string2vec("      *")), piece_index_t(6));
+
+	// a piece that passed the hash check but isn't written yet is not wanted
+	p->mark_as_finished({piece_index_t(3), 0}, &tmp1);
+	p->piece_passed(piece_index_t(3));
+	TEST_EQUAL(p->first_wanted_piece(string2vec("   *   ")), piece_index_t(-1));
+
+	// unless the write fails
+	p->mark_as_writing({piece_index_t(3), 1}, &tmp1);
+	p->write_failed({piece_index_t(3), 1});
+	TEST_EQUAL(p->first_wanted_piece(string2vec("   *   ")), piece_index_t(3));
+
+	// unfiltering a piece makes it wanted again
+	p->set_piece_priority(piece_index_t(4), default_priority);
+	TEST_EQUAL(p->first_wanted_piece(string2vec("* * *  ")), piece_index_t(4));
+
+	// filtering and then unfiltering a piece we have keeps it not wanted
+	p->set_piece_priority(piece_index_t(0), dont_download);
+	p->set_piece_priority(piece_index_t(0), default_priority);
+	TEST_EQUAL(p->first_wanted_piece(string2vec("*      ")), piece_index_t(-1));
+
+	p->we_dont_have(piece_index_t(0));
+	TEST_EQUAL(p->first_wanted_piece(string2vec("*      ")), piece_index_t(0));
+
+	p->we_have_all();
+	TEST_EQUAL(p->first_wanted_piece(string2vec("*******")), piece_index_t(-1));
+}
+
+// picking from the pieces of a peer in any form gives the same blocks as
+// picking from the equivalent bitfield
+TORRENT_TEST(pick_pieces_have_bitfield)
+{
+	std::string const avail(64, '1');
+	std::string have(64, ' ');
+	have[3] = '*';
+	std::string prio(64, '1');
+	prio[5] = '0';
+	auto p = setup_picker(avail.c_str(), have.c_str(), prio.c_str(), "");
+
+	auto const test_form = [&](aux::have_bitfield const& pieces
+		, aux::have_bitfield::form_t const form)
+	{
+		TEST_CHECK(pieces.form() == form);
+		counters pc;
+		std::vector<piece_block> expected;
+		p->pick_pieces(pieces.to_bitfield(), expected, 20 * blocks_per_piece, 0
+			, nullptr, piece_picker::sequential, empty_vector, 20, pc);
+		std::vector<piece_block> picked;
+		p->pick_pieces(pieces, picked, 20 * blocks_per_piece, 0
+			, nullptr, piece_picker::sequential, empty_vector, 20, pc);
+		TEST_CHECK(!picked.empty());
+		TEST_CHECK(picked == expected);
+		TEST_CHECK(verify_pick(p, picked));
+	};
+
+	// a seed
+	test_form(aux::have_bitfield(64, true), aux::have_bitfield::form_t::all);
+
+	aux::have_bitfield pieces(64, false);
+	pieces.set_bit(piece_index_t(2));
+	pieces.set_bit(piece_index_t(40));
+	test_form(pieces, aux::have_bitfield::form_t::sparse);
+
+	for (int i = 0; i < 64; i += 3) pieces.set_bit(piece_index_t(i));
+	test_form(pieces, aux::have_bitfield::form_t::dense);
+}
+
 TORRENT_TEST(break_one_seed)
 {
 	auto p = setup_picker("0000000", "*      ", "", "0700000");
@@ -323,3 +323,152 @@ TORRENT_TEST(round_trip_flags)
 		test_roundtrip(atp);
 	}
 }
+
+namespace {
+
+tcp::endpoint ep(char const* ip, int port)
+{
+	return tcp::endpoint(make_address(ip), std::uint16_t(port));
+}
+
+add_torrent_params full_resume_data()
+{
+	add_torrent_params atp;
+	atp.ti = generate_torrent();
+	atp.info_hash = atp.ti->info_hash();
+	atp.save_path = "/save/path";
+	atp.storage_mode = storage_mode_allocate;
+	atp.flags = torrent_flags::paused | torrent_flags::sequential_download
+		| torrent_flags::disable_pex;
+	atp.total_uploaded = 1337;
+	atp.total_downloaded = 1338;
+	atp.active_time = 1339;
+	atp.seeding_time = 1340;
+	atp.finished_time = 1341;
+	atp.added_time = 1342;
+	atp.completed_time = 1343;
+	atp.last_seen_complete = 1344;
+	atp.num_complete = 5;
+	atp.num_incomplete = 6;
+	atp.num_downloaded = 7;
+	atp.max_connections = 1345;
+	atp.upload_limit = 1346;
+	atp.download_limit = 1347;
+	atp.have_pieces = bits<piece_index_t>();
+	atp.verified_pieces = bits<piece_index_t>();
+	atp.piece_priorities = vec<download_priority_t>();
+	atp.file_priorities = {low_priority, dont_download, top_priority};
+	atp.unfinished_pieces = std::map<piece_index_t, bitfield>{{piece_index_t{42}, bits()}};
+	atp.renamed_files[file_index_t{1}] = "renamed";
+	atp.trackers = {"http://tracker1.com/announce", "udp://tracker2.com:1337"};
+	atp.tracker_tiers = {0, 1};
+	atp.url_seeds = {"http://url_seed.com/"};
+	atp.http_seeds = {"http://http_seed.com/"};
+	atp.peers.push_back(ep("1.2.3.4", 6881));
+	atp.peers.push_back(ep("2000::1", 6882));
+	atp.banned_peers.push_back(ep("5.6.7.8", 6883));
+	atp.banned_peers.push_back(ep("2000::2", 6884));
+	return atp;
+}
+
+}
+
+TORRENT_TEST(binary_round_trip)
+{
+	add_torrent_params const atp = full_resume_data();
+
+	std::vector<char> const bin = write_resume_data_binary(atp);
+	error_code ec;
+	add_torrent_params const out = read_resume_data_binary(bin, ec);
+	TEST_CHECK(!ec);
+	TEST_CHECK(write_resume_data_binary(out) == bin);
+
+	TEST_EQUAL(out.info_hash, atp.info_hash);
+	TEST_CHECK(out.ti);
+	TEST_EQUAL(out.ti->info_hash(), atp.info_hash);
+	TEST_EQUAL(out.save_path, "/save/path");
+	TEST_EQUAL(out.storage_mode, storage_mode_allocate);
+	TEST_EQUAL(out.total_downloaded, 1338);
+	TEST_EQUAL(out.last_seen_complete, 1344);
+	TEST_EQUAL(out.download_limit, 1347);
+	TEST_EQUAL(out.have_pieces.count(), 3);
+	TEST_EQUAL(out.verified_pieces.count(), 3);
+	TEST_EQUAL(out.unfinished_pieces.size(), 1);
+	TEST_CHECK(out.piece_priorities == atp.piece_priorities);
+	TEST_CHECK(out.file_priorities == atp.file_priorities);
+	TEST_CHECK(out.renamed_files == atp.renamed_files);
+	TEST_CHECK(out.trackers == atp.trackers);
+	TEST_CHECK(out.tracker_tiers == atp.tracker_tiers);
+	TEST_CHECK(out.url_seeds == atp.url_seeds);
+	TEST_CHECK(out.http_seeds == atp.http_seeds);
+	TEST_CHECK(out.peers == atp.peers);
+	TEST_CHECK(out.banned_peers == atp.banned_peers);
+	TEST_CHECK(out.flags & torrent_flags::paused);
+	TEST_CHECK(out.flags & torrent_flags::sequential_download);
+	TEST_CHECK(out.flags & torrent_flags::override_trackers);
+	TEST_CHECK(!(out.flags & torrent_flags::auto_managed));
+
+	// read_resume_data() recognizes the binary format
+	add_torrent_params const out2 = read_resume_data(bin, ec);
+	TEST_CHECK(!ec);
+	TEST_CHECK(write_resume_data_binary(out2) == bin);
+}
+
+TORRENT_TEST(binary_convert)
+{
+	// go through read_resume_data() once, to get the bencoded form in its
+	// canonical shape
+	std::vector<char> const bencoded = write_resume_data_buf(
+		read_resume_data(write_resume_data_buf(full_resume_data())));
+
+	error_code ec;
+	std::vector<char> const bin = resume_data_to_binary(bencoded, ec);
+	TEST_CHECK(!ec);
+	TEST_CHECK(aux::is_binary_resume_data(bin));
+	TEST_CHECK(bin.size() < bencoded.size());
+
+	std::vector<char> const back = resume_data_to_bencoded(bin, ec);
+	TEST_CHECK(!ec);
+	TEST_CHECK(back == bencoded);
+
+	// the bencoded form is not accepted by the binary reader
+	read_resume_data_binary(bencoded, ec);
+	TEST_EQUAL(ec, error_code(errors::invalid_file_tag));
+}
+
+TORRENT_TEST(binary_invalid)
+{
+	std::vector<char> bin = write_resume_data_binary(full_resume_data());
+
+	// truncating the buffer anywhere must not read out of bounds. Cutting
+	// into the header or a record is an error
+	for (std::size_t len = 0; len < bin.size(); ++len)
+	{
+		error_code ec;
+		read_resume_data_binary({bin.data(), std::ptrdiff_t(len)}, ec);
+		if (len < 8) TEST_EQUAL(ec, error_code(errors::invalid_file_tag));
+	}
+
+	error_code ec;
+	read_resume_data_binary({bin.data(), std::ptrdiff_t(bin.size() - 1)}, ec);
+	TEST_EQUAL(ec, error_code(errors::invalid_resume_data));
+
+	// a newer version we can't read
+	std::vector<char> newer = bin;
+	newer[7] = 2;
+	read_resume_data_binary(newer, ec);
+	TEST_EQUAL(ec, error_code(errors::invalid_file_tag));
+
+	// unknown records are skipped
+	std::vector<char> unknown = bin;
+	unknown.insert(unknown.end(), {char(200), 0, 0, 0, 3, 'a', 'b', 'c'});
+	ec.clear();
+	add_torrent_params const atp = read_resume_data_binary(unknown, ec);
+	TEST_CHECK(!ec);
+	TEST_CHECK(write_resume_data_binary(atp) == bin);
+
+	// the info-hash is required
+	std::vector<char> const no_ih = {'L', 'T', 'R', 'B', 0, 0, 0, 1};
+	read_resume_data_binary(no_ih, ec);
+	TEST_EQUAL(ec, error_code(errors::missing_info_hash));
+}
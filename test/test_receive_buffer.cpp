@@ -74,6 +74,24 @@ TORRENT_TEST(recv_buffer_pos_at_end_true)
 	TEST_EQUAL(b.pos_at_end(), true);
 }
 
+TORRENT_TEST(recv_buffer_bytes_pending)
+{
+	receive_buffer b;
+	b.cut(0, 10);
+	b.reserve(30);
+	b.received(30);
+	TEST_EQUAL(b.bytes_pending(), 30);
+
+	TEST_EQUAL(b.advance_pos(30), 10);
+	TEST_EQUAL(b.bytes_pending(), 20);
+
+	// the read cursor is relative to the start of the current packet
+	b.cut(10, 20);
+	TEST_EQUAL(b.bytes_pending(), 20);
+	TEST_EQUAL(b.advance_pos(20), 20);
+	TEST_EQUAL(b.bytes_pending(), 0);
+}
+
 TORRENT_TEST(recv_buffer_packet_finished)
 {
 	receive_buffer b;
@@ -91,6 +109,34 @@ TORRENT_TEST(recv_buffer_packet_finished)
 	TEST_EQUAL(b.packet_finished(), true);
 }
 
+TORRENT_TEST(recv_buffer_rewind)
+{
+	receive_buffer b;
+	b.cut(0, 10);
+	span<char> const buf = b.reserve(30);
+	for (int i = 0; i < 30; ++i) buf[i] = char(i);
+	b.received(30);
+
+	// the first packet, followed by bytes that can't be handled yet
+	TEST_EQUAL(b.advance_pos(30), 10);
+	TEST_EQUAL(b.advance_pos(20), 10);
+	TEST_EQUAL(b.pos(), 20);
+
+	// hand out the bytes past the first packet again
+	b.rewind(10);
+	TEST_EQUAL(b.pos(), 10);
+	TEST_CHECK(b.packet_finished());
+
+	b.reset(20);
+	TEST_EQUAL(b.pos(), 0);
+	TEST_EQUAL(b.advance_pos(20), 20);
+	TEST_CHECK(b.packet_finished());
+	b.normalize();
+	TEST_CHECK(b.pos_at_end());
+	TEST_EQUAL(b.get()[0], 10);
+	TEST_EQUAL(b.get()[19], 29);
+}
+
 TORRENT_TEST(recv_buffer_grow_floor)
 {
 	receive_buffer b;
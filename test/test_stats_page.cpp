@@ -0,0 +1,127 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "test.hpp"
+#include "libtorrent/aux_/stats_page.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/error_code.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+using namespace lt;
+
+namespace {
+
+std::vector<char> read_file(char const* path)
+{
+	std::ifstream f(path, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(f)
+		, std::istreambuf_iterator<char>());
+}
+
+}
+
+#if TORRENT_HAVE_MMAP
+TORRENT_TEST(stats_page_roundtrip)
+{
+	counters c;
+	c.inc_stats_counter(counters::on_tick_counter, 3);
+	c.inc_stats_counter(counters::sent_bytes, 1337);
+	c.set_value(counters::num_peers_connected, 42);
+
+	aux::stats_page page;
+	error_code ec;
+	page.open("stats_page.bin", ec);
+	TEST_CHECK(!ec);
+	TEST_CHECK(page.is_open());
+
+	// before the first update, all counters are 0
+	std::vector<std::int64_t> values;
+	std::vector<char> buf = read_file("stats_page.bin");
+	TEST_CHECK(aux::stats_page::read(buf, values));
+	TEST_EQUAL(int(values.size()), counters::num_counters);
+	TEST_EQUAL(values[counters::sent_bytes], 0);
+
+	page.update(c);
+	buf = read_file("stats_page.bin");
+	TEST_CHECK(aux::stats_page::read(buf, values));
+	TEST_EQUAL(int(values.size()), counters::num_counters);
+	TEST_EQUAL(values[counters::on_tick_counter], 3);
+	TEST_EQUAL(values[counters::sent_bytes], 1337);
+	TEST_EQUAL(values[counters::num_peers_connected], 42);
+
+	c.inc_stats_counter(counters::sent_bytes, 1);
+	page.update(c);
+	buf = read_file("stats_page.bin");
+	TEST_CHECK(aux::stats_page::read(buf, values));
+	TEST_EQUAL(values[counters::sent_bytes], 1338);
+
+	page.close();
+	TEST_CHECK(!page.is_open());
+}
+#endif
+
+TORRENT_TEST(stats_page_invalid)
+{
+	std::vector<std::int64_t> values;
+
+	// too short for the header
+	std::vector<char> buf(10, 0);
+	TEST_CHECK(!aux::stats_page::read(buf, values));
+
+	// wrong magic
+	buf.resize(std::size_t(aux::stats_page::header_size), 0);
+	TEST_CHECK(!aux::stats_page::read(buf, values));
+
+#if TORRENT_HAVE_MMAP
+	counters c;
+	aux::stats_page page;
+	error_code ec;
+	page.open("stats_page.bin", ec);
+	TEST_CHECK(!ec);
+	page.update(c);
+	page.close();
+
+	// truncated counter array
+	buf = read_file("stats_page.bin");
+	TEST_CHECK(aux::stats_page::read(buf, values));
+	buf.resize(buf.size() - 8);
+	TEST_CHECK(!aux::stats_page::read(buf, values));
+
+	// written with a different set of counters
+	buf = read_file("stats_page.bin");
+	buf[20] ^= 0x55;
+	TEST_CHECK(!aux::stats_page::read(buf, values));
+#endif
+}
@@ -1539,3 +1539,68 @@ TORRENT_TEST(dont_move_intermingled_files)
 	TEST_CHECK(!exists(combine_path(test_path, combine_path("temp_storage"
 		, combine_path("_folder3", "alien_folder1")))));
 }
+
+TORRENT_TEST(async_write_disk_buffer)
+{
+	std::string const test_path = current_working_directory();
+	error_code ec;
+	remove_all(combine_path(test_path, "temp_storage"), ec);
+
+	file_storage fs;
+	fs.add_file("temp_storage/test1.tmp", default_block_size);
+	fs.set_piece_length(default_block_size);
+	fs.set_num_pieces(1);
+
+	boost::asio::io_service ios;
+	counters cnt;
+	aux::session_settings sett;
+	sett.set_int(settings_pack::aio_threads, 1);
+	disk_io_thread io(ios, sett, cnt);
+
+	aux::vector<download_priority_t, file_index_t> priorities;
+	sha1_hash info_hash;
+	storage_params p{
+		fs,
+		nullptr,
+		test_path,
+		storage_mode_sparse,
+		priorities,
+		info_hash
+	};
+	auto st = io.new_torrent(default_storage_constructor, std::move(p)
+		, std::shared_ptr<void>());
+
+	std::vector<char> const block = new_piece(default_block_size);
+	peer_request const r{piece_index_t(0), 0, default_block_size};
+
+	// the block is received straight into a disk buffer, which is then handed
+	// over to the disk thread as-is
+	bool exceeded = false;
+	disk_buffer_holder buffer = io.allocate_disk_buffer(exceeded
+		, std::shared_ptr<disk_observer>(), "receive buffer");
+	TEST_CHECK(buffer);
+	TEST_CHECK(!exceeded);
+	std::memcpy(buffer.data(), block.data(), block.size());
+
+	bool done = false;
+	io.async_write(st, r, std::move(buffer), [&](storage_error const& e)
+	{
+		TEST_CHECK(!e.ec);
+		done = true;
+	});
+	io.submit_jobs();
+	run_until(ios, done);
+
+	done = false;
+	io.async_read(st, r, [&](disk_buffer_holder h, disk_job_flags_t, storage_error const& e)
+	{
+		TEST_CHECK(!e.ec);
+		TEST_CHECK(h);
+		if (h) TEST_CHECK(std::equal(block.begin(), block.end(), h.data()));
+		done = true;
+	});
+	io.submit_jobs();
+	run_until(ios, done);
+
+	io.abort(true);
+}
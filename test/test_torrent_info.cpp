@@ -1120,6 +1120,68 @@ TORRENT_TEST(copy)
 	}
 }
 
+TORRENT_TEST(map_file)
+{
+	std::string const filename = combine_path(parent_path(current_working_directory())
+		, combine_path("test_torrents", "sample.torrent"));
+
+	torrent_info const a(filename);
+
+	load_torrent_limits cfg;
+	cfg.map_file = true;
+	auto b = std::make_shared<torrent_info>(filename, cfg);
+
+	TEST_EQUAL(a.info_hash(), b->info_hash());
+	TEST_EQUAL(a.metadata_size(), b->metadata_size());
+	TEST_CHECK(std::memcmp(a.metadata().get(), b->metadata().get()
+		, std::size_t(a.metadata_size())) == 0);
+	TEST_EQUAL(a.num_files(), b->num_files());
+	for (auto const i : a.files().file_range())
+	{
+		TEST_EQUAL(a.files().file_path(i), b->files().file_path(i));
+		TEST_EQUAL(a.files().hash(i), b->files().hash(i));
+	}
+	TEST_EQUAL(a.hash_for_piece(piece_index_t{0}), b->hash_for_piece(piece_index_t{0}));
+
+	// a copy does not refer to the mapped file
+	torrent_info const c(*b);
+	b.reset();
+	TEST_EQUAL(c.info_hash(), a.info_hash());
+	TEST_EQUAL(c.files().file_path(file_index_t{2}), a.files().file_path(file_index_t{2}));
+
+	cfg.max_buffer_size = 10;
+	TEST_THROW(torrent_info(filename, cfg));
+	cfg.max_buffer_size = 10000000;
+	TEST_THROW(torrent_info("non-existent.torrent", cfg));
+}
+
+TORRENT_TEST(path_index_after_load)
+{
+	file_storage fs;
+	fs.add_file("test/a/1", 0x4000);
+	fs.add_file("test/b/2", 0x4000);
+	fs.add_file("test/a/3", 0x4000);
+	lt::create_torrent t(fs, 0x4000);
+	sha1_hash ph;
+	for (auto const i : fs.piece_range())
+		t.set_hash(i, ph);
+
+	std::vector<char> tmp;
+	bencode(std::back_inserter(tmp), t.generate());
+	torrent_info const ti(tmp, from_span);
+	TEST_EQUAL(int(ti.files().paths().size()), 2);
+
+	// the loaded torrent doesn't keep the index of its paths, but existing
+	// paths are still found when more files are added
+	file_storage fs2 = ti.files();
+	fs2.add_file("test/b/4", 0x4000);
+	fs2.add_file("test/a/5", 0x4000);
+	TEST_EQUAL(int(fs2.paths().size()), 2);
+	fs2.add_file("test/c/6", 0x4000);
+	TEST_EQUAL(int(fs2.paths().size()), 3);
+	TEST_EQUAL(fs2.file_path(file_index_t{4}), combine_path("test", combine_path("a", "5")));
+}
+
 struct A
 {
 	int val;
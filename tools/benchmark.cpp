@@ -0,0 +1,383 @@
+/*
+
+Copyright (c) 2020, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+// micro benchmarks of individual parts of libtorrent. Each one is run by
+// passing its name on the command line, and prints its timings. Some of them
+// use internal interfaces, and require libtorrent to be built with
+// TORRENT_EXPORT_EXTRA, as it is when the tests are built. The build systems
+// only build this tool along with the tests
+
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/session.hpp"
+#include "libtorrent/alert_types.hpp"
+#include "libtorrent/add_torrent_params.hpp"
+#include "libtorrent/create_torrent.hpp"
+#include "libtorrent/torrent_info.hpp"
+#include "libtorrent/read_resume_data.hpp"
+#include "libtorrent/write_resume_data.hpp"
+#include "libtorrent/bencode.hpp"
+#include "libtorrent/ip_filter.hpp"
+#include "libtorrent/pe_crypto.hpp"
+#include "libtorrent/hasher.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/string_view.hpp"
+#include "libtorrent/aux_/array.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace lt;
+
+namespace {
+
+// the network thread, the disk threads and the hasher threads all increment
+// the session counters. Compare the sharded counters to every thread
+// incrementing the same atomics
+int bench_counters()
+{
+	constexpr int num_threads = 16;
+	constexpr int num_increments = 1000000;
+
+	// the counters incremented by the benchmark, all next to each other, like
+	// the disk job counters
+	static constexpr int bench_counters[] = {
+		counters::num_read_ops,
+		counters::num_write_ops,
+		counters::num_blocks_read,
+		counters::num_blocks_written,
+	};
+
+	auto run_threads = [](std::function<void()> const& f)
+	{
+		std::vector<std::thread> threads;
+		time_point const start = clock_type::now();
+		for (int t = 0; t < num_threads; ++t)
+			threads.emplace_back(f);
+		for (auto& t : threads) t.join();
+		return total_microseconds(clock_type::now() - start);
+	};
+
+	auto print_result = [](char const* name, std::int64_t const us)
+	{
+		std::printf("%-20s %d threads: %d ms (%.2f ns per increment)\n"
+			, name, num_threads, int(us / 1000)
+			, double(us) * 1000.0 / (double(num_threads) * num_increments));
+	};
+
+	aux::array<std::atomic<std::int64_t>, counters::num_counters> shared;
+	for (auto& v : shared) v.store(0);
+	print_result("shared atomics", run_threads([&shared]
+	{
+		for (int i = 0; i < num_increments; ++i)
+			shared[bench_counters[i & 3]].fetch_add(1, std::memory_order_relaxed);
+	}));
+
+	counters c;
+	print_result("counters", run_threads([&c]
+	{
+		for (int i = 0; i < num_increments; ++i)
+			c.inc_stats_counter(bench_counters[i & 3]);
+	}));
+
+	std::int64_t sum = 0;
+	for (int const i : bench_counters) sum += c[i];
+	if (sum != std::int64_t(num_threads) * num_increments)
+	{
+		std::fprintf(stderr, "counters lost increments\n");
+		return 1;
+	}
+	return 0;
+}
+
+// a torrent with a single file, named after ``idx``, of ``num_pieces`` 16 kiB
+// pieces. The piece hashes are all zero
+std::shared_ptr<torrent_info> make_torrent(int const idx, int const num_pieces)
+{
+	file_storage fs;
+	fs.add_file("benchmark_" + std::to_string(idx) + "/file"
+		, std::int64_t(num_pieces) * 0x4000);
+	lt::create_torrent t(fs, 0x4000);
+	std::vector<char> buf;
+	bencode(std::back_inserter(buf), t.generate());
+	return std::make_shared<torrent_info>(buf, from_span);
+}
+
+// loading resume data for many torrents at startup. Compare parsing the
+// bencoded and the binary form
+int bench_resume_data()
+{
+	int const num_torrents = 1000;
+	int const num_pieces = 4000;
+
+	add_torrent_params atp;
+	atp.ti = make_torrent(0, num_pieces);
+	atp.info_hash = atp.ti->info_hash();
+	atp.save_path = "/save/path";
+	atp.have_pieces.resize(num_pieces, true);
+	atp.verified_pieces.resize(num_pieces, false);
+	atp.piece_priorities.resize(num_pieces, default_priority);
+	atp.trackers = {"http://tracker1.com/announce", "udp://tracker2.com:1337"};
+	atp.tracker_tiers = {0, 1};
+	for (int i = 0; i < 100; ++i)
+		atp.peers.push_back(tcp::endpoint(make_address_v4("10.0.0.1"), std::uint16_t(1000 + i)));
+
+	std::vector<char> const bencoded = write_resume_data_buf(atp);
+	std::vector<char> const bin = write_resume_data_binary(atp);
+
+	std::int64_t total = 0;
+	time_point start = clock_type::now();
+	for (int i = 0; i < num_torrents; ++i)
+		total += read_resume_data(bencoded).have_pieces.size();
+	std::int64_t const bencoded_us = total_microseconds(clock_type::now() - start);
+
+	start = clock_type::now();
+	for (int i = 0; i < num_torrents; ++i)
+		total += read_resume_data(bin).have_pieces.size();
+	std::int64_t const binary_us = total_microseconds(clock_type::now() - start);
+
+	std::printf("loading %d torrents. bencoded (%d bytes): %d ms binary (%d bytes): %d ms\n"
+		, num_torrents, int(bencoded.size()), int(bencoded_us / 1000)
+		, int(bin.size()), int(binary_us / 1000));
+
+	if (total != std::int64_t(2) * num_pieces * num_torrents)
+	{
+		std::fprintf(stderr, "resume data did not round-trip\n");
+		return 1;
+	}
+	return 0;
+}
+
+// waits for ``num`` add_torrent_alerts, or until nothing has been added for
+// a while. Returns the number of torrents that were added
+int wait_for_added(lt::session& ses, int const num)
+{
+	int added = 0;
+	std::vector<alert*> alerts;
+	while (added < num)
+	{
+		if (ses.wait_for_alert(seconds(10)) == nullptr) break;
+		ses.pop_alerts(&alerts);
+		for (alert* a : alerts)
+			if (alert_cast<add_torrent_alert>(a)) ++added;
+	}
+	return added;
+}
+
+// the time until all torrents are loaded when restoring a session. Compare
+// parsing resume data on the client thread and adding torrents one at a
+// time to async_load_torrents()
+int bench_load_torrents()
+{
+	int const num_torrents = 2000;
+	std::vector<std::vector<char>> buffers;
+	for (int i = 0; i < num_torrents; ++i)
+	{
+		add_torrent_params atp;
+		atp.ti = make_torrent(i, 17);
+		atp.save_path = ".";
+		atp.flags &= ~torrent_flags::auto_managed;
+		atp.flags |= torrent_flags::paused;
+		buffers.push_back(write_resume_data_buf(atp));
+	}
+
+	settings_pack pack;
+	pack.set_str(settings_pack::listen_interfaces, "127.0.0.1:0");
+	pack.set_int(settings_pack::alert_queue_size, 100000);
+	pack.set_int(settings_pack::alert_mask, alert_category::status | alert_category::error);
+
+	int ret = 0;
+	std::int64_t serial_ms = 0;
+	{
+		lt::session ses(pack);
+		time_point const start = clock_type::now();
+		for (auto const& b : buffers)
+			ses.async_add_torrent(read_resume_data(b));
+		if (wait_for_added(ses, num_torrents) != num_torrents) ret = 1;
+		serial_ms = total_milliseconds(clock_type::now() - start);
+	}
+
+	std::int64_t batch_ms = 0;
+	{
+		lt::session ses(pack);
+		time_point const start = clock_type::now();
+		ses.async_load_torrents(std::move(buffers), ".");
+		if (wait_for_added(ses, num_torrents) != num_torrents) ret = 1;
+		batch_ms = total_milliseconds(clock_type::now() - start);
+	}
+
+	std::printf("loading %d torrents. one at a time: %d ms async_load_torrents: %d ms\n"
+		, num_torrents, int(serial_ms), int(batch_ms));
+	if (ret != 0) std::fprintf(stderr, "not all torrents were added\n");
+	return ret;
+}
+
+// the cost of a lookup in a filter the size of a large blocklist, with and
+// without compiling it
+int bench_ip_filter()
+{
+	std::mt19937 rng(0x1337);
+	auto random_v4 = [&rng] { return address_v4(std::uint32_t(rng())); };
+
+	// narrow ranges, like the ones found in blocklists
+	ip_filter f;
+	for (int i = 0; i < 500000; ++i)
+	{
+		address_v4 const a = random_v4();
+		auto b = a.to_bytes();
+		b[2] |= static_cast<unsigned char>(rng() % 16);
+		b[3] = 0xff;
+		f.add_rule(a, address_v4(b), rng() % 3 == 0 ? 0 : ip_filter::blocked);
+	}
+
+	ip_filter compiled = f;
+	time_point const compile_start = clock_type::now();
+	compiled.compile();
+	std::int64_t const compile_ms = total_milliseconds(clock_type::now() - compile_start);
+
+	std::vector<address> addrs;
+	for (int i = 0; i < 1000000; ++i) addrs.push_back(random_v4());
+
+	std::uint32_t blocked[2] = {0, 0};
+	std::int64_t lookup_ms[2];
+	ip_filter const* filters[2] = {&f, &compiled};
+	for (int k = 0; k < 2; ++k)
+	{
+		time_point const start = clock_type::now();
+		for (auto const& a : addrs) blocked[k] += filters[k]->access(a);
+		lookup_ms[k] = total_milliseconds(clock_type::now() - start);
+	}
+
+	std::printf("%d ranges. compile: %d ms, 1M lookups: %d ms (tree) %d ms (compiled)\n"
+		, int(std::get<0>(f.export_filter()).size()), int(compile_ms)
+		, int(lookup_ms[0]), int(lookup_ms[1]));
+
+	if (blocked[0] != blocked[1])
+	{
+		std::fprintf(stderr, "compiled filter disagrees with the rules\n");
+		return 1;
+	}
+	return 0;
+}
+
+#if !defined TORRENT_DISABLE_ENCRYPTION
+// the throughput of the stream ciphers used by encrypted peer connections
+int bench_pe_crypto()
+{
+	std::vector<char> buf(16 * 1024 * 1024);
+	int const rounds = 4;
+
+	rc4_handler rc4;
+	rc4.set_outgoing_key(hasher("test1_key", 8).final());
+
+	std::array<char, 32> key{};
+	chacha20_handler chacha;
+	chacha.set_outgoing_key(key);
+
+	crypto_plugin* plugins[] = {&rc4, &chacha};
+	char const* names[] = {"rc4", "chacha20"};
+	for (int i = 0; i < 2; ++i)
+	{
+		time_point const start = clock_type::now();
+		for (int r = 0; r < rounds; ++r)
+		{
+			span<char> iovec(buf);
+			plugins[i]->encrypt(iovec);
+		}
+		std::int64_t const us = std::max(std::int64_t(1)
+			, total_microseconds(clock_type::now() - start));
+		std::printf("%s: %d MiB/s\n", names[i]
+			, int(std::int64_t(buf.size()) * rounds / us * 1000000 / (1024 * 1024)));
+	}
+	return 0;
+}
+#endif
+
+struct benchmark
+{
+	char const* name;
+	int (*fun)();
+	char const* description;
+};
+
+benchmark const benchmarks[] = {
+	{"counters", &bench_counters, "increment session counters from many threads"},
+	{"resume-data", &bench_resume_data, "parse bencoded and binary resume data"},
+	{"load-torrents", &bench_load_torrents, "restore a session with many torrents"},
+	{"ip-filter", &bench_ip_filter, "look up addresses in a large IP filter"},
+#if !defined TORRENT_DISABLE_ENCRYPTION
+	{"pe-crypto", &bench_pe_crypto, "encrypt with the RC4 and ChaCha20 stream ciphers"},
+#endif
+};
+
+void print_usage()
+{
+	std::fprintf(stderr, "usage: benchmark <name>...\n\navailable benchmarks:\n");
+	for (auto const& b : benchmarks)
+		std::fprintf(stderr, "  %-16s %s\n", b.name, b.description);
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		print_usage();
+		return 1;
+	}
+
+	int ret = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		string_view const name = argv[i];
+		auto const it = std::find_if(std::begin(benchmarks), std::end(benchmarks)
+			, [name](benchmark const& b) { return name == b.name; });
+		if (it == std::end(benchmarks))
+		{
+			std::fprintf(stderr, "unknown benchmark: %s\n", argv[i]);
+			print_usage();
+			return 1;
+		}
+		std::printf("=== %s ===\n", it->name);
+		ret |= it->fun();
+	}
+	return ret;
+}
@@ -476,7 +476,8 @@ reports = [
         'utp.utp_payload_pkts_in', \
         'utp.utp_payload_pkts_out', \
         'utp.utp_invalid_pkts_in', \
-        'utp.utp_redundant_pkts_in' \
+        'utp.utp_redundant_pkts_in', \
+        'utp.utp_demux_probes' \
     ], {'type': stacked}),
 
     ('boost.asio messages', 'num events', '', 'number of messages posted', [ \